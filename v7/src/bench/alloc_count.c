@@ -0,0 +1,327 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Allocation check: after a warm-up pass, parsing the same script again must
+// not touch the heap (counted by ktAllocCount()), whether the script is
+// streamed in chunks, parsed in one go or parsed line by line, and with the
+// errors collected as records. Evaluating a
+// compiled program must not touch it at all.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "alloc.h"
+#include "memory.h"
+#include "parser.h"
+#include "program.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_CHUNK_SIZE = 4096,
+	KT_BENCH_REPEAT = 2000,
+	KT_BENCH_EVALUATIONS = 10000,
+	KT_BENCH_EVENT_BATCH_SIZE = 64,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static void onExprStmtAst(int errorCode, const ktAst* ast, void* userData);
+static void onEventBatch(ktEventRing* events, void* userData);
+
+static char* createScript(void);
+static void streamScript(ktParser* parser, const char* script, size_t length);
+static void runScript(ktParser* parser, const char* script);
+static void runLines(ktParser* parser, const char* script);
+static void runAst(ktParser* parser, const char* script);
+static void runEvents(ktParser* parser, const char* script);
+static void runCollect(ktParser* parser, const char* script);
+static bool checkEvaluate(const char* formula);
+static bool check(ktParser* parser, size_t* stmtCount, const char* name, const char* script, void (*parseScript)(ktParser*, const char*));
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	ktParserCallback callback =
+	{
+		.letStmt = countLetStmt,
+		.resetStmt = countErrorCode,
+		.varsStmt = countErrorCode,
+		.clearStmt = countNoArgs,
+		.exitStmt = countNoArgs,
+		.exprStmtBegin = countErrorCode,
+		.exprStmtEnd = countErrorCode,
+		.var = onVar,
+		.number = onNumber,
+		.symbol = onSymbol,
+		.error = onError,
+		.exprStmtAst = onExprStmtAst,
+		.eventBatch = onEventBatch,
+	};
+
+	char* script = createScript();
+	if (!script)
+		return EXIT_FAILURE;
+
+	size_t stmtCount = 0;
+	ktParser* parser = ktParserCreate(&callback, &stmtCount);
+
+	bool ok = check(parser, &stmtCount, "stream", script, NULL);
+	ok = check(parser, &stmtCount, "run", script, runScript) && ok;
+	ok = check(parser, &stmtCount, "lines", script, runLines) && ok;
+	ok = check(parser, &stmtCount, "ast", script, runAst) && ok;
+	ok = check(parser, &stmtCount, "events", script, runEvents) && ok;
+	ok = check(parser, &stmtCount, "collect", script, runCollect) && ok;
+	ok = checkEvaluate("((A + B) * C - D) / ((E - F) * G + H) ^ I") && ok;
+
+	ktParserDestroy(parser);
+	free(script);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool checkEvaluate(const char* formula)
+{
+	ktProgram* program = ktCompile(formula);
+	ktMemory* memory = ktMemoryCreate();
+	if (!program || !memory)
+	{
+		ktProgramDestroy(program);
+		ktMemoryDestroy(memory);
+		printf("%-8s failed to compile '%s'\n", "eval", formula);
+		return false;
+	}
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		ktMemorySet(memory, i, 1.0 + (double)i);
+	}
+
+	size_t allocCount = ktAllocCount();
+	double result = 0.0;
+	for (int i = 0; i < KT_BENCH_EVALUATIONS; ++i)
+	{
+		ktEvaluate(program, memory, &result);
+	}
+	size_t allocations = ktAllocCount() - allocCount;
+
+	printf("%-8s %8d statements  %6zu heap allocations  %s\n", "eval", KT_BENCH_EVALUATIONS, allocations,
+		allocations == 0 ? "ok" : "FAILED");
+
+	ktMemoryDestroy(memory);
+	ktProgramDestroy(program);
+
+	return allocations == 0;
+}
+
+//------------------------------------------------------------------------------
+// Parses the script twice: the first pass lets the buffers grow, the second
+// one is measured. A NULL parseScript streams the script in chunks.
+//------------------------------------------------------------------------------
+bool check(ktParser* parser, size_t* stmtCount, const char* name, const char* script, void (*parseScript)(ktParser*, const char*))
+{
+	size_t length = strlen(script);
+	size_t allocations = 0;
+	size_t stmts = 0;
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		size_t allocCount = ktAllocCount();
+		*stmtCount = 0;
+
+		if (parseScript)
+		{
+			parseScript(parser, script);
+		}
+		else
+		{
+			streamScript(parser, script, length);
+		}
+
+		allocations = ktAllocCount() - allocCount;
+		stmts = *stmtCount;
+	}
+
+	printf("%-8s %8zu statements  %6zu heap allocations  %s\n", name, stmts, allocations,
+		allocations == 0 ? "ok" : "FAILED");
+
+	return allocations == 0;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void streamScript(ktParser* parser, const char* script, size_t length)
+{
+	for (size_t offset = 0; offset < length; offset += KT_BENCH_CHUNK_SIZE)
+	{
+		size_t chunkLength = length - offset < KT_BENCH_CHUNK_SIZE ? length - offset : KT_BENCH_CHUNK_SIZE;
+		ktParserFeed(parser, &script[offset], chunkLength);
+	}
+	ktParserFinish(parser);
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void runScript(ktParser* parser, const char* script)
+{
+	ktParserRun(parser, script);
+}
+
+//------------------------------------------------------------------------------
+// One ktParserRun() per line, the way the REPL used to call the parser.
+//------------------------------------------------------------------------------
+void runLines(ktParser* parser, const char* script)
+{
+	char line[256];
+	while (*script)
+	{
+		const char* end = strchr(script, '\n');
+		size_t lineLength = end ? (size_t)(end - script) : strlen(script);
+		if (lineLength >= sizeof(line))
+			lineLength = sizeof(line) - 1;
+
+		memcpy(line, script, lineLength);
+		line[lineLength] = '\0';
+		ktParserRun(parser, line);
+
+		script = end ? end + 1 : script + lineLength;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Same as runLines(), building each expression's tree in the parser's arena.
+//------------------------------------------------------------------------------
+void runAst(ktParser* parser, const char* script)
+{
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_AST);
+	runLines(parser, script);
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_CALLBACKS);
+}
+
+//------------------------------------------------------------------------------
+// Same as runLines(), with each statement's events handed over in one batch.
+//------------------------------------------------------------------------------
+void runEvents(ktParser* parser, const char* script)
+{
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_EVENTS);
+	runLines(parser, script);
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_CALLBACKS);
+}
+
+//------------------------------------------------------------------------------
+// Whole script fed in one go, keeping every error as a record (the list keeps
+// its capacity when cleared).
+//------------------------------------------------------------------------------
+void runCollect(ktParser* parser, const char* script)
+{
+	ktParserSetErrorMode(parser, KT_PARSER_ERROR_MODE_COLLECT);
+	ktParserClearErrors(parser);
+	streamScript(parser, script, strlen(script));
+	ktParserSetErrorMode(parser, KT_PARSER_ERROR_MODE_MESSAGES);
+}
+
+//------------------------------------------------------------------------------
+// Valid statements and every kind of error the parser reports.
+//------------------------------------------------------------------------------
+char* createScript(void)
+{
+	static const char* const LINES[] =
+	{
+		"LET A = 1.5\n",
+		"LET B = -31415926535897932384626\n",
+		"(A + B) * A ^ -B / --A\n",
+		"VARS\n",
+		"RESET\n",
+		"CLEAR\n",
+		"UNKNOWNCOMMAND\n",
+		"LET C 2\n",
+		"1 + 2\n",
+		"A $ B\n",
+		"LET A = 1..2\n",
+		"A + (B * \n",
+		"\n",
+	};
+	const size_t lineCount = sizeof(LINES) / sizeof(LINES[0]);
+
+	size_t size = 1;
+	for (size_t i = 0; i < lineCount; ++i)
+	{
+		size += strlen(LINES[i]) * KT_BENCH_REPEAT;
+	}
+
+	char* script = malloc(size);
+	if (!script)
+		return NULL;
+
+	size_t length = 0;
+	for (int repeat = 0; repeat < KT_BENCH_REPEAT; ++repeat)
+	{
+		for (size_t i = 0; i < lineCount; ++i)
+		{
+			size_t lineLength = strlen(LINES[i]);
+			memcpy(&script[length], LINES[i], lineLength);
+			length += lineLength;
+		}
+	}
+	script[length] = '\0';
+
+	return script;
+}
+
+//------------------------------------------------------------------------------
+// Counts expression statements, like countErrorCode() does for exprStmtEnd.
+//------------------------------------------------------------------------------
+void onExprStmtAst(int errorCode, const ktAst* ast, void* userData)
+{
+	(void)errorCode;
+	(void)ast;
+	++*(size_t*)userData;
+}
+
+//------------------------------------------------------------------------------
+// Counts expression statements, like exprStmtEnd does in callback mode.
+//------------------------------------------------------------------------------
+void onEventBatch(ktEventRing* events, void* userData)
+{
+	ktEvent batch[KT_BENCH_EVENT_BATCH_SIZE];
+	size_t count = 0;
+	while ((count = ktEventRingRead(events, batch, KT_BENCH_EVENT_BATCH_SIZE)) > 0)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (batch[i].type == KT_EVENT_EXPR_STMT_END)
+			{
+				++*(size_t*)userData;
+			}
+		}
+	}
+}
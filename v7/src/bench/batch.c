@@ -0,0 +1,257 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Batch front end benchmark: a large deterministic script compiled by
+// ktBatchCompile() on 1, 2, 4... threads (up to twice the processors), against
+// feeding it to a single parser (the REPL path). Reports MB/s, the speedup
+// over one thread, and how long ktBatchReplay() takes to hand the statements
+// over in order.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "batch.h"
+#include "parser.h"
+#include "thread_pool.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_SCRIPT_SIZE = 16 * 1024 * 1024,
+	KT_BENCH_RUNS = 3,
+	KT_BENCH_LINE_MAX_LENGTH = 256,
+	KT_BENCH_MAX_OPERANDS = 24,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static char* createScript(size_t size, size_t* out_length);
+static void scriptLine(ktRandom* random, char* line, size_t size);
+static double benchFeed(const char* script, size_t length, size_t* out_stmtCount);
+static double benchBatch(const char* script, size_t length, size_t threadCount, size_t* out_stmtCount, double* out_replayTime);
+
+static void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+// Counts every statement (the parser's or the replay's userData).
+static const ktParserCallback CALLBACK =
+{
+	.letStmt = countLetStmt,
+	.resetStmt = countErrorCode,
+	.varsStmt = countErrorCode,
+	.clearStmt = countNoArgs,
+	.exitStmt = countNoArgs,
+	.exprStmtBegin = countErrorCode,
+	.exprStmtEnd = countErrorCode,
+	.var = onVar,
+	.number = onNumber,
+	.symbol = onVar,
+	.error = onError,
+	.exprStmtProgram = onExprStmtProgram,
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	size_t length = 0;
+	char* script = createScript(KT_BENCH_SCRIPT_SIZE, &length);
+	if (!script)
+		return EXIT_FAILURE;
+
+	double megabytes = (double)length / (1024.0 * 1024.0);
+	size_t processors = ktThreadPoolDefaultSize();
+
+	size_t expected = 0;
+	double feedTime = benchFeed(script, length, &expected);
+
+	printf("%.1f MB, %zu statements, %zu processors\n", megabytes, expected, processors);
+	printf("%-12s %8s %8s %8s %10s\n", "front end", "ms", "MB/s", "speedup", "replay ms");
+	printf("%-12s %8.1f %8.1f %8s %10s\n", "feed", feedTime * 1e3, megabytes / feedTime, "", "");
+
+	bool ok = true;
+	double oneThreadTime = 0.0;
+	for (size_t threadCount = 1; threadCount <= 2 * processors || threadCount <= 2; threadCount *= 2)
+	{
+		size_t stmtCount = 0;
+		double replayTime = 0.0;
+		double time = benchBatch(script, length, threadCount, &stmtCount, &replayTime);
+		if (threadCount == 1)
+		{
+			oneThreadTime = time;
+		}
+
+		char name[32];
+		snprintf(name, sizeof(name), "batch x%zu", threadCount);
+		printf("%-12s %8.1f %8.1f %7.2fx %10.1f%s\n", name, time * 1e3, megabytes / time, oneThreadTime / time,
+			replayTime * 1e3, stmtCount == expected ? "" : "  MISMATCH");
+
+		ok = ok && stmtCount == expected;
+	}
+
+	free(script);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// Best of KT_BENCH_RUNS: the whole script fed to one parser, compiling every
+// expression statement (what the batch does on each chunk).
+//------------------------------------------------------------------------------
+double benchFeed(const char* script, size_t length, size_t* out_stmtCount)
+{
+	double best = 0.0;
+
+	for (int run = 0; run < KT_BENCH_RUNS; ++run)
+	{
+		size_t stmtCount = 0;
+		ktParser* parser = ktParserCreate(&CALLBACK, &stmtCount);
+		ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_PROGRAM);
+
+		double start = now();
+		ktParserFeed(parser, script, length);
+		ktParserFinish(parser);
+		double elapsed = now() - start;
+
+		ktParserDestroy(parser);
+
+		*out_stmtCount = stmtCount;
+		if (run == 0 || elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	return best;
+}
+
+//------------------------------------------------------------------------------
+// Best of KT_BENCH_RUNS. The replay counts the statements.
+//------------------------------------------------------------------------------
+double benchBatch(const char* script, size_t length, size_t threadCount, size_t* out_stmtCount, double* out_replayTime)
+{
+	double best = 0.0;
+	*out_stmtCount = 0;
+
+	for (int run = 0; run < KT_BENCH_RUNS; ++run)
+	{
+		double start = now();
+		ktBatch* batch = ktBatchCompile(script, length, threadCount);
+		double elapsed = now() - start;
+		if (!batch)
+			return 0.0;
+
+		size_t stmtCount = 0;
+		start = now();
+		ktBatchReplay(batch, &CALLBACK, &stmtCount);
+		*out_replayTime = now() - start;
+		*out_stmtCount = stmtCount;
+
+		ktBatchDestroy(batch);
+
+		if (run == 0 || elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	return best;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+char* createScript(size_t size, size_t* out_length)
+{
+	char* script = malloc(size + 1);
+	if (!script)
+		return NULL;
+
+	ktRandom random = { 0x853c49e6748fea9bULL };
+	size_t length = 0;
+	char line[KT_BENCH_LINE_MAX_LENGTH];
+
+	for (;;)
+	{
+		scriptLine(&random, line, KT_BENCH_LINE_MAX_LENGTH);
+		size_t lineLength = strlen(line);
+		if (length + lineLength > size)
+			break;
+
+		memcpy(&script[length], line, lineLength);
+		length += lineLength;
+	}
+
+	script[length] = '\0';
+	*out_length = length;
+
+	return script;
+}
+
+//------------------------------------------------------------------------------
+// Mostly expressions, with LET statements between them (and a few VARS).
+//------------------------------------------------------------------------------
+void scriptLine(ktRandom* random, char* line, size_t size)
+{
+	static const char OPERATORS[] = { '+', '-', '*', '/', '^' };
+
+	unsigned int kind = randomNext(random, 16);
+	if (kind == 0)
+	{
+		snprintf(line, size, "VARS\n");
+		return;
+	}
+
+	if (kind < 5)
+	{
+		snprintf(line, size, "LET %c = %u.%u\n", randomVar(random), randomNext(random, 1000), randomNext(random, 1000));
+		return;
+	}
+
+	unsigned int operands = 2 + randomNext(random, KT_BENCH_MAX_OPERANDS - 1);
+	size_t length = (size_t)snprintf(line, size, "(%c", randomVar(random));
+
+	for (unsigned int i = 1; i < operands && length + 8 < size; ++i)
+	{
+		length += (size_t)snprintf(&line[length], size - length, " %c %s%c", OPERATORS[randomNext(random, 5)],
+			i == operands / 2 ? "-(" : "", randomVar(random));
+	}
+
+	snprintf(&line[length], size - length, "%s)\n", operands > 3 ? ")" : "");
+}
+
+//------------------------------------------------------------------------------
+// Counts expression statements, like the callbacks from bench.h.
+//------------------------------------------------------------------------------
+void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData)
+{
+	(void)errorCode;
+	(void)program;
+	++*(size_t*)userData;
+}
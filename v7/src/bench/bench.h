@@ -0,0 +1,192 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_BENCH_H__
+#define __KISHITECH_BENCH_H__
+
+//------------------------------------------------------------------------------
+// Helpers shared by the benchmarks. They are static inline, so each benchmark
+// is still a single source file built against the kt sources (see makefile).
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include <time.h>
+#include "error_type.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktRandom ktRandom;
+
+// Deterministic generator (same input on every run and platform).
+struct ktRandom
+{
+	unsigned long long state;
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static inline double now(void);
+static inline unsigned int randomNext(ktRandom* random, unsigned int bound);
+static inline char randomVar(ktRandom* random);
+
+static inline void onLetStmt(int errorCode, char variable, double value, void* userData);
+static inline void onErrorCode(int errorCode, void* userData);
+static inline void onNoArgs(void* userData);
+
+static inline void countLetStmt(int errorCode, char variable, double value, void* userData);
+static inline void countErrorCode(int errorCode, void* userData);
+static inline void countNoArgs(void* userData);
+static inline void onVar(int errorCode, char variable, void* userData);
+static inline void onNumber(int errorCode, double number, void* userData);
+static inline void onSymbol(int errorCode, char symbol, void* userData);
+static inline void onError(ktErrorType errorType, const char* message, void* userData);
+
+//------------------------------------------------------------------------------
+// Wall clock time, in seconds.
+//------------------------------------------------------------------------------
+double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+//------------------------------------------------------------------------------
+// PCG32 (O'Neill), reduced to [0, bound).
+//------------------------------------------------------------------------------
+unsigned int randomNext(ktRandom* random, unsigned int bound)
+{
+	unsigned long long state = random->state;
+	random->state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+	unsigned int xorShifted = (unsigned int)(((state >> 18) ^ state) >> 27);
+	unsigned int rotation = (unsigned int)(state >> 59);
+	unsigned int value = (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+
+	return value % bound;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+char randomVar(ktRandom* random)
+{
+	return (char)('A' + randomNext(random, 26));
+}
+
+//------------------------------------------------------------------------------
+// No-op parser callbacks for statements nobody looks at.
+//------------------------------------------------------------------------------
+void onLetStmt(int errorCode, char variable, double value, void* userData)
+{
+	(void)errorCode;
+	(void)variable;
+	(void)value;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void onErrorCode(int errorCode, void* userData)
+{
+	(void)errorCode;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void onNoArgs(void* userData)
+{
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// Parser callbacks that count statements in *(size_t*)userData.
+//------------------------------------------------------------------------------
+void countLetStmt(int errorCode, char variable, double value, void* userData)
+{
+	(void)errorCode;
+	(void)variable;
+	(void)value;
+	++*(size_t*)userData;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void countErrorCode(int errorCode, void* userData)
+{
+	(void)errorCode;
+	++*(size_t*)userData;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void countNoArgs(void* userData)
+{
+	++*(size_t*)userData;
+}
+
+//------------------------------------------------------------------------------
+// No-op parser callbacks for the parts of a statement nobody looks at.
+//------------------------------------------------------------------------------
+void onVar(int errorCode, char variable, void* userData)
+{
+	(void)errorCode;
+	(void)variable;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void onNumber(int errorCode, double number, void* userData)
+{
+	(void)errorCode;
+	(void)number;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void onSymbol(int errorCode, char symbol, void* userData)
+{
+	(void)errorCode;
+	(void)symbol;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// Counts error messages in *(size_t*)userData.
+//------------------------------------------------------------------------------
+void onError(ktErrorType errorType, const char* message, void* userData)
+{
+	(void)errorType;
+	(void)message;
+	++*(size_t*)userData;
+}
+
+#endif // __KISHITECH_BENCH_H__
@@ -0,0 +1,312 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Tokenizer benchmark: scalar vs SIMD character scanning.
+// All paths must produce exactly the same tokens, also for contents with
+// embedded '\0' characters (fed through ktTokenizerFeed()), and must not slow
+// down the libm calls made after them (dirty upper YMM state left by AVX2).
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "tokenizer.h"
+#include "token_buffer.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_CONTENTS_SIZE = 8 * 1024 * 1024,
+	KT_BENCH_RUNS = 10,
+
+	// Words long enough for a full AVX2 block, with a '\0' at each position.
+	KT_BENCH_NUL_WORD_LENGTH = 80,
+
+	// pow() after a short tokenize may take at most this many times as long
+	// as before any tokenizing.
+	KT_BENCH_POW_CALLS = 1000000,
+	KT_BENCH_POW_MAX_SLOWDOWN = 3,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static char* createContents(size_t size);
+static char* createNulContents(size_t* out_length);
+static bool feedTokens(ktTokenizer* tokenizer, const char* contents, size_t length, ktTokenBuffer* out_buffer);
+static void onStmt(const char* contents, const ktTokenBuffer* tokens, void* userData);
+static bool sameTokens(const ktTokenBuffer* a, const ktTokenBuffer* b);
+static double timePow(void);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+// Keep pow() from being folded or hoisted out of the loop.
+static volatile double g_base = 1.5;
+static volatile double g_exponent = 1.75;
+static volatile double g_sink = 0.0;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	double powTime = timePow();
+
+	char* contents = createContents(KT_BENCH_CONTENTS_SIZE);
+	if (!contents)
+		return EXIT_FAILURE;
+
+	size_t length = strlen(contents);
+	ktTokenizer* tokenizer = ktTokenizerCreate();
+	ktTokenBuffer* reference = ktTokenBufferCreate();
+	ktTokenBuffer* tokens = ktTokenBufferCreate();
+
+	ktTokenizerSetCharScanPath(tokenizer, KT_CHAR_SCAN_SCALAR);
+	ktTokenizerRun(tokenizer, contents, reference);
+
+	printf("contents: %.1f MB, %zu tokens, pow() %.1f ns\n", length / (1024.0 * 1024.0), reference->count, powTime * 1e9);
+
+	size_t nulLength = 0;
+	char* nulContents = createNulContents(&nulLength);
+	ktTokenBuffer* nulReference = ktTokenBufferCreate();
+	if (!nulContents || !feedTokens(tokenizer, nulContents, nulLength, nulReference))
+		return EXIT_FAILURE;
+
+	int status = EXIT_SUCCESS;
+	double scalarTime = 0.0;
+	const ktCharScanPath paths[] = { KT_CHAR_SCAN_SCALAR, KT_CHAR_SCAN_SSE2, KT_CHAR_SCAN_AVX2 };
+	for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); ++p)
+	{
+		const ktCharScan* scan = ktCharScanGet(paths[p]);
+		if (scan->path != paths[p])
+		{
+			printf("%-8s not supported\n", scan->name);
+			continue;
+		}
+
+		ktTokenizerSetCharScanPath(tokenizer, paths[p]);
+
+		double best = 0.0;
+		for (int run = 0; run < KT_BENCH_RUNS; ++run)
+		{
+			double start = now();
+			ktTokenizerRun(tokenizer, contents, tokens);
+			double elapsed = now() - start;
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+
+		if (paths[p] == KT_CHAR_SCAN_SCALAR)
+			scalarTime = best;
+
+		bool same = sameTokens(reference, tokens);
+		bool sameNul = feedTokens(tokenizer, nulContents, nulLength, tokens) && sameTokens(nulReference, tokens);
+
+		// Runs shorter than a SIMD block, like most real statements.
+		ktTokenizerRun(tokenizer, "LET A = 1.5\n", tokens);
+		double powAfterTime = timePow();
+		bool isPowFast = powAfterTime <= powTime * KT_BENCH_POW_MAX_SLOWDOWN;
+
+		if (!same || !sameNul || !isPowFast)
+			status = EXIT_FAILURE;
+
+		printf("%-8s %8.1f MB/s  %6.2fx  %s, %s, pow() %.1f ns%s\n", scan->name,
+			length / (1024.0 * 1024.0) / best, scalarTime / best,
+			same ? "tokens match" : "TOKENS DIFFER",
+			sameNul ? "embedded NUL tokens match" : "EMBEDDED NUL TOKENS DIFFER",
+			powAfterTime * 1e9, isPowFast ? "" : " SLOW");
+	}
+
+	ktTokenBufferDestroy(nulReference);
+	free(nulContents);
+	ktTokenBufferDestroy(tokens);
+	ktTokenBufferDestroy(reference);
+	ktTokenizerDestroy(tokenizer);
+	free(contents);
+
+	return status;
+}
+
+//------------------------------------------------------------------------------
+// Formula log with long runs of blanks, digits and identifier characters.
+//------------------------------------------------------------------------------
+char* createContents(size_t size)
+{
+	static const char* const LINES[] =
+	{
+		"LET A = 1234567890.0987654321\n",
+		"LET B =                                  31415926535897932384626\n",
+		"(A + B) * A ^ -B / A\n",
+		"\t\t\t\t\t\tA\t\t\t\t\t\t+\t\t\t\t\t\tB\t\t\t\t\t\t\n",
+		"SOMEVERYLONGIDENTIFIERTHATISNOTACOMMAND ANOTHERLONGWORD_WITH_PUNCTUATION!\n",
+		"VARS\n",
+		"LET C = 0.000000000000000000000000000000000001\n",
+	};
+	const size_t lineCount = sizeof(LINES) / sizeof(LINES[0]);
+
+	char* contents = malloc(size + 1);
+	if (!contents)
+		return NULL;
+
+	size_t length = 0;
+	unsigned int seed = 12345;
+	while (true)
+	{
+		seed = seed * 1103515245u + 12345u;
+		const char* line = LINES[(seed >> 16) % lineCount];
+		size_t lineLength = strlen(line);
+		if (length + lineLength > size)
+			break;
+
+		memcpy(&contents[length], line, lineLength);
+		length += lineLength;
+	}
+	contents[length] = '\0';
+
+	return contents;
+}
+
+//------------------------------------------------------------------------------
+// Lines like "LET AAAA...\0BBBB...", with the '\0' moving through the word,
+// so it shows up at every position of a SIMD block.
+//------------------------------------------------------------------------------
+char* createNulContents(size_t* out_length)
+{
+	const size_t lineLength = 4 + KT_BENCH_NUL_WORD_LENGTH + 1;
+	char* contents = malloc(KT_BENCH_NUL_WORD_LENGTH * lineLength);
+	if (!contents)
+		return NULL;
+
+	size_t length = 0;
+	for (size_t nul = 0; nul < KT_BENCH_NUL_WORD_LENGTH; ++nul)
+	{
+		memcpy(&contents[length], "LET ", 4);
+		length += 4;
+
+		for (size_t i = 0; i < KT_BENCH_NUL_WORD_LENGTH; ++i)
+		{
+			contents[length++] = i == nul ? '\0' : (i < nul ? 'A' : 'B');
+		}
+		contents[length++] = '\n';
+	}
+
+	*out_length = length;
+
+	return contents;
+}
+
+//------------------------------------------------------------------------------
+// Feeds the contents in one chunk and collects the tokens of every statement.
+//------------------------------------------------------------------------------
+bool feedTokens(ktTokenizer* tokenizer, const char* contents, size_t length, ktTokenBuffer* out_buffer)
+{
+	ktTokenBufferClear(out_buffer);
+	ktTokenizerSetStmtCallback(tokenizer, onStmt, out_buffer);
+
+	bool ok = ktTokenizerFeed(tokenizer, contents, length);
+	ktTokenizerFinish(tokenizer);
+
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void onStmt(const char* contents, const ktTokenBuffer* tokens, void* userData)
+{
+	(void)contents;
+
+	ktTokenBuffer* buffer = userData;
+	for (size_t i = 0; i < tokens->count; ++i)
+	{
+		ktTokenBufferAppend(buffer, ktTokenBufferGet(tokens, i), tokens->offsets[i]);
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool sameTokens(const ktTokenBuffer* a, const ktTokenBuffer* b)
+{
+	if (a->count != b->count)
+		return false;
+
+	for (size_t i = 0; i < a->count; ++i)
+	{
+		ktToken ta = ktTokenBufferGet(a, i);
+		ktToken tb = ktTokenBufferGet(b, i);
+		if (ta.type != tb.type)
+			return false;
+
+		switch (ta.type)
+		{
+		case KT_TOKEN_VAR:
+			if (ta.value.var != tb.value.var)
+				return false;
+			break;
+
+		case KT_TOKEN_NUMBER:
+			if (memcmp(&ta.value.number, &tb.value.number, sizeof(double)) != 0)
+				return false;
+			break;
+
+		case KT_TOKEN_ERROR:
+			if (ta.value.error.type != tb.value.error.type
+				|| ta.value.error.span.offset != tb.value.error.span.offset
+				|| ta.value.error.span.length != tb.value.error.span.length)
+				return false;
+			break;
+
+		default:
+			if (ktTokenHasSpan(&ta)
+				&& (ta.value.span.offset != tb.value.span.offset || ta.value.span.length != tb.value.span.length))
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Seconds per pow() call.
+//------------------------------------------------------------------------------
+double timePow(void)
+{
+	double best = 0.0;
+	for (int run = 0; run < KT_BENCH_RUNS; ++run)
+	{
+		double start = now();
+		for (int i = 0; i < KT_BENCH_POW_CALLS; ++i)
+		{
+			g_sink = pow(g_base, g_exponent);
+		}
+		double elapsed = (now() - start) / KT_BENCH_POW_CALLS;
+		if (run == 0 || elapsed < best)
+			best = elapsed;
+	}
+
+	return best;
+}
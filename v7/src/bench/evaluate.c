@@ -0,0 +1,134 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Evaluation benchmark: a formula compiled once and evaluated many times with
+// ktEvaluate(), against going through the front end for every evaluation
+// (ktCompile() + ktEvaluate(), which is what a repeated line used to cost).
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "memory.h"
+#include "program.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_COMPILE_EVALUATIONS = 100000,
+	KT_BENCH_EVALUATIONS = 10000000,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool benchFormula(const char* formula, ktMemory* memory);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+static const char* const FORMULAS[] =
+{
+	"A + B",
+	"A * B + C * D - E / F",
+	"(A + B) * (C - D) / (E + F)",
+	"A ^ B + C ^ D",
+	"-(A - B) * -(C + D)",
+	"((A + B) * C - D) / ((E - F) * G + H) + I * J - K / L",
+	"A * X * X * X + B * X * X + C * X + D",
+};
+
+// Keeps the compiler from optimizing the evaluations away.
+static volatile double g_sink = 0.0;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	ktMemory* memory = ktMemoryCreate();
+	if (!memory)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		ktMemorySet(memory, i, 1.5 + 0.25 * (double)i);
+	}
+
+	printf("%-56s %12s %12s %9s\n", "formula", "compile+eval", "eval", "speedup");
+	printf("%-56s %12s %12s %9s\n", "", "ns", "ns", "");
+
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(FORMULAS) / sizeof(FORMULAS[0]); ++i)
+	{
+		ok = benchFormula(FORMULAS[i], memory) && ok;
+	}
+
+	ktMemoryDestroy(memory);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool benchFormula(const char* formula, ktMemory* memory)
+{
+	ktProgram* program = ktCompile(formula);
+	if (!program)
+	{
+		printf("%-56s failed to compile\n", formula);
+		return false;
+	}
+
+	double expected = 0.0;
+	ktEvaluate(program, memory, &expected);
+
+	double start = now();
+	for (int i = 0; i < KT_BENCH_COMPILE_EVALUATIONS; ++i)
+	{
+		ktProgram* compiled = ktCompile(formula);
+		double result = 0.0;
+		ktEvaluate(compiled, memory, &result);
+		g_sink = result;
+		ktProgramDestroy(compiled);
+	}
+	double compileTime = (now() - start) / KT_BENCH_COMPILE_EVALUATIONS;
+
+	start = now();
+	for (int i = 0; i < KT_BENCH_EVALUATIONS; ++i)
+	{
+		double result = 0.0;
+		ktEvaluate(program, memory, &result);
+		g_sink = result;
+	}
+	double evaluateTime = (now() - start) / KT_BENCH_EVALUATIONS;
+
+	bool ok = (g_sink == expected);
+	printf("%-56s %12.1f %12.1f %8.1fx%s\n", formula, compileTime * 1e9, evaluateTime * 1e9,
+		compileTime / evaluateTime, ok ? "" : "  MISMATCH");
+
+	ktProgramDestroy(program);
+
+	return ok;
+}
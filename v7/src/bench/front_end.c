@@ -0,0 +1,430 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Front end benchmark: ktTokenizerRun() and ktParserRun() (with a no-op
+// callback) over deterministic synthetic corpora. Reports throughput for the
+// whole corpus and the latency of each statement parsed on its own.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "parser.h"
+#include "tokenizer.h"
+#include "token_buffer.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktCorpus ktCorpus;
+
+enum ktBenchConstants
+{
+	KT_BENCH_CORPUS_SIZE = 4 * 1024 * 1024,
+	KT_BENCH_RUNS = 5,
+	KT_BENCH_LINE_MAX_LENGTH = 1024,
+	KT_BENCH_MAX_PAREN_DEPTH = 64,
+	KT_BENCH_MAX_NEGATE_CHAIN = 32,
+	KT_BENCH_MAX_FLAT_OPERANDS = 128,
+	KT_BENCH_EVENT_BATCH_SIZE = 256,
+};
+
+struct ktCorpus
+{
+	const char* name;
+	void (*generateLine)(ktRandom* random, char* line, size_t size);
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static void keywordLine(ktRandom* random, char* line, size_t size);
+static void letLine(ktRandom* random, char* line, size_t size);
+static void parenLine(ktRandom* random, char* line, size_t size);
+static void negateLine(ktRandom* random, char* line, size_t size);
+static void flatLine(ktRandom* random, char* line, size_t size);
+static void mixedLine(ktRandom* random, char* line, size_t size);
+
+static char* createContents(const ktCorpus* corpus, size_t size, size_t* out_lineCount);
+static void benchCorpus(ktParser* parser, const ktCorpus* corpus);
+static int compareDoubles(const void* a, const void* b);
+static double percentile(const double* sorted, size_t count, double p);
+
+static void onExprStmtAst(int errorCode, const ktAst* ast, void* userData);
+static void onEventBatch(ktEventRing* events, void* userData);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+static const ktCorpus CORPORA[] =
+{
+	{ "keywords", keywordLine },
+	{ "let", letLine },
+	{ "parens", parenLine },
+	{ "negate", negateLine },
+	{ "flat", flatLine },
+	{ "mixed", mixedLine },
+};
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	ktParserCallback callback =
+	{
+		.letStmt = onLetStmt,
+		.resetStmt = onErrorCode,
+		.varsStmt = onErrorCode,
+		.clearStmt = onNoArgs,
+		.exitStmt = onNoArgs,
+		.exprStmtBegin = onErrorCode,
+		.exprStmtEnd = onErrorCode,
+		.var = onVar,
+		.number = onNumber,
+		.symbol = onSymbol,
+		.error = onError,
+		.exprStmtAst = onExprStmtAst,
+		.eventBatch = onEventBatch,
+	};
+
+	size_t errorCount = 0;
+	ktParser* parser = ktParserCreate(&callback, &errorCount);
+
+	printf("%-9s %7s %9s | %-17s | %-17s | %-17s | %-17s | %s\n", "", "", "", "     tokenizer", "      parser", "   parser (AST)", " parser (events)", "ns/statement");
+	printf("%-9s %7s %9s | %8s %8s | %8s %8s | %8s %8s | %8s %8s | %6s %6s %6s %7s\n",
+		"corpus", "MB", "tokens", "MB/s", "Mtok/s", "MB/s", "Mtok/s", "MB/s", "Mtok/s", "MB/s", "Mtok/s", "p50", "p90", "p99", "max");
+
+	for (size_t i = 0; i < sizeof(CORPORA) / sizeof(CORPORA[0]); ++i)
+	{
+		benchCorpus(parser, &CORPORA[i]);
+	}
+
+	ktParserDestroy(parser);
+
+	if (errorCount > 0)
+	{
+		printf("%zu parser errors (the corpora should only have valid statements)\n", errorCount);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void benchCorpus(ktParser* parser, const ktCorpus* corpus)
+{
+	size_t lineCount = 0;
+	char* contents = createContents(corpus, KT_BENCH_CORPUS_SIZE, &lineCount);
+	double* latencies = malloc(lineCount * sizeof(double));
+	if (!contents || !latencies)
+	{
+		free(contents);
+		free(latencies);
+		return;
+	}
+
+	size_t length = strlen(contents);
+	double megabytes = length / (1024.0 * 1024.0);
+
+	ktTokenizer* tokenizer = ktTokenizerCreate();
+	ktTokenBuffer* tokens = ktTokenBufferCreate();
+
+	double tokenizerTime = 0.0;
+	double parserTime = 0.0;
+	double astTime = 0.0;
+	double eventsTime = 0.0;
+	for (int run = 0; run < KT_BENCH_RUNS; ++run)
+	{
+		double start = now();
+		ktTokenizerRun(tokenizer, contents, tokens);
+		double elapsed = now() - start;
+		if (run == 0 || elapsed < tokenizerTime)
+			tokenizerTime = elapsed;
+
+		start = now();
+		ktParserRun(parser, contents);
+		elapsed = now() - start;
+		if (run == 0 || elapsed < parserTime)
+			parserTime = elapsed;
+
+		ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_AST);
+		start = now();
+		ktParserRun(parser, contents);
+		elapsed = now() - start;
+		ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_CALLBACKS);
+		if (run == 0 || elapsed < astTime)
+			astTime = elapsed;
+
+		ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_EVENTS);
+		start = now();
+		ktParserRun(parser, contents);
+		elapsed = now() - start;
+		ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_CALLBACKS);
+		if (run == 0 || elapsed < eventsTime)
+			eventsTime = elapsed;
+	}
+
+	size_t tokenCount = tokens->count;
+
+	// Statement latency: each line is parsed on its own, in place.
+	size_t stmtCount = 0;
+	char* line = contents;
+	while (*line && stmtCount < lineCount)
+	{
+		char* end = strchr(line, '\n');
+		if (end)
+		{
+			*end = '\0';
+		}
+
+		double start = now();
+		ktParserRun(parser, line);
+		latencies[stmtCount++] = (now() - start) * 1e9;
+
+		if (!end)
+			break;
+
+		*end = '\n';
+		line = end + 1;
+	}
+
+	qsort(latencies, stmtCount, sizeof(double), compareDoubles);
+
+	printf("%-9s %7.1f %9zu | %8.1f %8.2f | %8.1f %8.2f | %8.1f %8.2f | %8.1f %8.2f | %6.0f %6.0f %6.0f %7.0f\n",
+		corpus->name, megabytes, tokenCount,
+		megabytes / tokenizerTime, tokenCount / tokenizerTime * 1e-6,
+		megabytes / parserTime, tokenCount / parserTime * 1e-6,
+		megabytes / astTime, tokenCount / astTime * 1e-6,
+		megabytes / eventsTime, tokenCount / eventsTime * 1e-6,
+		percentile(latencies, stmtCount, 0.50), percentile(latencies, stmtCount, 0.90),
+		percentile(latencies, stmtCount, 0.99), stmtCount > 0 ? latencies[stmtCount - 1] : 0.0);
+
+	ktTokenBufferDestroy(tokens);
+	ktTokenizerDestroy(tokenizer);
+	free(latencies);
+	free(contents);
+}
+
+//------------------------------------------------------------------------------
+// Fills about size bytes with whole lines from the corpus generator.
+//------------------------------------------------------------------------------
+char* createContents(const ktCorpus* corpus, size_t size, size_t* out_lineCount)
+{
+	char* contents = malloc(size + 1);
+	if (!contents)
+		return NULL;
+
+	ktRandom random = { 0x853C49E6748FEA9BULL };
+	char line[KT_BENCH_LINE_MAX_LENGTH];
+	size_t length = 0;
+	size_t lineCount = 0;
+
+	while (true)
+	{
+		corpus->generateLine(&random, line, sizeof(line));
+		size_t lineLength = strlen(line);
+		if (length + lineLength > size)
+			break;
+
+		memcpy(&contents[length], line, lineLength);
+		length += lineLength;
+		++lineCount;
+	}
+	contents[length] = '\0';
+
+	*out_lineCount = lineCount;
+	return contents;
+}
+
+//------------------------------------------------------------------------------
+// "VARS", "RESET", "CLEAR" and short LET statements.
+//------------------------------------------------------------------------------
+void keywordLine(ktRandom* random, char* line, size_t size)
+{
+	static const char* const KEYWORDS[] = { "VARS", "RESET", "CLEAR" };
+
+	if (randomNext(random, 4) == 0)
+	{
+		snprintf(line, size, "LET %c = %u\n", randomVar(random), randomNext(random, 100));
+	}
+	else
+	{
+		snprintf(line, size, "%s\n", KEYWORDS[randomNext(random, 3)]);
+	}
+}
+
+//------------------------------------------------------------------------------
+// "LET X = 12345.678"
+//------------------------------------------------------------------------------
+void letLine(ktRandom* random, char* line, size_t size)
+{
+	snprintf(line, size, "LET %c = %u.%u\n", randomVar(random), randomNext(random, 1000000), randomNext(random, 1000000));
+}
+
+//------------------------------------------------------------------------------
+// "((((A + B) * C) - D) / E)"
+//------------------------------------------------------------------------------
+void parenLine(ktRandom* random, char* line, size_t size)
+{
+	static const char OPERATORS[] = { '+', '-', '*', '/', '^' };
+
+	unsigned int depth = 1 + randomNext(random, KT_BENCH_MAX_PAREN_DEPTH);
+	size_t length = 0;
+
+	for (unsigned int i = 0; i < depth && length + 1 < size; ++i)
+	{
+		line[length++] = '(';
+	}
+
+	if (length + 1 < size)
+	{
+		line[length++] = randomVar(random);
+	}
+
+	for (unsigned int i = 0; i < depth && length + 8 < size; ++i)
+	{
+		length += (size_t)snprintf(&line[length], size - length, " %c %c)", OPERATORS[randomNext(random, 5)], randomVar(random));
+	}
+
+	snprintf(&line[length], size - length, "\n");
+}
+
+//------------------------------------------------------------------------------
+// "-----A * --B"
+//------------------------------------------------------------------------------
+void negateLine(ktRandom* random, char* line, size_t size)
+{
+	size_t length = 0;
+
+	for (int operand = 0; operand < 2; ++operand)
+	{
+		if (operand > 0 && length + 3 < size)
+		{
+			memcpy(&line[length], " * ", 3);
+			length += 3;
+		}
+
+		unsigned int chain = 1 + randomNext(random, KT_BENCH_MAX_NEGATE_CHAIN);
+		for (unsigned int i = 0; i < chain && length + 1 < size; ++i)
+		{
+			line[length++] = '-';
+		}
+
+		if (length + 1 < size)
+		{
+			line[length++] = randomVar(random);
+		}
+	}
+
+	snprintf(&line[length], size - length, "\n");
+}
+
+//------------------------------------------------------------------------------
+// "A + B * C - D / E ^ F ..." (long, without parentheses)
+//------------------------------------------------------------------------------
+void flatLine(ktRandom* random, char* line, size_t size)
+{
+	static const char OPERATORS[] = { '+', '-', '*', '/', '^' };
+
+	unsigned int operands = 2 + randomNext(random, KT_BENCH_MAX_FLAT_OPERANDS - 1);
+	size_t length = (size_t)snprintf(line, size, "%c", randomVar(random));
+
+	for (unsigned int i = 1; i < operands && length + 8 < size; ++i)
+	{
+		length += (size_t)snprintf(&line[length], size - length, " %c %c", OPERATORS[randomNext(random, 5)], randomVar(random));
+	}
+
+	snprintf(&line[length], size - length, "\n");
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+void mixedLine(ktRandom* random, char* line, size_t size)
+{
+	switch (randomNext(random, 4))
+	{
+	case 0: keywordLine(random, line, size); break;
+	case 1: letLine(random, line, size); break;
+	case 2: parenLine(random, line, size); break;
+	default: negateLine(random, line, size); break;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int compareDoubles(const void* a, const void* b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+
+	return (x > y) - (x < y);
+}
+
+//------------------------------------------------------------------------------
+// Nearest-rank percentile of sorted values.
+//------------------------------------------------------------------------------
+double percentile(const double* sorted, size_t count, double p)
+{
+	if (count == 0)
+		return 0.0;
+
+	size_t rank = (size_t)(p * (double)count);
+	return sorted[rank < count ? rank : count - 1];
+}
+
+//------------------------------------------------------------------------------
+// Counts failed expression statements (the corpora are all valid).
+//------------------------------------------------------------------------------
+void onExprStmtAst(int errorCode, const ktAst* ast, void* userData)
+{
+	(void)ast;
+	if (errorCode)
+	{
+		++*(size_t*)userData;
+	}
+}
+
+//------------------------------------------------------------------------------
+// The batched counterpart of onExprStmtAst().
+//------------------------------------------------------------------------------
+void onEventBatch(ktEventRing* events, void* userData)
+{
+	size_t count = 0;
+	const ktEvent* batch = NULL;
+	while ((batch = ktEventRingPeek(events, &count)), count > 0)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (batch[i].type == KT_EVENT_EXPR_STMT_END && batch[i].errorCode)
+			{
+				++*(size_t*)userData;
+			}
+		}
+
+		ktEventRingRelease(events, count);
+	}
+}
@@ -0,0 +1,156 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// JIT benchmark: the same compiled formulas evaluated with the stack code
+// (ktEvaluateStack()), the register code (ktEvaluateRegisters()) and the
+// native code (ktEvaluateJit()). All must give bit-identical results.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "jit.h"
+#include "memory.h"
+#include "program.h"
+#include "register_vm.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_EVALUATIONS = 10000000,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool benchFormula(const char* formula, ktMemory* memory);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+static const char* const FORMULAS[] =
+{
+	"A + B",
+	"A * B + C * D - E / F",
+	"(A + B) * (C - D) / (E + F)",
+	"A ^ B + C ^ D",
+	"-(A - B) * -(C + D)",
+	"((A + B) * C - D) / ((E - F) * G + H) + I * J - K / L",
+	"A * X * X * X + B * X * X + C * X + D",
+	"(A - B) ^ (C / D)",
+	"A * X ^ 3 + B * X ^ 2 + C / X + D",
+	"((A - 2) ^ 0.5 + 0.5 * B) / (C + 1)",
+};
+
+// Keeps the compiler from optimizing the evaluations away.
+static volatile double g_sink = 0.0;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	ktMemory* memory = ktMemoryCreate();
+	if (!memory)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		ktMemorySet(memory, i, 1.5 + 0.25 * (double)i);
+	}
+
+	printf("jit: %s\n", KT_JIT_ENABLED ? "enabled" : "disabled");
+	printf("%-56s %10s %10s %10s %9s\n", "formula", "stack", "register", "jit", "speedup");
+	printf("%-56s %10s %10s %10s %9s\n", "", "ns", "ns", "ns", "");
+
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(FORMULAS) / sizeof(FORMULAS[0]); ++i)
+	{
+		ok = benchFormula(FORMULAS[i], memory) && ok;
+	}
+
+	ktMemoryDestroy(memory);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool benchFormula(const char* formula, ktMemory* memory)
+{
+	ktProgram* program = ktCompile(formula);
+	if (!program || !program->hasRegisters || (!ktProgramCompileJit(program) && KT_JIT_ENABLED))
+	{
+		printf("%-56s failed to compile\n", formula);
+		ktProgramDestroy(program);
+		return false;
+	}
+
+	double stackResult = 0.0;
+	double registerResult = 0.0;
+	double jitResult = 0.0;
+	ktErrorType stackError = ktEvaluateStack(program, memory, &stackResult);
+	ktErrorType registerError = ktEvaluateRegisters(program, memory, &registerResult);
+	ktErrorType jitError = ktEvaluateJit(program, memory, &jitResult);
+
+	double start = now();
+	for (int i = 0; i < KT_BENCH_EVALUATIONS; ++i)
+	{
+		double result = 0.0;
+		ktEvaluateStack(program, memory, &result);
+		g_sink = result;
+	}
+	double stackTime = (now() - start) / KT_BENCH_EVALUATIONS;
+
+	start = now();
+	for (int i = 0; i < KT_BENCH_EVALUATIONS; ++i)
+	{
+		double result = 0.0;
+		ktEvaluateRegisters(program, memory, &result);
+		g_sink = result;
+	}
+	double registerTime = (now() - start) / KT_BENCH_EVALUATIONS;
+
+	start = now();
+	for (int i = 0; i < KT_BENCH_EVALUATIONS; ++i)
+	{
+		double result = 0.0;
+		ktEvaluateJit(program, memory, &result);
+		g_sink = result;
+	}
+	double jitTime = (now() - start) / KT_BENCH_EVALUATIONS;
+
+	// speedup is the JIT's over the faster of the two VMs.
+	double vmTime = stackTime < registerTime ? stackTime : registerTime;
+	bool ok = (stackError == registerError && stackError == jitError &&
+		memcmp(&stackResult, &registerResult, sizeof(double)) == 0 &&
+		memcmp(&stackResult, &jitResult, sizeof(double)) == 0);
+	printf("%-56s %10.1f %10.1f %10.1f %8.2fx%s\n", formula, stackTime * 1e9, registerTime * 1e9,
+		jitTime * 1e9, vmTime / jitTime, ok ? "" : "  MISMATCH");
+
+	ktProgramDestroy(program);
+
+	return ok;
+}
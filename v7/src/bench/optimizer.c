@@ -0,0 +1,202 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Optimizer benchmark: formulas with literals compiled as written
+// (ktParserSetOptimize(parser, false)) and optimized, then evaluated with
+// ktEvaluate(). Both must give the same results.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "memory.h"
+#include "parser.h"
+#include "program.h"
+#include "register_vm.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_EVALUATIONS = 10000000,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool benchFormula(const char* formula, ktMemory* memory);
+static ktProgram* compile(const char* formula, bool isOptimizing);
+static double timeEvaluations(const ktProgram* program, const ktMemory* memory);
+
+static void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+static const char* const FORMULAS[] =
+{
+	"A * 1 + B * 0",
+	"2 * 3.5 * A + 4 / 8",
+	"A / 4 + B / 0.5 - C / 1024",
+	"-(-A) * -(-B)",
+	"(A * 1 + 0 * 1) ^ 1 - B * -1",
+	"9.81 * 0.5 * T ^ 2 + 3 * (1 + 1) * T",
+	"(A ^ 0.5 + B ^ 0.5) / 2",
+	"((A + 2 * 2) * (3 - 1) / 4 - 1 / 2) * 100 / 8",
+};
+
+static const ktParserCallback CALLBACK =
+{
+	.letStmt = onLetStmt,
+	.resetStmt = onErrorCode,
+	.varsStmt = onErrorCode,
+	.clearStmt = onNoArgs,
+	.exitStmt = onNoArgs,
+	.exprStmtBegin = onErrorCode,
+	.exprStmtEnd = onErrorCode,
+	.var = onVar,
+	.number = onNumber,
+	.symbol = onVar,
+	.error = NULL,
+	.exprStmtAst = NULL,
+	.exprStmtProgram = onExprStmtProgram,
+	.eventBatch = NULL,
+	.errorRecord = NULL,
+};
+
+// Keeps the compiler from optimizing the evaluations away.
+static volatile double g_sink = 0.0;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	ktMemory* memory = ktMemoryCreate();
+	if (!memory)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		ktMemorySet(memory, i, 1.5 + 0.25 * (double)i);
+	}
+
+	printf("%-48s %6s %6s %10s %10s %9s\n", "formula", "instr", "instr", "as written", "optimized", "speedup");
+	printf("%-48s %6s %6s %10s %10s %9s\n", "", "", "", "ns", "ns", "");
+
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(FORMULAS) / sizeof(FORMULAS[0]); ++i)
+	{
+		ok = benchFormula(FORMULAS[i], memory) && ok;
+	}
+
+	ktMemoryDestroy(memory);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool benchFormula(const char* formula, ktMemory* memory)
+{
+	ktProgram* written = compile(formula, false);
+	ktProgram* optimized = compile(formula, true);
+	if (!written || !optimized)
+	{
+		printf("%-48s failed to compile\n", formula);
+		ktProgramDestroy(written);
+		ktProgramDestroy(optimized);
+		return false;
+	}
+
+	double writtenResult = 0.0;
+	double optimizedResult = 0.0;
+	ktErrorType writtenError = ktEvaluate(written, memory, &writtenResult);
+	ktErrorType optimizedError = ktEvaluate(optimized, memory, &optimizedResult);
+
+	double writtenTime = timeEvaluations(written, memory);
+	double optimizedTime = timeEvaluations(optimized, memory);
+
+	bool ok = (writtenError == optimizedError &&
+		memcmp(&writtenResult, &optimizedResult, sizeof(double)) == 0);
+	printf("%-48s %6zu %6zu %10.1f %10.1f %8.2fx%s\n", formula, written->count, optimized->count,
+		writtenTime * 1e9, optimizedTime * 1e9, writtenTime / optimizedTime, ok ? "" : "  MISMATCH");
+
+	ktProgramDestroy(written);
+	ktProgramDestroy(optimized);
+
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+// Like ktCompile(), with or without the optimizer.
+//------------------------------------------------------------------------------
+ktProgram* compile(const char* formula, bool isOptimizing)
+{
+	ktProgram* program = NULL;
+	ktParser* parser = ktParserCreate(&CALLBACK, &program);
+	if (!parser)
+		return NULL;
+
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_PROGRAM);
+	ktParserSetErrorMode(parser, KT_PARSER_ERROR_MODE_COLLECT);
+	ktParserSetOptimize(parser, isOptimizing);
+	ktParserRun(parser, formula);
+	if (ktParserErrorCount(parser) > 0 || (program && !ktProgramCompileRegisters(program)))
+	{
+		ktProgramDestroy(program);
+		program = NULL;
+	}
+	ktParserDestroy(parser);
+
+	return program;
+}
+
+//------------------------------------------------------------------------------
+// Seconds per evaluation.
+//------------------------------------------------------------------------------
+double timeEvaluations(const ktProgram* program, const ktMemory* memory)
+{
+	double start = now();
+	for (int i = 0; i < KT_BENCH_EVALUATIONS; ++i)
+	{
+		double result = 0.0;
+		ktEvaluate(program, memory, &result);
+		g_sink = result;
+	}
+
+	return (now() - start) / KT_BENCH_EVALUATIONS;
+}
+
+//------------------------------------------------------------------------------
+// The parser reuses its program for the next statement.
+//------------------------------------------------------------------------------
+void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData)
+{
+	ktProgram** out_program = userData;
+	if (errorCode == 0 && !*out_program)
+	{
+		*out_program = ktProgramCopy(program);
+	}
+}
@@ -0,0 +1,271 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Power benchmark: ktPow() against libm's pow() for the exponents it handles
+// itself (how far apart they are, in ulps, and ns per call), then "X ^ N"
+// (exponent known at run time) against "X ^ 2" (exponent known when
+// compiling, KT_OP_SQUARE and friends) evaluated with ktEvaluate().
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "memory.h"
+#include "program.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_ACCURACY_SAMPLES = 4000000,
+	KT_BENCH_INPUTS = 1024,
+	KT_BENCH_CALLS = 20000000,
+	KT_BENCH_EVALUATIONS = 10000000,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool benchExponent(double exponent, const double* inputs);
+static bool benchFormula(size_t index, ktMemory* memory);
+static double maxUlps(double exponent);
+static int64_t orderedBits(double number);
+static double randomDouble(void);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+// 2.5 goes to pow() either way.
+static const double EXPONENTS[] = { 2.0, 3.0, -1.0, 2.5 };
+
+static const char* const FORMULAS[] =
+{
+	"X ^ 2",
+	"X ^ 3",
+	"X ^ -1",
+	"A * X ^ 3 + B * X ^ 2 + C * X + D",
+};
+
+// The formulas above with the exponents in variables: N (see
+// FORMULA_EXPONENTS) and M (2).
+static const char* const VARIABLE_FORMULAS[] =
+{
+	"X ^ N",
+	"X ^ N",
+	"X ^ N",
+	"A * X ^ N + B * X ^ M + C * X + D",
+};
+
+static const double FORMULA_EXPONENTS[] = { 2.0, 3.0, -1.0, 3.0 };
+
+// Keeps the compiler from optimizing the calls away, and from seeing the
+// exponent.
+static volatile double g_sink = 0.0;
+static volatile double g_exponent = 0.0;
+
+static uint64_t g_random = 88172645463325252ULL;
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	double inputs[KT_BENCH_INPUTS];
+	for (size_t i = 0; i < KT_BENCH_INPUTS; ++i)
+	{
+		inputs[i] = 0.5 + 1.5 * (double)i / KT_BENCH_INPUTS;
+	}
+
+	printf("%-8s %8s %10s %10s %9s\n", "exponent", "max", "pow", "ktPow", "speedup");
+	printf("%-8s %8s %10s %10s %9s\n", "", "ulps", "ns", "ns", "");
+
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(EXPONENTS) / sizeof(EXPONENTS[0]); ++i)
+	{
+		ok = benchExponent(EXPONENTS[i], inputs) && ok;
+	}
+
+	ktMemory* memory = ktMemoryCreate();
+	if (!memory)
+		return EXIT_FAILURE;
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		ktMemorySet(memory, i, 1.5 + 0.25 * (double)i);
+	}
+
+	printf("\n%-36s %12s %12s %9s\n", "formula", "run time exp", "compile time", "speedup");
+	printf("%-36s %12s %12s %9s\n", "", "ns", "ns", "");
+
+	for (size_t i = 0; i < sizeof(FORMULAS) / sizeof(FORMULAS[0]); ++i)
+	{
+		ktMemorySet(memory, 'M' - 'A', 2.0);
+		ktMemorySet(memory, 'N' - 'A', FORMULA_EXPONENTS[i]);
+		ok = benchFormula(i, memory) && ok;
+	}
+
+	ktMemoryDestroy(memory);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+bool benchExponent(double exponent, const double* inputs)
+{
+	double ulps = maxUlps(exponent);
+
+	g_exponent = exponent;
+	double start = now();
+	for (int i = 0; i < KT_BENCH_CALLS; ++i)
+	{
+		g_sink = pow(inputs[i & (KT_BENCH_INPUTS - 1)], g_exponent);
+	}
+	double powTime = (now() - start) / KT_BENCH_CALLS;
+
+	start = now();
+	for (int i = 0; i < KT_BENCH_CALLS; ++i)
+	{
+		g_sink = ktPow(inputs[i & (KT_BENCH_INPUTS - 1)], g_exponent);
+	}
+	double ktPowTime = (now() - start) / KT_BENCH_CALLS;
+
+	bool ok = (ulps <= 1.0);
+	printf("%-8g %8g %10.1f %10.1f %8.2fx%s\n", exponent, ulps, powTime * 1e9, ktPowTime * 1e9,
+		powTime / ktPowTime, ok ? "" : "  TOO FAR FROM POW");
+
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+// Both forms of FORMULAS[index] must give the same result.
+//------------------------------------------------------------------------------
+bool benchFormula(size_t index, ktMemory* memory)
+{
+	const char* formula = FORMULAS[index];
+	ktProgram* variable = ktCompile(VARIABLE_FORMULAS[index]);
+	ktProgram* constant = ktCompile(formula);
+	if (!variable || !constant)
+	{
+		printf("%-36s failed to compile\n", formula);
+		ktProgramDestroy(variable);
+		ktProgramDestroy(constant);
+		return false;
+	}
+
+	double variableResult = 0.0;
+	double constantResult = 0.0;
+	ktEvaluate(variable, memory, &variableResult);
+	ktEvaluate(constant, memory, &constantResult);
+
+	double start = now();
+	for (int j = 0; j < KT_BENCH_EVALUATIONS; ++j)
+	{
+		double result = 0.0;
+		ktEvaluate(variable, memory, &result);
+		g_sink = result;
+	}
+	double variableTime = (now() - start) / KT_BENCH_EVALUATIONS;
+
+	start = now();
+	for (int j = 0; j < KT_BENCH_EVALUATIONS; ++j)
+	{
+		double result = 0.0;
+		ktEvaluate(constant, memory, &result);
+		g_sink = result;
+	}
+	double constantTime = (now() - start) / KT_BENCH_EVALUATIONS;
+
+	bool ok = (memcmp(&variableResult, &constantResult, sizeof(double)) == 0);
+	printf("%-36s %12.1f %12.1f %8.2fx%s\n", formula, variableTime * 1e9, constantTime * 1e9,
+		variableTime / constantTime, ok ? "" : "  MISMATCH");
+
+	ktProgramDestroy(variable);
+	ktProgramDestroy(constant);
+
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+// Largest distance between ktPow() and pow() over random doubles (any bit
+// pattern, and around 1, where most formulas live).
+//------------------------------------------------------------------------------
+double maxUlps(double exponent)
+{
+	double worst = 0.0;
+	for (int i = 0; i < KT_BENCH_ACCURACY_SAMPLES; ++i)
+	{
+		double x = randomDouble();
+		if (i % 2 == 0)
+		{
+			x = fmod(x, 4.0);
+		}
+
+		double expected = pow(x, exponent);
+		double result = ktPow(x, exponent);
+		if (isnan(expected) || isnan(result))
+		{
+			if (isnan(expected) != isnan(result))
+				return INFINITY;
+
+			continue;
+		}
+
+		double ulps = fabs((double)(orderedBits(expected) - orderedBits(result)));
+		if (ulps > worst)
+		{
+			worst = ulps;
+		}
+	}
+
+	return worst;
+}
+
+//------------------------------------------------------------------------------
+// Bits of a double as an integer that counts ulps across zero.
+//------------------------------------------------------------------------------
+int64_t orderedBits(double number)
+{
+	int64_t bits = 0;
+	memcpy(&bits, &number, sizeof(double));
+
+	return bits < 0 ? INT64_MIN - bits : bits;
+}
+
+//------------------------------------------------------------------------------
+// Any bit pattern (xorshift64).
+//------------------------------------------------------------------------------
+double randomDouble(void)
+{
+	g_random ^= g_random << 13;
+	g_random ^= g_random >> 7;
+	g_random ^= g_random << 17;
+
+	double number = 0.0;
+	memcpy(&number, &g_random, sizeof(double));
+
+	return number;
+}
@@ -0,0 +1,180 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Statement cache benchmark: a stream of formulas where a handful of them
+// repeat most of the time, run with ktCompile() + ktEvaluate() for every
+// statement (capacity 0) and through a ktStmtCache of several capacities
+// (ktCompile() only on a miss). Reports ns per statement and the counters.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "memory.h"
+#include "program.h"
+#include "stmt_cache.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_STATEMENTS = 200000,
+
+	// Out of 100 statements, this many are one of the first
+	// KT_BENCH_HOT_FORMULAS formulas; the rest are any of them.
+	KT_BENCH_HOT_PERCENT = 80,
+	KT_BENCH_HOT_FORMULAS = 4,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool benchCapacity(size_t capacity, const size_t* stream, ktMemory* memory, double* out_checksum);
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+static const char* const FORMULAS[] =
+{
+	"A + B",
+	"A * B + C * D - E / F",
+	"(A + B) * (C - D) / (E + F)",
+	"A * X * X * X + B * X * X + C * X + D",
+	"A ^ B + C ^ D",
+	"-(A - B) * -(C + D)",
+	"((A + B) * C - D) / ((E - F) * G + H) + I * J - K / L",
+	"A - B - C - D - E - F - G - H",
+	"(A + B) ^ (C - D)",
+	"X * Y + Y * Z + Z * X",
+	"A / (B + C / (D + E / (F + G)))",
+	"--A + --B",
+	"(P + Q) * (R + S) * (T + U)",
+	"M * N - O * P",
+	"A ^ -B",
+	"(A * B - C) / (D * E - F)",
+};
+
+static const size_t CAPACITIES[] = { 0, 2, 4, 8, 16 };
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	const unsigned int formulaCount = sizeof(FORMULAS) / sizeof(FORMULAS[0]);
+
+	size_t* stream = malloc(KT_BENCH_STATEMENTS * sizeof(size_t));
+	ktMemory* memory = ktMemoryCreate();
+	if (!stream || !memory)
+	{
+		free(stream);
+		ktMemoryDestroy(memory);
+		return EXIT_FAILURE;
+	}
+
+	ktRandom random = { 0x853c49e6748fea9bULL };
+	for (size_t i = 0; i < KT_BENCH_STATEMENTS; ++i)
+	{
+		bool isHot = randomNext(&random, 100) < KT_BENCH_HOT_PERCENT;
+		stream[i] = randomNext(&random, isHot ? KT_BENCH_HOT_FORMULAS : formulaCount);
+	}
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		ktMemorySet(memory, i, 1.5 + 0.25 * (double)i);
+	}
+
+	printf("%u formulas, %d statements\n", formulaCount, KT_BENCH_STATEMENTS);
+	printf("%-8s %14s %9s %9s %9s\n", "capacity", "ns/statement", "hits", "misses", "evictions");
+
+	// Every capacity must get the same results as compiling every statement.
+	double expected = 0.0;
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(CAPACITIES) / sizeof(CAPACITIES[0]); ++i)
+	{
+		double checksum = 0.0;
+		ok = benchCapacity(CAPACITIES[i], stream, memory, &checksum) && ok;
+
+		if (i == 0)
+		{
+			expected = checksum;
+		}
+		else if (checksum != expected)
+		{
+			printf("checksum mismatch\n");
+			ok = false;
+		}
+	}
+
+	ktMemoryDestroy(memory);
+	free(stream);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//------------------------------------------------------------------------------
+// Capacity 0 compiles every statement.
+//------------------------------------------------------------------------------
+bool benchCapacity(size_t capacity, const size_t* stream, ktMemory* memory, double* out_checksum)
+{
+	ktStmtCache* cache = ktStmtCacheCreate(capacity);
+	double checksum = 0.0;
+
+	double start = now();
+	for (size_t i = 0; i < KT_BENCH_STATEMENTS; ++i)
+	{
+		const char* formula = FORMULAS[stream[i]];
+		size_t length = strlen(formula);
+
+		const ktProgram* program = ktStmtCacheGet(cache, formula, length);
+		ktProgram* compiled = NULL;
+		if (!program)
+		{
+			compiled = ktCompile(formula);
+			if (!compiled)
+			{
+				printf("failed to compile '%s'\n", formula);
+				ktStmtCacheDestroy(cache);
+				return false;
+			}
+
+			ktStmtCachePut(cache, formula, length, compiled);
+			program = compiled;
+		}
+
+		double result = 0.0;
+		ktEvaluate(program, memory, &result);
+		checksum += result;
+
+		ktProgramDestroy(compiled);
+	}
+	double elapsed = now() - start;
+
+	printf("%-8zu %14.1f %9zu %9zu %9zu\n", capacity, elapsed * 1e9 / KT_BENCH_STATEMENTS,
+		cache ? cache->hits : 0, cache ? cache->misses : (size_t)KT_BENCH_STATEMENTS, cache ? cache->evictions : 0);
+
+	ktStmtCacheDestroy(cache);
+	*out_checksum = checksum;
+
+	return true;
+}
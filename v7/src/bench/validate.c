@@ -0,0 +1,188 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Bulk validation benchmark: ktParserFeed() of a deterministic corpus of
+// (mostly) invalid statements, with the errors formatted into messages
+// (KT_PARSER_ERROR_MODE_MESSAGES) or only collected as records
+// (KT_PARSER_ERROR_MODE_COLLECT). Reports throughput and ns per statement.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "parser.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktBenchConstants
+{
+	KT_BENCH_CORPUS_SIZE = 4 * 1024 * 1024,
+	KT_BENCH_RUNS = 5,
+	KT_BENCH_LINE_MAX_LENGTH = 64,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static void invalidLine(ktRandom* random, char* line, size_t size);
+static char* createContents(size_t size, size_t* out_lineCount);
+static double benchMode(ktParser* parser, ktParserErrorMode mode, const char* contents, size_t* messageCount, size_t* out_errorCount);
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+int main(void)
+{
+	ktParserCallback callback =
+	{
+		.letStmt = onLetStmt,
+		.resetStmt = onErrorCode,
+		.varsStmt = onErrorCode,
+		.clearStmt = onNoArgs,
+		.exitStmt = onNoArgs,
+		.exprStmtBegin = onErrorCode,
+		.exprStmtEnd = onErrorCode,
+		.var = onVar,
+		.number = onNumber,
+		.symbol = onSymbol,
+		.error = onError,
+	};
+
+	size_t lineCount = 0;
+	char* contents = createContents(KT_BENCH_CORPUS_SIZE, &lineCount);
+	if (!contents)
+		return EXIT_FAILURE;
+
+	size_t messageCount = 0;
+	ktParser* parser = ktParserCreate(&callback, &messageCount);
+
+	size_t messageErrors = 0;
+	size_t collectErrors = 0;
+	double messagesTime = benchMode(parser, KT_PARSER_ERROR_MODE_MESSAGES, contents, &messageCount, &messageErrors);
+	double collectTime = benchMode(parser, KT_PARSER_ERROR_MODE_COLLECT, contents, &messageCount, &collectErrors);
+
+	double megabytes = (double)strlen(contents) / (1024.0 * 1024.0);
+	printf("%zu statements, %.2f MB\n", lineCount, megabytes);
+	printf("%-9s %9s %8s %14s\n", "errors", "count", "MB/s", "ns/statement");
+	printf("%-9s %9zu %8.1f %14.1f\n", "messages", messageErrors, megabytes / messagesTime, messagesTime * 1e9 / (double)lineCount);
+	printf("%-9s %9zu %8.1f %14.1f\n", "collect", collectErrors, megabytes / collectTime, collectTime * 1e9 / (double)lineCount);
+
+	ktParserDestroy(parser);
+	free(contents);
+
+	// Both modes must find the same errors.
+	if (messageErrors != collectErrors)
+	{
+		printf("error count mismatch\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// Best of KT_BENCH_RUNS runs over the whole corpus, fed in one go (every line
+// is parsed as a statement of its own, as in the REPL). messageCount is the error
+// callback's counter (the parser's userData).
+//------------------------------------------------------------------------------
+double benchMode(ktParser* parser, ktParserErrorMode mode, const char* contents, size_t* messageCount, size_t* out_errorCount)
+{
+	size_t length = strlen(contents);
+	double best = 0.0;
+
+	ktParserSetErrorMode(parser, mode);
+
+	for (int run = 0; run < KT_BENCH_RUNS; ++run)
+	{
+		*messageCount = 0;
+		ktParserClearErrors(parser);
+
+		double start = now();
+		ktParserFeed(parser, contents, length);
+		ktParserFinish(parser);
+		double elapsed = now() - start;
+
+		if (run == 0 || elapsed < best)
+		{
+			best = elapsed;
+		}
+	}
+
+	*out_errorCount = mode == KT_PARSER_ERROR_MODE_COLLECT ? ktParserErrorCount(parser) : *messageCount;
+
+	return best;
+}
+
+//------------------------------------------------------------------------------
+// The kind of formulas that fail validation: unknown commands, LET without a
+// variable or value, missing operands, unbalanced parentheses, stray tokens.
+// One in eight lines is valid.
+//------------------------------------------------------------------------------
+void invalidLine(ktRandom* random, char* line, size_t size)
+{
+	char a = randomVar(random);
+	char b = randomVar(random);
+
+	switch (randomNext(random, 8))
+	{
+	case 0: snprintf(line, size, "%c%c%c\n", a, b, randomVar(random)); break;
+	case 1: snprintf(line, size, "LET %c %u\n", a, randomNext(random, 1000)); break;
+	case 2: snprintf(line, size, "LET = %u\n", randomNext(random, 1000)); break;
+	case 3: snprintf(line, size, "%u = %c\n", randomNext(random, 1000), a); break;
+	case 4: snprintf(line, size, "%c + * %c\n", a, b); break;
+	case 5: snprintf(line, size, "((%c - %c) / %c\n", a, b, randomVar(random)); break;
+	case 6: snprintf(line, size, "VARS %c\n", a); break;
+	default: snprintf(line, size, "%c * (%c + %c)\n", a, b, randomVar(random)); break;
+	}
+}
+
+//------------------------------------------------------------------------------
+// 
+//------------------------------------------------------------------------------
+char* createContents(size_t size, size_t* out_lineCount)
+{
+	char* contents = malloc(size + 1);
+	if (!contents)
+		return NULL;
+
+	ktRandom random = { 0x853c49e6748fea9bULL };
+	size_t length = 0;
+	size_t lineCount = 0;
+	char line[KT_BENCH_LINE_MAX_LENGTH];
+
+	for (;;)
+	{
+		invalidLine(&random, line, KT_BENCH_LINE_MAX_LENGTH);
+		size_t lineLength = strlen(line);
+		if (length + lineLength > size)
+			break;
+
+		memcpy(contents + length, line, lineLength);
+		length += lineLength;
+		++lineCount;
+	}
+
+	contents[length] = '\0';
+	*out_lineCount = lineCount;
+
+	return contents;
+}
@@ -0,0 +1,68 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdlib.h>
+#include "alloc.h"
+
+#if !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+#if !defined(__STDC_NO_ATOMICS__)
+static atomic_size_t g_allocCount = 0;
+#else
+static size_t g_allocCount = 0;
+#endif
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void* ktAlloc(size_t size)
+{
+	++g_allocCount;
+	return malloc(size);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void* ktRealloc(void* ptr, size_t size)
+{
+	++g_allocCount;
+	return realloc(ptr, size);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktFree(void* ptr)
+{
+	free(ptr);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t ktAllocCount(void)
+{
+	return g_allocCount;
+}
@@ -14,36 +14,24 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
+#ifndef __KISHITECH_ALLOC_H__
+#define __KISHITECH_ALLOC_H__
+
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include "token_node.h"
-#include "utils.h"
+#include <stddef.h>
 
 //------------------------------------------------------------------------------
-// 
+// Function definitions
 //------------------------------------------------------------------------------
-ktTokenNode* ktTokenNodeCreate(ktToken* token)
-{
-	ktTokenNode* node = malloc(sizeof(ktTokenNode));
-	if (node)
-	{
-		node->token = token;
-		node->previous = NULL;
-		node->next = NULL;
-	}
-
-	return node;
-}
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void ktTokenNodeDestroy(ktTokenNode* node)
-{
-	ktTokenDestroy(node->token);
-	node->previous = NULL;
-	node->next = NULL;
+// All heap memory used by the kt modules goes through these functions, which
+// count every allocation (ktAlloc() and ktRealloc()) so we can check that a
+// warmed-up REPL or batch run doesn't touch the heap per statement.
+void* ktAlloc(size_t size);
+void* ktRealloc(void* ptr, size_t size);
+void ktFree(void* ptr);
+size_t ktAllocCount(void);
 
-	SAFE_DELETE(node);
-}
+#endif // __KISHITECH_ALLOC_H__
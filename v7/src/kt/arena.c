@@ -17,91 +17,98 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include <stdlib.h>
-#include <string.h>
-#include "double_stack.h"
+#include "arena.h"
+#include "alloc.h"
 #include "utils.h"
 
 //------------------------------------------------------------------------------
-// 
+// Function definitions
+//------------------------------------------------------------------------------
+static bool grow(ktArena* arena, size_t minCapacity);
+
+//------------------------------------------------------------------------------
+//
 //------------------------------------------------------------------------------
-ktDoubleStack* ktDoubleStackCreate(void)
+ktArena* ktArenaCreate(void)
 {
-	ktDoubleStack* stack = malloc(sizeof(ktDoubleStack));
-	ktDoubleStackClear(stack);
+	ktArena* arena = ktAlloc(sizeof(ktArena));
+	if (arena)
+	{
+		arena->data = NULL;
+		arena->size = 0;
+		arena->capacity = 0;
+	}
 
-	return stack;
+	return arena;
 }
 
 //------------------------------------------------------------------------------
-// 
+//
 //------------------------------------------------------------------------------
-void ktDoubleStackDestroy(ktDoubleStack* stack)
+void ktArenaDestroy(ktArena* arena)
 {
-	SAFE_DELETE(stack);
+	if (arena)
+	{
+		SAFE_DELETE(arena->data);
+		SAFE_DELETE(arena);
+	}
 }
 
 //------------------------------------------------------------------------------
-// 
+// Reserves size bytes aligned to alignment (a power of two) and returns their
+// offset from the start of the arena.
 //------------------------------------------------------------------------------
-void ktDoubleStackPush(ktDoubleStack* stack, double value)
+bool ktArenaAlloc(ktArena* arena, size_t size, size_t alignment, size_t* out_offset)
 {
-	if (!stack || ktDoubleStackIsFull(stack))
-		return;
+	if (!arena)
+		return false;
+
+	size_t offset = (arena->size + alignment - 1) & ~(alignment - 1);
+	if (offset + size > arena->capacity && !grow(arena, offset + size))
+		return false;
 
-	stack->data[stack->count] = value;
-	++stack->count;
+	arena->size = offset + size;
+	*out_offset = offset;
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Pointers are only valid until the next ktArenaAlloc().
 //------------------------------------------------------------------------------
-double ktDoubleStackPop(ktDoubleStack* stack)
+void* ktArenaAt(const ktArena* arena, size_t offset)
 {
-	if (!stack || ktDoubleStackIsEmpty(stack))
-		return '\0';
-
-	--stack->count;
-	double top = stack->data[stack->count];
-	stack->data[stack->count] = '\0';
-
-	return top;
+	return &arena->data[offset];
 }
 
 //------------------------------------------------------------------------------
-// 
+//
 //------------------------------------------------------------------------------
-double ktDoubleStackTop(ktDoubleStack* stack)
+void ktArenaReset(ktArena* arena)
 {
-	if (!stack || ktDoubleStackIsEmpty(stack))
-		return '\0';
+	if (!arena)
+		return;
 
-	return stack->data[stack->count - 1];
+	arena->size = 0;
 }
+
 //------------------------------------------------------------------------------
-// 
+//
 //------------------------------------------------------------------------------
-void ktDoubleStackClear(ktDoubleStack* stack)
+bool grow(ktArena* arena, size_t minCapacity)
 {
-	if (stack)
+	size_t capacity = arena->capacity > 0 ? arena->capacity : KT_ARENA_INITIAL_CAPACITY;
+	while (capacity < minCapacity)
 	{
-		memset(stack->data, 0, KT_DOUBLE_STACK_SIZE * sizeof(double));
-		stack->count = 0;
+		capacity *= 2;
 	}
-}
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-bool ktDoubleStackIsEmpty(ktDoubleStack* stack)
-{
-	return stack && stack->count == 0;
-}
+	unsigned char* data = ktRealloc(arena->data, capacity);
+	if (!data)
+		return false;
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-bool ktDoubleStackIsFull(ktDoubleStack* stack)
-{
-	return stack && stack->count == KT_DOUBLE_STACK_SIZE;
+	arena->data = data;
+	arena->capacity = capacity;
+
+	return true;
 }
@@ -14,42 +14,44 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
-#ifndef __KISHITECH_TOKEN_LIST_H__
-#define __KISHITECH_TOKEN_LIST_H__
+#ifndef __KISHITECH_ARENA_H__
+#define __KISHITECH_ARENA_H__
 
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
 #include <stddef.h>
 #include <stdbool.h>
-#include "token_node.h"
 
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
-typedef struct ktTokenList ktTokenList;
+typedef struct ktArena ktArena;
 
-struct ktTokenList
+enum ktArenaConstants
 {
-	ktTokenNode* head;
-	ktTokenNode* tail;
-	ktTokenNode* cursor;
-	size_t count;
+	KT_ARENA_INITIAL_CAPACITY = 1024,
+};
+
+// Bump allocator over one contiguous block. The block is reallocated when it
+// runs out of room, so allocations are referred to by their offset (which
+// stays valid) instead of by pointer. Resetting is O(1) and keeps the capacity,
+// so an arena that is reset for every statement stops touching the heap once
+// it is big enough.
+struct ktArena
+{
+	unsigned char* data;
+	size_t size;
+	size_t capacity;
 };
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-ktTokenList* ktTokenListCreate(void);
-void ktTokenListDestroy(ktTokenList* list);
-void ktTokenListInsert(ktTokenList* list, ktToken* token);
-void ktTokenListAppend(ktTokenList* list, ktToken* token);
-void ktTokenListRemoveHead(ktTokenList* list);
-void ktTokenListRemoveTail(ktTokenList* list);
-void ktTokenListClear(ktTokenList* list);
-bool ktTokenListIsEmpty(const ktTokenList* list);
-void ktTokenListCursorReset(ktTokenList* list);
-void ktTokenListCursorAdvance(ktTokenList* list);
-void ktTokenListCursorRetreat(ktTokenList* list);
+ktArena* ktArenaCreate(void);
+void ktArenaDestroy(ktArena* arena);
+bool ktArenaAlloc(ktArena* arena, size_t size, size_t alignment, size_t* out_offset);
+void* ktArenaAt(const ktArena* arena, size_t offset);
+void ktArenaReset(ktArena* arena);
 
-#endif // __KISHITECH_TOKEN_LIST_H__
+#endif // __KISHITECH_ARENA_H__
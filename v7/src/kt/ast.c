@@ -17,91 +17,114 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include <stdlib.h>
-#include <string.h>
-#include "char_stack.h"
+#include <stdio.h>
+#include "ast.h"
+#include "alloc.h"
 #include "utils.h"
 
 //------------------------------------------------------------------------------
-// 
+// Globals (argh!)
 //------------------------------------------------------------------------------
-ktCharStack* ktCharStackCreate(void)
+const char* const KT_AST_NODE_TYPE_STR[] =
 {
-	ktCharStack* stack = malloc(sizeof(ktCharStack));
-	ktCharStackClear(stack);
+#define X_MACRO(name) #name,
+	KT_AST_NODE_TYPE_LIST
+#undef X_MACRO
+};
 
-	return stack;
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktAst* ktAstCreate(void)
+{
+	ktAst* ast = ktAlloc(sizeof(ktAst));
+	if (ast)
+	{
+		ast->arena = ktArenaCreate();
+		ast->count = 0;
+		ast->root = KT_AST_NONE;
+	}
+
+	return ast;
 }
 
 //------------------------------------------------------------------------------
-// 
+//
 //------------------------------------------------------------------------------
-void ktCharStackDestroy(ktCharStack* stack)
+void ktAstDestroy(ktAst* ast)
 {
-	SAFE_DELETE(stack);
+	if (ast)
+	{
+		ktArenaDestroy(ast->arena);
+		SAFE_DELETE(ast);
+	}
 }
 
 //------------------------------------------------------------------------------
-// 
+// O(1): the arena keeps its memory for the next statement.
 //------------------------------------------------------------------------------
-void ktCharStackPush(ktCharStack* stack, char value)
+void ktAstReset(ktAst* ast)
 {
-	if (!stack || ktCharStackIsFull(stack))
+	if (!ast)
 		return;
 
-	stack->data[stack->count] = value;
-	++stack->count;
+	ktArenaReset(ast->arena);
+	ast->count = 0;
+	ast->root = KT_AST_NONE;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Returns the index of the new node, or KT_AST_NONE if it couldn't be stored.
 //------------------------------------------------------------------------------
-char ktCharStackPop(ktCharStack* stack)
+ktAstIndex ktAstAppend(ktAst* ast, ktAstNode node)
 {
-	if (!stack || ktCharStackIsEmpty(stack))
-		return '\0';
+	size_t offset = 0;
+	if (!ast || !ktArenaAlloc(ast->arena, sizeof(ktAstNode), _Alignof(ktAstNode), &offset))
+		return KT_AST_NONE;
 
-	--stack->count;
-	char top = stack->data[stack->count];
-	stack->data[stack->count] = '\0';
+	*(ktAstNode*)ktArenaAt(ast->arena, offset) = node;
 
-	return top;
+	return (ktAstIndex)ast->count++;
 }
 
 //------------------------------------------------------------------------------
-// 
+//
 //------------------------------------------------------------------------------
-char ktCharStackTop(ktCharStack* stack)
+const ktAstNode* ktAstGet(const ktAst* ast, ktAstIndex index)
 {
-	if (!stack || ktCharStackIsEmpty(stack))
-		return '\0';
-
-	return stack->data[stack->count - 1];
+	return (const ktAstNode*)ktArenaAt(ast->arena, (size_t)index * sizeof(ktAstNode));
 }
+
 //------------------------------------------------------------------------------
-// 
+// Prints the tree below index as an s-expression, e.g. (KT_AST_ADD A B).
 //------------------------------------------------------------------------------
-void ktCharStackClear(ktCharStack* stack)
+void ktAstPrint(const ktAst* ast, ktAstIndex index)
 {
-	if (stack)
+	if (index == KT_AST_NONE)
 	{
-		memset(stack->data, 0, KT_CHAR_STACK_SIZE);
-		stack->count = 0;
+		printf("_");
+		return;
 	}
-}
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-bool ktCharStackIsEmpty(ktCharStack* stack)
-{
-	return stack && stack->count == 0;
-}
+	const ktAstNode* node = ktAstGet(ast, index);
+	if (node->type == KT_AST_VAR)
+	{
+		printf("%c", node->var);
+		return;
+	}
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-bool ktCharStackIsFull(ktCharStack* stack)
-{
-	return stack && stack->count == KT_CHAR_STACK_SIZE;
+	if (node->type == KT_AST_NUMBER)
+	{
+		printf("%g", node->number);
+		return;
+	}
+
+	printf("(%s ", KT_AST_NODE_TYPE_STR[node->type]);
+	ktAstPrint(ast, node->left);
+	if (node->type != KT_AST_NEG)
+	{
+		printf(" ");
+		ktAstPrint(ast, node->right);
+	}
+	printf(")");
 }
@@ -0,0 +1,94 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_AST_H__
+#define __KISHITECH_AST_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include "arena.h"
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_AST_NODE_TYPE_LIST \
+	X_MACRO(KT_AST_VAR) \
+	X_MACRO(KT_AST_NUMBER) \
+	X_MACRO(KT_AST_NEG) \
+	X_MACRO(KT_AST_ADD) \
+	X_MACRO(KT_AST_SUB) \
+	X_MACRO(KT_AST_MUL) \
+	X_MACRO(KT_AST_DIV) \
+	X_MACRO(KT_AST_POW)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktAst ktAst;
+typedef struct ktAstNode ktAstNode;
+typedef int ktAstIndex;
+
+enum ktAstNodeType
+{
+#define X_MACRO(name) name,
+	KT_AST_NODE_TYPE_LIST
+#undef X_MACRO
+};
+
+typedef enum ktAstNodeType ktAstNodeType;
+
+enum ktAstConstants
+{
+	// Index of a missing node (e.g. the right operand of "A +").
+	KT_AST_NONE = -1,
+};
+
+// Nodes refer to their children by index. KT_AST_NEG only uses left, number
+// is the value of a KT_AST_NUMBER.
+struct ktAstNode
+{
+	unsigned char type;
+	char var;
+	ktAstIndex left;
+	ktAstIndex right;
+	double number;
+};
+
+// Expression tree of one statement, stored in an arena. Children are always
+// appended before their parent, so the nodes are in post-order: walking them
+// from index 0 up to the root evaluates the expression.
+struct ktAst
+{
+	ktArena* arena;
+	size_t count;
+	ktAstIndex root;
+};
+
+extern const char* const KT_AST_NODE_TYPE_STR[];
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktAst* ktAstCreate(void);
+void ktAstDestroy(ktAst* ast);
+void ktAstReset(ktAst* ast);
+ktAstIndex ktAstAppend(ktAst* ast, ktAstNode node);
+const ktAstNode* ktAstGet(const ktAst* ast, ktAstIndex index);
+void ktAstPrint(const ktAst* ast, ktAstIndex index);
+
+#endif // __KISHITECH_AST_H__
@@ -0,0 +1,543 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <string.h>
+#include "batch.h"
+#include "alloc.h"
+#include "consts.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+const char* const KT_BATCH_STMT_TYPE_STR[] =
+{
+#define X_MACRO(name) #name,
+	KT_BATCH_STMT_TYPE_LIST
+#undef X_MACRO
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool split(ktBatch* batch, const char* script, size_t length, size_t threadCount);
+static void compileChunk(void* userData);
+static void chunkDestroy(ktBatchChunk* chunk);
+static ktBatchStmt* pushStmt(ktBatchChunk* chunk, ktBatchStmtType type, int errorCode);
+
+static void onLetStmt(int errorCode, char variable, double value, void* userData);
+static void onResetStmt(int errorCode, void* userData);
+static void onVarsStmt(int errorCode, void* userData);
+static void onClearStmt(void* userData);
+static void onExitStmt(void* userData);
+static void onErrorCode(int errorCode, void* userData);
+static void onVar(int errorCode, char variable, void* userData);
+static void onNumber(int errorCode, double number, void* userData);
+static void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData);
+static void onErrorRecord(const ktParserError* error, const char* contents, void* userData);
+
+#if _DEBUG_RPN
+static void onRpnStmt(int errorCode, void* userData);
+#endif // #if _DEBUG_RPN
+
+//------------------------------------------------------------------------------
+// Splits the script at line breaks and compiles the chunks on threadCount
+// threads (0: one per processor, 1: on the calling thread). Statements
+// parse independently, so each chunk gets its own parser; nothing is run
+// here, so the order the chunks are compiled in doesn't matter. Returns NULL
+// if out of memory.
+//------------------------------------------------------------------------------
+ktBatch* ktBatchCompile(const char* script, size_t length, size_t threadCount)
+{
+	if (!script)
+		return NULL;
+
+	if (threadCount == 0)
+	{
+		threadCount = ktThreadPoolDefaultSize();
+	}
+
+	ktBatch* batch = ktAlloc(sizeof(ktBatch));
+	if (!batch)
+		return NULL;
+
+	batch->chunks = NULL;
+	batch->chunkCount = 0;
+	batch->tail = NULL;
+
+	if (!split(batch, script, length, threadCount))
+	{
+		ktBatchDestroy(batch);
+		return NULL;
+	}
+
+	ktThreadPool* pool = NULL;
+	if (threadCount > 1 && batch->chunkCount > 1)
+	{
+		pool = ktThreadPoolCreate(ktMin(threadCount, batch->chunkCount));
+	}
+
+	// Without a pool (or if a task can't be queued), the chunk is compiled
+	// right here.
+	for (size_t i = 0; i < batch->chunkCount; ++i)
+	{
+		if (!ktThreadPoolSubmit(pool, compileChunk, &batch->chunks[i]))
+		{
+			compileChunk(&batch->chunks[i]);
+		}
+	}
+
+	ktThreadPoolDestroy(pool);
+
+	for (size_t i = 0; i < batch->chunkCount; ++i)
+	{
+		if (batch->chunks[i].isOutOfMemory)
+		{
+			ktBatchDestroy(batch);
+			return NULL;
+		}
+	}
+
+	return batch;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktBatchDestroy(ktBatch* batch)
+{
+	if (batch)
+	{
+		for (size_t i = 0; i < batch->chunkCount; ++i)
+		{
+			chunkDestroy(&batch->chunks[i]);
+		}
+
+		SAFE_DELETE(batch->chunks);
+		SAFE_DELETE(batch->tail);
+		SAFE_DELETE(batch);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Statements and errors.
+//------------------------------------------------------------------------------
+size_t ktBatchStmtCount(const ktBatch* batch)
+{
+	if (!batch)
+		return 0;
+
+	size_t count = 0;
+	for (size_t i = 0; i < batch->chunkCount; ++i)
+	{
+		count += batch->chunks[i].stmtCount;
+	}
+
+	return count;
+}
+
+//------------------------------------------------------------------------------
+// Calls the callbacks the parser would have called for the whole script, in
+// the order of the script, on the calling thread (so LET, RESET, etc. take
+// effect before the statements after them). Expression statements arrive as
+// programs (exprStmtProgram) and errors as records (errorRecord, or error
+// with the formatted message if errorRecord is NULL). Stops after EXIT.
+//------------------------------------------------------------------------------
+void ktBatchReplay(const ktBatch* batch, const ktParserCallback* callback, void* userData)
+{
+	if (!batch || !callback)
+		return;
+
+	for (size_t i = 0; i < batch->chunkCount; ++i)
+	{
+		const ktBatchChunk* chunk = &batch->chunks[i];
+		for (size_t j = 0; j < chunk->stmtCount; ++j)
+		{
+			const ktBatchStmt* stmt = &chunk->stmts[j];
+			switch (stmt->type)
+			{
+			case KT_BATCH_STMT_LET:
+				callback->letStmt(stmt->errorCode, stmt->variable, stmt->value, userData);
+				break;
+
+			case KT_BATCH_STMT_RESET:
+				callback->resetStmt(stmt->errorCode, userData);
+				break;
+
+			case KT_BATCH_STMT_VARS:
+				callback->varsStmt(stmt->errorCode, userData);
+				break;
+
+			case KT_BATCH_STMT_CLEAR:
+				callback->clearStmt(userData);
+				break;
+
+			case KT_BATCH_STMT_EXIT:
+				callback->exitStmt(userData);
+				return;
+
+			case KT_BATCH_STMT_EXPR:
+			{
+				const ktProgram program =
+				{
+					.code = &chunk->code[stmt->start],
+					.count = stmt->count,
+					.capacity = stmt->count,
+					.depth = stmt->depth,
+					.stackSize = stmt->stackSize
+				};
+				callback->exprStmtProgram(stmt->errorCode, &program, userData);
+				break;
+			}
+
+			case KT_BATCH_STMT_ERROR:
+			{
+				const ktParserError* error = &chunk->errors[stmt->start];
+				if (callback->errorRecord)
+				{
+					callback->errorRecord(error, chunk->contents[stmt->start], userData);
+				}
+				else
+				{
+					char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+					ktParserErrorFormat(error, chunk->contents[stmt->start], buffer, KT_ERROR_MESSAGE_MAX_LENGTH);
+					callback->error(error->type, buffer, userData);
+				}
+				break;
+			}
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Chunks end right after a '\n' (or at the end of the script), so no line is
+// split, and "\r\n" stays in one chunk. A last line without a line break is
+// copied, with one, to the last chunk's tail: the tokenizer only hands a line
+// over in place (and its error records keep pointing into it) once its line
+// break arrives.
+//------------------------------------------------------------------------------
+bool split(ktBatch* batch, const char* script, size_t length, size_t threadCount)
+{
+	size_t chunkSize = ktMax(length / (threadCount * KT_BATCH_CHUNKS_PER_THREAD), KT_BATCH_MIN_CHUNK_SIZE);
+	size_t maxChunkCount = length / chunkSize + 1;
+
+	batch->chunks = ktAlloc(maxChunkCount * sizeof(ktBatchChunk));
+	if (!batch->chunks)
+		return false;
+
+	size_t start = 0;
+	do
+	{
+		size_t end = ktMin(start + chunkSize, length);
+		const char* lineBreak = end < length ? memchr(&script[end - 1], '\n', length - (end - 1)) : NULL;
+		end = lineBreak ? (size_t)(lineBreak - script) + 1 : length;
+
+		ktBatchChunk* chunk = &batch->chunks[batch->chunkCount++];
+		memset(chunk, 0, sizeof(ktBatchChunk));
+		chunk->bytes = &script[start];
+		chunk->length = end - start;
+
+		start = end;
+	}
+	while (start < length && batch->chunkCount < maxChunkCount);
+
+	// Only the last chunk can end without a line break.
+	ktBatchChunk* last = &batch->chunks[batch->chunkCount - 1];
+	last->length = length - (size_t)(last->bytes - script);
+	if (last->length == 0 || last->bytes[last->length - 1] == '\n' || last->bytes[last->length - 1] == '\r')
+		return true;
+
+	size_t lineStart = last->length;
+	while (lineStart > 0 && last->bytes[lineStart - 1] != '\n' && last->bytes[lineStart - 1] != '\r')
+	{
+		--lineStart;
+	}
+
+	last->tailLength = last->length - lineStart + 1;
+	batch->tail = ktAlloc(last->tailLength);
+	if (!batch->tail)
+		return false;
+
+	memcpy(batch->tail, &last->bytes[lineStart], last->tailLength - 1);
+	batch->tail[last->tailLength - 1] = '\n';
+	last->tail = batch->tail;
+	last->length = lineStart;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Thread pool task: records the statements of one chunk.
+//------------------------------------------------------------------------------
+void compileChunk(void* userData)
+{
+	static const ktParserCallback CALLBACK =
+	{
+		.letStmt = onLetStmt,
+		.resetStmt = onResetStmt,
+		.varsStmt = onVarsStmt,
+		.clearStmt = onClearStmt,
+		.exitStmt = onExitStmt,
+		.exprStmtBegin = onErrorCode,
+		.exprStmtEnd = onErrorCode,
+		.var = onVar,
+		.number = onNumber,
+		.symbol = onVar,
+		.error = NULL,
+		.exprStmtAst = NULL,
+		.exprStmtProgram = onExprStmtProgram,
+		.eventBatch = NULL,
+		.errorRecord = onErrorRecord,
+
+#if _DEBUG_RPN
+		.rpnStmt = onRpnStmt,
+#endif // #if _DEBUG_RPN
+	};
+
+	ktBatchChunk* chunk = userData;
+
+	ktParser* parser = ktParserCreate(&CALLBACK, chunk);
+	if (!parser)
+	{
+		chunk->isOutOfMemory = true;
+		return;
+	}
+
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_PROGRAM);
+	ktParserSetErrorMode(parser, KT_PARSER_ERROR_MODE_RECORDS);
+
+	bool isFed = ktParserFeed(parser, chunk->bytes, chunk->length);
+	if (isFed && chunk->tail)
+	{
+		isFed = ktParserFeed(parser, chunk->tail, chunk->tailLength);
+	}
+	ktParserFinish(parser);
+	ktParserDestroy(parser);
+
+	if (!isFed)
+	{
+		chunk->isOutOfMemory = true;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void chunkDestroy(ktBatchChunk* chunk)
+{
+	SAFE_DELETE(chunk->stmts);
+	SAFE_DELETE(chunk->code);
+	SAFE_DELETE(chunk->errors);
+	SAFE_DELETE(chunk->contents);
+}
+
+//------------------------------------------------------------------------------
+// Returns NULL (and flags the chunk) if out of memory.
+//------------------------------------------------------------------------------
+ktBatchStmt* pushStmt(ktBatchChunk* chunk, ktBatchStmtType type, int errorCode)
+{
+	if (chunk->stmtCount == chunk->stmtCapacity)
+	{
+		size_t capacity = chunk->stmtCapacity > 0 ? chunk->stmtCapacity * 2 : KT_BATCH_INITIAL_CAPACITY;
+		ktBatchStmt* stmts = ktRealloc(chunk->stmts, capacity * sizeof(ktBatchStmt));
+		if (!stmts)
+		{
+			chunk->isOutOfMemory = true;
+			return NULL;
+		}
+
+		chunk->stmts = stmts;
+		chunk->stmtCapacity = capacity;
+	}
+
+	ktBatchStmt* stmt = &chunk->stmts[chunk->stmtCount++];
+	memset(stmt, 0, sizeof(ktBatchStmt));
+	stmt->type = (unsigned char)type;
+	stmt->errorCode = errorCode;
+
+	return stmt;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onLetStmt(int errorCode, char variable, double value, void* userData)
+{
+	ktBatchStmt* stmt = pushStmt(userData, KT_BATCH_STMT_LET, errorCode);
+	if (stmt)
+	{
+		stmt->variable = variable;
+		stmt->value = value;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onResetStmt(int errorCode, void* userData)
+{
+	pushStmt(userData, KT_BATCH_STMT_RESET, errorCode);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onVarsStmt(int errorCode, void* userData)
+{
+	pushStmt(userData, KT_BATCH_STMT_VARS, errorCode);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onClearStmt(void* userData)
+{
+	pushStmt(userData, KT_BATCH_STMT_CLEAR, 0);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onExitStmt(void* userData)
+{
+	pushStmt(userData, KT_BATCH_STMT_EXIT, 0);
+}
+
+//------------------------------------------------------------------------------
+// Expression statements arrive as programs (see onExprStmtProgram()), so the
+// per-token callbacks below are never called.
+//------------------------------------------------------------------------------
+void onErrorCode(int errorCode, void* userData)
+{
+	(void)errorCode;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onVar(int errorCode, char variable, void* userData)
+{
+	(void)errorCode;
+	(void)variable;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onNumber(int errorCode, double number, void* userData)
+{
+	(void)errorCode;
+	(void)number;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+// The parser reuses its program for the next statement, so the instructions
+// are copied to the end of the chunk's code.
+//------------------------------------------------------------------------------
+void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData)
+{
+	ktBatchChunk* chunk = userData;
+
+	if (chunk->codeCount + program->count > chunk->codeCapacity)
+	{
+		size_t capacity = chunk->codeCapacity > 0 ? chunk->codeCapacity : KT_BATCH_INITIAL_CAPACITY;
+		while (capacity < chunk->codeCount + program->count)
+		{
+			capacity *= 2;
+		}
+
+		ktInstruction* code = ktRealloc(chunk->code, capacity * sizeof(ktInstruction));
+		if (!code)
+		{
+			chunk->isOutOfMemory = true;
+			return;
+		}
+
+		chunk->code = code;
+		chunk->codeCapacity = capacity;
+	}
+
+	ktBatchStmt* stmt = pushStmt(chunk, KT_BATCH_STMT_EXPR, errorCode);
+	if (!stmt)
+		return;
+
+	if (program->count > 0)
+	{
+		memcpy(&chunk->code[chunk->codeCount], program->code, program->count * sizeof(ktInstruction));
+	}
+
+	stmt->start = chunk->codeCount;
+	stmt->count = program->count;
+	stmt->depth = program->depth;
+	stmt->stackSize = program->stackSize;
+	chunk->codeCount += program->count;
+}
+
+//------------------------------------------------------------------------------
+// contents are the chunk's (or its tail's), so they outlive the parser.
+//------------------------------------------------------------------------------
+void onErrorRecord(const ktParserError* error, const char* contents, void* userData)
+{
+	ktBatchChunk* chunk = userData;
+
+	if (chunk->errorCount == chunk->errorCapacity)
+	{
+		size_t capacity = chunk->errorCapacity > 0 ? chunk->errorCapacity * 2 : KT_BATCH_INITIAL_CAPACITY;
+		ktParserError* errors = ktRealloc(chunk->errors, capacity * sizeof(ktParserError));
+		if (errors)
+		{
+			chunk->errors = errors;
+		}
+
+		const char** contentsList = errors ? ktRealloc(chunk->contents, capacity * sizeof(const char*)) : NULL;
+		if (!contentsList)
+		{
+			chunk->isOutOfMemory = true;
+			return;
+		}
+
+		chunk->contents = contentsList;
+		chunk->errorCapacity = capacity;
+	}
+
+	ktBatchStmt* stmt = pushStmt(chunk, KT_BATCH_STMT_ERROR, 0);
+	if (!stmt)
+		return;
+
+	stmt->start = chunk->errorCount;
+	chunk->errors[chunk->errorCount] = *error;
+	chunk->contents[chunk->errorCount] = contents;
+	++chunk->errorCount;
+}
+
+#if _DEBUG_RPN
+//------------------------------------------------------------------------------
+// RPN statements aren't recorded.
+//------------------------------------------------------------------------------
+void onRpnStmt(int errorCode, void* userData)
+{
+	(void)errorCode;
+	(void)userData;
+}
+#endif // #if _DEBUG_RPN
@@ -0,0 +1,129 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_BATCH_H__
+#define __KISHITECH_BATCH_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include "parser.h"
+#include "program.h"
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_BATCH_STMT_TYPE_LIST \
+	X_MACRO(KT_BATCH_STMT_LET) \
+	X_MACRO(KT_BATCH_STMT_RESET) \
+	X_MACRO(KT_BATCH_STMT_VARS) \
+	X_MACRO(KT_BATCH_STMT_CLEAR) \
+	X_MACRO(KT_BATCH_STMT_EXIT) \
+	X_MACRO(KT_BATCH_STMT_EXPR) \
+	X_MACRO(KT_BATCH_STMT_ERROR)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktBatchStmt ktBatchStmt;
+typedef struct ktBatchChunk ktBatchChunk;
+typedef struct ktBatch ktBatch;
+
+enum ktBatchStmtType
+{
+#define X_MACRO(name) name,
+	KT_BATCH_STMT_TYPE_LIST
+#undef X_MACRO
+};
+
+typedef enum ktBatchStmtType ktBatchStmtType;
+
+enum ktBatchConstants
+{
+	KT_BATCH_INITIAL_CAPACITY = 256,
+
+	// The script is split into about this many chunks per thread (so a
+	// thread that finishes early can take another one), but no chunk is
+	// smaller than KT_BATCH_MIN_CHUNK_SIZE bytes (or the end of its line).
+	KT_BATCH_CHUNKS_PER_THREAD = 4,
+	KT_BATCH_MIN_CHUNK_SIZE = 64 * 1024,
+};
+
+// One parser callback, recorded: letStmt (variable, value), resetStmt,
+// varsStmt, clearStmt, exitStmt, exprStmtProgram (the program is
+// code[start, start + count) of the chunk) or an error (errors[start] of the
+// chunk).
+struct ktBatchStmt
+{
+	unsigned char type;
+	char variable;
+	int errorCode;
+	double value;
+	size_t start;
+	size_t count;
+	size_t depth;
+	size_t stackSize;
+};
+
+// A run of whole lines of the script, compiled by one task. The last chunk
+// may have a tail: the batch's copy of a last line without a line break,
+// with one added. The error records point into contents[i], which are the
+// chunk's own lines (or its tail).
+struct ktBatchChunk
+{
+	const char* bytes;
+	size_t length;
+	const char* tail;
+	size_t tailLength;
+	bool isOutOfMemory;
+
+	ktBatchStmt* stmts;
+	size_t stmtCount;
+	size_t stmtCapacity;
+
+	ktInstruction* code;
+	size_t codeCount;
+	size_t codeCapacity;
+
+	ktParserError* errors;
+	const char** contents;
+	size_t errorCount;
+	size_t errorCapacity;
+};
+
+// A script compiled by ktBatchCompile(): every statement, in the order of the
+// script, ready to be replayed by ktBatchReplay(). The script must outlive the
+// batch.
+struct ktBatch
+{
+	ktBatchChunk* chunks;
+	size_t chunkCount;
+	char* tail;
+};
+
+extern const char* const KT_BATCH_STMT_TYPE_STR[];
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktBatch* ktBatchCompile(const char* script, size_t length, size_t threadCount);
+void ktBatchDestroy(ktBatch* batch);
+size_t ktBatchStmtCount(const ktBatch* batch);
+void ktBatchReplay(const ktBatch* batch, const ktParserCallback* callback, void* userData);
+
+#endif // __KISHITECH_BATCH_H__
@@ -0,0 +1,384 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "char_scan.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define KT_CHAR_SCAN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define KT_CHAR_SCAN_X86 0
+#endif
+
+#if KT_CHAR_SCAN_X86 && (defined(__GNUC__) || defined(__clang__))
+#define KT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define KT_TARGET_AVX2
+#endif
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static inline bool isBlank(char c);
+static inline bool isNumber(char c);
+static inline bool isWordEnd(char c);
+static inline unsigned int firstSetBit(unsigned int mask);
+
+static size_t scalarBlanks(const char* data, size_t index, size_t length);
+static size_t scalarNumber(const char* data, size_t index, size_t length);
+static size_t scalarWord(const char* data, size_t index, size_t length);
+
+#if KT_CHAR_SCAN_X86
+static size_t sse2Blanks(const char* data, size_t index, size_t length);
+static size_t sse2Number(const char* data, size_t index, size_t length);
+static size_t sse2Word(const char* data, size_t index, size_t length);
+
+KT_TARGET_AVX2 static size_t avx2Blanks(const char* data, size_t index, size_t length);
+KT_TARGET_AVX2 static size_t avx2Number(const char* data, size_t index, size_t length);
+KT_TARGET_AVX2 static size_t avx2Word(const char* data, size_t index, size_t length);
+#endif // #if KT_CHAR_SCAN_X86
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+static const ktCharScan SCALAR_SCAN = { KT_CHAR_SCAN_SCALAR, "scalar", scalarBlanks, scalarNumber, scalarWord };
+
+#if KT_CHAR_SCAN_X86
+static const ktCharScan SSE2_SCAN = { KT_CHAR_SCAN_SSE2, "sse2", sse2Blanks, sse2Number, sse2Word };
+static const ktCharScan AVX2_SCAN = { KT_CHAR_SCAN_AVX2, "avx2", avx2Blanks, avx2Number, avx2Word };
+#endif // #if KT_CHAR_SCAN_X86
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool ktCharScanIsSupported(ktCharScanPath path)
+{
+	switch (path)
+	{
+	case KT_CHAR_SCAN_SCALAR:
+		return true;
+
+#if KT_CHAR_SCAN_X86
+	case KT_CHAR_SCAN_SSE2:
+		// SSE2 is part of the x86-64 baseline (and required for 32-bit builds).
+		return true;
+
+	case KT_CHAR_SCAN_AVX2:
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+	{
+		int info[4] = { 0 };
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+		bool hasAvx = (info[2] & (1 << 28)) != 0;
+		if (!hasOsxsave || !hasAvx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+#else
+		return false;
+#endif
+#endif // #if KT_CHAR_SCAN_X86
+
+	default:
+		return false;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktCharScanPath ktCharScanBestPath(void)
+{
+	if (ktCharScanIsSupported(KT_CHAR_SCAN_AVX2))
+		return KT_CHAR_SCAN_AVX2;
+	else if (ktCharScanIsSupported(KT_CHAR_SCAN_SSE2))
+		return KT_CHAR_SCAN_SSE2;
+	else
+		return KT_CHAR_SCAN_SCALAR;
+}
+
+//------------------------------------------------------------------------------
+// Unsupported paths fall back to the scalar functions.
+//------------------------------------------------------------------------------
+const ktCharScan* ktCharScanGet(ktCharScanPath path)
+{
+	if (!ktCharScanIsSupported(path))
+		return &SCALAR_SCAN;
+
+	switch (path)
+	{
+#if KT_CHAR_SCAN_X86
+	case KT_CHAR_SCAN_SSE2:
+		return &SSE2_SCAN;
+
+	case KT_CHAR_SCAN_AVX2:
+		return &AVX2_SCAN;
+#endif // #if KT_CHAR_SCAN_X86
+
+	case KT_CHAR_SCAN_SCALAR:
+	default:
+		return &SCALAR_SCAN;
+	}
+}
+
+//------------------------------------------------------------------------------
+// The predicates below must match the tokenizer character classes:
+// blanks are ' ' and '\t', numbers are runs of digits and decimal points,
+// and words end at a blank, a '\n' or a '\0' (which can be inside the
+// contents given to ktTokenizerFeed() or read from a file).
+//------------------------------------------------------------------------------
+bool isBlank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool isNumber(char c)
+{
+	return (c >= '0' && c <= '9') || c == '.';
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool isWordEnd(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\0';
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+unsigned int firstSetBit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+	unsigned long bit = 0;
+	_BitScanForward(&bit, mask);
+	return (unsigned int)bit;
+#else
+	return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t scalarBlanks(const char* data, size_t index, size_t length)
+{
+	while (index < length && isBlank(data[index]))
+	{
+		++index;
+	}
+
+	return index;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t scalarNumber(const char* data, size_t index, size_t length)
+{
+	while (index < length && isNumber(data[index]))
+	{
+		++index;
+	}
+
+	return index;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t scalarWord(const char* data, size_t index, size_t length)
+{
+	while (index < length && !isWordEnd(data[index]))
+	{
+		++index;
+	}
+
+	return index;
+}
+
+#if KT_CHAR_SCAN_X86
+//------------------------------------------------------------------------------
+// The SIMD functions test 16 (SSE2) or 32 (AVX2) characters per iteration
+// and only load full blocks inside [index, length). The remaining tail is
+// handled by the scalar functions.
+//------------------------------------------------------------------------------
+size_t sse2Blanks(const char* data, size_t index, size_t length)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+
+	while (index + 16 <= length)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)&data[index]);
+		__m128i match = _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(match) ^ 0xFFFFu;
+		if (mask)
+			return index + firstSetBit(mask);
+
+		index += 16;
+	}
+
+	return scalarBlanks(data, index, length);
+}
+
+//------------------------------------------------------------------------------
+// A character is a digit when (c - '0') is at most 9 as an unsigned byte.
+//------------------------------------------------------------------------------
+size_t sse2Number(const char* data, size_t index, size_t length)
+{
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i point = _mm_set1_epi8('.');
+
+	while (index + 16 <= length)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)&data[index]);
+		__m128i digit = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(block, zero), nine), _mm_setzero_si128());
+		__m128i match = _mm_or_si128(digit, _mm_cmpeq_epi8(block, point));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(match) ^ 0xFFFFu;
+		if (mask)
+			return index + firstSetBit(mask);
+
+		index += 16;
+	}
+
+	return scalarNumber(data, index, length);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t sse2Word(const char* data, size_t index, size_t length)
+{
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i nul = _mm_setzero_si128();
+
+	while (index + 16 <= length)
+	{
+		__m128i block = _mm_loadu_si128((const __m128i*)&data[index]);
+		__m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, tab));
+		__m128i end = _mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, nul));
+		__m128i match = _mm_or_si128(blank, end);
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(match);
+		if (mask)
+			return index + firstSetBit(mask);
+
+		index += 16;
+	}
+
+	return scalarWord(data, index, length);
+}
+
+//------------------------------------------------------------------------------
+// The AVX2 functions hand the tail to the SSE2 ones, which the compiler turns
+// into a jump that skips the vzeroupper it adds before returning. Without the
+// explicit one, the upper YMM halves stay dirty and every SSE instruction
+// after it (libm's pow() among them) runs several times slower.
+//------------------------------------------------------------------------------
+size_t avx2Blanks(const char* data, size_t index, size_t length)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+
+	while (index + 32 <= length)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)&data[index]);
+		__m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(match);
+		if (mask)
+			return index + firstSetBit(mask);
+
+		index += 32;
+	}
+
+	_mm256_zeroupper();
+	return sse2Blanks(data, index, length);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t avx2Number(const char* data, size_t index, size_t length)
+{
+	const __m256i zero = _mm256_set1_epi8('0');
+	const __m256i nine = _mm256_set1_epi8(9);
+	const __m256i point = _mm256_set1_epi8('.');
+
+	while (index + 32 <= length)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)&data[index]);
+		__m256i digit = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_sub_epi8(block, zero), nine), _mm256_setzero_si256());
+		__m256i match = _mm256_or_si256(digit, _mm256_cmpeq_epi8(block, point));
+		unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(match);
+		if (mask)
+			return index + firstSetBit(mask);
+
+		index += 32;
+	}
+
+	_mm256_zeroupper();
+	return sse2Number(data, index, length);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t avx2Word(const char* data, size_t index, size_t length)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	const __m256i nul = _mm256_setzero_si256();
+
+	while (index + 32 <= length)
+	{
+		__m256i block = _mm256_loadu_si256((const __m256i*)&data[index]);
+		__m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, tab));
+		__m256i end = _mm256_or_si256(_mm256_cmpeq_epi8(block, newline), _mm256_cmpeq_epi8(block, nul));
+		__m256i match = _mm256_or_si256(blank, end);
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(match);
+		if (mask)
+			return index + firstSetBit(mask);
+
+		index += 32;
+	}
+
+	_mm256_zeroupper();
+	return sse2Word(data, index, length);
+}
+#endif // #if KT_CHAR_SCAN_X86
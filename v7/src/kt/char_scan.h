@@ -14,41 +14,45 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
-#ifndef __KISHITECH_DOUBLE_STACK_H__
-#define __KISHITECH_DOUBLE_STACK_H__
+#ifndef __KISHITECH_CHAR_SCAN_H__
+#define __KISHITECH_CHAR_SCAN_H__
 
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include <stddef.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
-typedef struct ktDoubleStack ktDoubleStack;
+typedef struct ktCharScan ktCharScan;
 
-enum ktDoubleStackConstants
+enum ktCharScanPath
 {
-	KT_DOUBLE_STACK_SIZE = 32,
+	KT_CHAR_SCAN_SCALAR,
+	KT_CHAR_SCAN_SSE2,
+	KT_CHAR_SCAN_AVX2,
 };
 
-struct ktDoubleStack
+typedef enum ktCharScanPath ktCharScanPath;
+
+// Each function receives the index of the first character of a run and
+// returns the index right after its last character (at most length).
+struct ktCharScan
 {
-	double data[KT_DOUBLE_STACK_SIZE];
-	size_t count;
+	ktCharScanPath path;
+	const char* name;
+	size_t (*blanks)(const char* data, size_t index, size_t length);
+	size_t (*number)(const char* data, size_t index, size_t length);
+	size_t (*word)(const char* data, size_t index, size_t length);
 };
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-ktDoubleStack* ktDoubleStackCreate(void);
-void ktDoubleStackDestroy(ktDoubleStack* stack);
-void ktDoubleStackPush(ktDoubleStack* stack, double value);
-double ktDoubleStackPop(ktDoubleStack* stack);
-double ktDoubleStackTop(ktDoubleStack* stack);
-void ktDoubleStackClear(ktDoubleStack* stack);
-bool ktDoubleStackIsEmpty(ktDoubleStack* stack);
-bool ktDoubleStackIsFull(ktDoubleStack* stack);
+bool ktCharScanIsSupported(ktCharScanPath path);
+ktCharScanPath ktCharScanBestPath(void);
+const ktCharScan* ktCharScanGet(ktCharScanPath path);
 
-#endif // __KISHITECH_DOUBLE_STACK_H__
+#endif // __KISHITECH_CHAR_SCAN_H__
@@ -23,9 +23,13 @@
 enum ktConstants
 {
 	KT_ERROR_MESSAGE_MAX_LENGTH = 80,
+	KT_NUMBER_MAX_LENGTH = 512,
 	KT_LET_STMT_VAR_FLAG = 0x01,
 	KT_LET_STMT_VALUE_FLAG = 0x02,
 	KT_LET_STMT_PARAMS_FLAG = 0x04,
+	KT_EXPR_STMT_SYNTAX_FLAG = 0x01,
+	KT_EXPR_STMT_OPERAND_FLAG = 0x02,
+	KT_EXPR_STMT_OPEN_PAREN_FLAG = 0x04,
 };
 
 #endif // __KISHITECH_CONSTS_H__
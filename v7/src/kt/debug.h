@@ -28,6 +28,8 @@
 #endif
 
 #define _DEBUG_PARSER_SHOW_TOKENLIST 0
+#define _DEBUG_PARSER_SHOW_AST 0
 #define _DEBUG_RPN 0
+#define _DEBUG_STMT_CACHE 0
 
 #endif // __KISHITECH_DEBUG_H__
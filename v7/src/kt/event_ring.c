@@ -0,0 +1,156 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <string.h>
+#include "event_ring.h"
+#include "alloc.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+const char* const KT_EVENT_TYPE_STR[] =
+{
+#define X_MACRO(name) #name,
+	KT_EVENT_TYPE_LIST
+#undef X_MACRO
+};
+
+//------------------------------------------------------------------------------
+// capacity is rounded up to a power of two.
+//------------------------------------------------------------------------------
+ktEventRing* ktEventRingCreate(size_t capacity)
+{
+	size_t powerOfTwo = 1;
+	while (powerOfTwo < capacity)
+	{
+		powerOfTwo *= 2;
+	}
+
+	ktEventRing* ring = ktAlloc(sizeof(ktEventRing));
+	if (!ring)
+		return NULL;
+
+	ring->events = ktAlloc(powerOfTwo * sizeof(ktEvent));
+	if (!ring->events)
+	{
+		SAFE_DELETE(ring);
+		return NULL;
+	}
+
+	ring->capacity = powerOfTwo;
+	ring->freeCount = powerOfTwo;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	return ring;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktEventRingDestroy(ktEventRing* ring)
+{
+	if (ring)
+	{
+		SAFE_DELETE(ring->events);
+		SAFE_DELETE(ring);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Producer side. Returns false if the ring is full.
+//------------------------------------------------------------------------------
+bool ktEventRingPush(ktEventRing* ring, const ktEvent* event)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (ring->freeCount == 0)
+	{
+		size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		ring->freeCount = ring->capacity - (head - tail);
+		if (ring->freeCount == 0)
+			return false;
+	}
+
+	ring->events[head & (ring->capacity - 1)] = *event;
+	--ring->freeCount;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Consumer side: copies up to maxCount events (oldest first) to out_events
+// and returns how many were copied.
+//------------------------------------------------------------------------------
+size_t ktEventRingRead(ktEventRing* ring, ktEvent* out_events, size_t maxCount)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t count = ktMin(head - tail, maxCount);
+	if (count == 0)
+		return 0;
+
+	// The events may wrap around the end of the array.
+	size_t start = tail & (ring->capacity - 1);
+	size_t firstCount = ktMin(count, ring->capacity - start);
+	memcpy(out_events, &ring->events[start], firstCount * sizeof(ktEvent));
+	memcpy(&out_events[firstCount], ring->events, (count - firstCount) * sizeof(ktEvent));
+
+	atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+
+	return count;
+}
+
+//------------------------------------------------------------------------------
+// Consumer side, without copying: the oldest events that are contiguous in the
+// ring (call again after ktEventRingRelease() for the ones that wrapped around
+// the end). They stay valid until they are released.
+//------------------------------------------------------------------------------
+const ktEvent* ktEventRingPeek(const ktEventRing* ring, size_t* out_count)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	size_t start = tail & (ring->capacity - 1);
+
+	*out_count = ktMin(head - tail, ring->capacity - start);
+
+	return &ring->events[start];
+}
+
+//------------------------------------------------------------------------------
+// Consumer side: gives count peeked events back to the producer.
+//------------------------------------------------------------------------------
+void ktEventRingRelease(ktEventRing* ring, size_t count)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+// Events waiting to be read. Only exact when called from the producer or the
+// consumer thread while the other one is idle.
+//------------------------------------------------------------------------------
+size_t ktEventRingCount(const ktEventRing* ring)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	return head - tail;
+}
@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_EVENT_RING_H__
+#define __KISHITECH_EVENT_RING_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_EVENT_TYPE_LIST \
+	X_MACRO(KT_EVENT_EXPR_STMT_BEGIN) \
+	X_MACRO(KT_EVENT_EXPR_STMT_END) \
+	X_MACRO(KT_EVENT_VAR) \
+	X_MACRO(KT_EVENT_NUMBER) \
+	X_MACRO(KT_EVENT_SYMBOL)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktEvent ktEvent;
+typedef struct ktEventRing ktEventRing;
+
+enum ktEventType
+{
+#define X_MACRO(name) name,
+	KT_EVENT_TYPE_LIST
+#undef X_MACRO
+};
+
+typedef enum ktEventType ktEventType;
+
+// One parser callback as a record: the same arguments the exprStmtBegin,
+// exprStmtEnd, var, number and symbol callbacks get. value is the variable
+// (KT_EVENT_VAR) or the symbol (KT_EVENT_SYMBOL).
+struct ktEvent
+{
+	unsigned char type;
+	unsigned char errorCode;
+	char value;
+	double number;
+};
+
+// Single-producer, single-consumer ring of events: the parser pushes, and the
+// consumer reads, on the same thread or on another one. head and tail only
+// grow; capacity is a power of two, so they are masked into events[].
+// freeCount is the producer's own (possibly stale) idea of the free space, so
+// it only has to look at tail when it thinks the ring is full.
+struct ktEventRing
+{
+	ktEvent* events;
+	size_t capacity;
+	size_t freeCount;
+	atomic_size_t head;
+	atomic_size_t tail;
+};
+
+extern const char* const KT_EVENT_TYPE_STR[];
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktEventRing* ktEventRingCreate(size_t capacity);
+void ktEventRingDestroy(ktEventRing* ring);
+bool ktEventRingPush(ktEventRing* ring, const ktEvent* event);
+size_t ktEventRingRead(ktEventRing* ring, ktEvent* out_events, size_t maxCount);
+const ktEvent* ktEventRingPeek(const ktEventRing* ring, size_t* out_count);
+void ktEventRingRelease(ktEventRing* ring, size_t count);
+size_t ktEventRingCount(const ktEventRing* ring);
+
+#endif // __KISHITECH_EVENT_RING_H__
@@ -17,17 +17,18 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
+#include <ctype.h>
 #include <float.h>
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "char_stack.h"
-#include "double_stack.h"
+#include "alloc.h"
+#include "batch.h"
 #include "interpreter.h"
 #include "memory.h"
 #include "parser.h"
-#include "token_symbols.h"
+#include "program.h"
+#include "stmt_cache.h"
 #include "consts.h"
 #include "error_type.h"
 #include "utils.h"
@@ -36,28 +37,36 @@
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
 typedef struct ktInterpreter ktInterpreter;
-typedef struct ktExpression ktExpression;
 
 struct ktInterpreter
 {
 	bool isRunning;
 	ktParserCallback* callback;
+	ktParser* parser;
 	ktMemory* memory;
-	ktExpression* expression;
-};
 
-enum ktInterpreterConstants
-{
-	KT_EXPR_BUFFER_SIZE = 128,
-	KT_EXPR_INPUT_MAX_LENGTH = 80,
+	// Compiled expression statements by their normalized text (NULL if the
+	// cache is disabled). A line is only handed to the parser if it isn't in
+	// the cache, so it is put back together here when it comes in more than
+	// one chunk. key is the normalized text of the line being parsed, and
+	// isCaching is set if its program should be cached.
+	ktStmtCache* cache;
+	char* line;
+	size_t lineLength;
+	size_t lineCapacity;
+	char* key;
+	size_t keyLength;
+	size_t keyCapacity;
+	bool isCaching;
 };
 
-struct ktExpression
+enum ktInterpreterConstants
 {
-	ktCharStack* symbolStack;
-	char buffer[KT_EXPR_BUFFER_SIZE];
-	size_t index;
-	ktErrorType errorType;
+	// Input is read in chunks of this size; longer lines are put back
+	// together (by the tokenizer, or by interpreterFeed() when the statement
+	// cache is enabled), so there is no line length limit.
+	KT_INPUT_CHUNK_SIZE = 80,
+	KT_INTERPRETER_LINE_INITIAL_CAPACITY = 128,
 };
 
 //------------------------------------------------------------------------------
@@ -68,96 +77,107 @@ static const char* const SOFTWARE_VERSION = "0.1";
 static const char* const SOFTWARE_COPYRIGHT_YEAR = "2024";
 static const char* const SOFTWARE_AUTHOR = "Andre Kishimoto";
 
-static ktInterpreter* g_interpreter = NULL;
-
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-static void interpreterCreate(void);
-static void interpreterDestroy(void);
-static void interpreterExecute(const char* contents);
-
-static void onLetStmt(int errorCode, char variable, double value);
-static void onResetStmt(int errorCode);
-static void onVarsStmt(int errorCode);
-static void onClearStmt(void);
-static void onExitStmt(void);
-static void onExprStmtBegin(int errorCode);
-static void onExprStmtEnd(int errorCode);
-static void onVar(int errorCode, char variable);
-static void onNumber(int errorCode, double number);
-static void onSymbol(int errorCode, char symbol);
-static void onError(ktErrorType errorType, const char* message);
-
-static bool isOperator(char symbol);
-static int operatorPriority(char operator);
-
-static void exprBufferAppend(char value);
-static void exprBufferReset(void);
-static void exprBufferError(ktErrorType errorType);
-static ktErrorType evaluateExpr(double* out_result);
-
-static void printError(ktErrorType errorType);
+static ktInterpreter* interpreterCreate(size_t cacheCapacity);
+static void interpreterDestroy(ktInterpreter* interpreter);
+static void interpreterFeed(ktInterpreter* interpreter, const char* bytes, size_t length);
+static void interpreterFinish(ktInterpreter* interpreter);
+static void runLine(ktInterpreter* interpreter, const char* bytes, size_t length);
+static bool normalize(ktInterpreter* interpreter, const char* bytes, size_t length);
+static bool reserve(char** buffer, size_t* capacity, size_t size);
+static void runProgram(ktInterpreter* interpreter, const ktProgram* program);
+
+static void onLetStmt(int errorCode, char variable, double value, void* userData);
+static void onResetStmt(int errorCode, void* userData);
+static void onVarsStmt(int errorCode, void* userData);
+static void onClearStmt(void* userData);
+static void onExitStmt(void* userData);
+static void onExprStmtBegin(int errorCode, void* userData);
+static void onExprStmtEnd(int errorCode, void* userData);
+static void onVar(int errorCode, char variable, void* userData);
+static void onNumber(int errorCode, double number, void* userData);
+static void onSymbol(int errorCode, char symbol, void* userData);
+static void onError(ktErrorType errorType, const char* message, void* userData);
+static void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData);
+static void onErrorRecord(const ktParserError* error, const char* contents, void* userData);
+
+static ktErrorType exprErrorType(int errorCode);
+static void printVarsNotSet(ktInterpreter* interpreter, const ktProgram* program);
+static void printError(ktInterpreter* interpreter, ktErrorType errorType);
 
 #if _DEBUG_RPN
-static void onRpnStmt(int errorCode);
+static void onRpnStmt(int errorCode, void* userData);
 #endif // #if _DEBUG_RPN
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void interpreterCreate(void)
+ktInterpreter* interpreterCreate(size_t cacheCapacity)
 {
-	g_interpreter = malloc(sizeof(ktInterpreter));
-	if (g_interpreter)
+	ktInterpreter* interpreter = ktAlloc(sizeof(ktInterpreter));
+	if (interpreter)
 	{
-		g_interpreter->callback = malloc(sizeof(ktParserCallback));
-		if (g_interpreter->callback)
+		interpreter->callback = ktAlloc(sizeof(ktParserCallback));
+		if (interpreter->callback)
 		{
-			g_interpreter->callback->letStmt = onLetStmt;
-			g_interpreter->callback->resetStmt = onResetStmt;
-			g_interpreter->callback->varsStmt = onVarsStmt;
-			g_interpreter->callback->clearStmt = onClearStmt;
-			g_interpreter->callback->exitStmt = onExitStmt;
-			g_interpreter->callback->exprStmtBegin = onExprStmtBegin;
-			g_interpreter->callback->exprStmtEnd = onExprStmtEnd;
-			g_interpreter->callback->var = onVar;
-			g_interpreter->callback->number = onNumber;
-			g_interpreter->callback->symbol = onSymbol;
-			g_interpreter->callback->error = onError;
+			interpreter->callback->letStmt = onLetStmt;
+			interpreter->callback->resetStmt = onResetStmt;
+			interpreter->callback->varsStmt = onVarsStmt;
+			interpreter->callback->clearStmt = onClearStmt;
+			interpreter->callback->exitStmt = onExitStmt;
+			interpreter->callback->exprStmtBegin = onExprStmtBegin;
+			interpreter->callback->exprStmtEnd = onExprStmtEnd;
+			interpreter->callback->var = onVar;
+			interpreter->callback->number = onNumber;
+			interpreter->callback->symbol = onSymbol;
+			interpreter->callback->error = onError;
+			interpreter->callback->exprStmtAst = NULL;
+			interpreter->callback->exprStmtProgram = onExprStmtProgram;
+			interpreter->callback->eventBatch = NULL;
+			interpreter->callback->errorRecord = onErrorRecord;
 
 #if _DEBUG_RPN
-			g_interpreter->callback->rpnStmt = onRpnStmt;
+			interpreter->callback->rpnStmt = onRpnStmt;
 #endif // _DEBUG_RPN
 		}
 
-		ktParserCreate(g_interpreter->callback);
-		g_interpreter->memory = ktMemoryCreate();
-		g_interpreter->expression = malloc(sizeof(ktExpression));
-		if (g_interpreter->expression)
-		{
-			g_interpreter->expression->symbolStack = ktCharStackCreate();
-			memset(g_interpreter->expression->buffer, 0, KT_EXPR_BUFFER_SIZE);
-		}
-
-		g_interpreter->isRunning = true;
+		interpreter->parser = ktParserCreate(interpreter->callback, interpreter);
+		ktParserSetOutputMode(interpreter->parser, KT_PARSER_OUTPUT_MODE_PROGRAM);
+		ktParserSetErrorMode(interpreter->parser, KT_PARSER_ERROR_MODE_RECORDS);
+		interpreter->memory = ktMemoryCreate();
+
+		interpreter->cache = ktStmtCacheCreate(cacheCapacity);
+		interpreter->line = NULL;
+		interpreter->lineLength = 0;
+		interpreter->lineCapacity = 0;
+		interpreter->key = NULL;
+		interpreter->keyLength = 0;
+		interpreter->keyCapacity = 0;
+		interpreter->isCaching = false;
+
+		interpreter->isRunning = true;
 	}
+
+	return interpreter;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void interpreterDestroy(void)
+void interpreterDestroy(ktInterpreter* interpreter)
 {
-	if (g_interpreter)
+	if (interpreter)
 	{
-		g_interpreter->isRunning = false;
-		SAFE_DELETE(g_interpreter->callback);
-		ktParserDestroy();
-		ktMemoryDestroy(g_interpreter->memory);
-		ktCharStackDestroy(g_interpreter->expression->symbolStack);
-		SAFE_DELETE(g_interpreter->expression);
-		SAFE_DELETE(g_interpreter);
+		interpreter->isRunning = false;
+		ktParserDestroy(interpreter->parser);
+		SAFE_DELETE(interpreter->callback);
+		ktMemoryDestroy(interpreter->memory);
+		ktStmtCacheDestroy(interpreter->cache);
+		SAFE_DELETE(interpreter->line);
+		SAFE_DELETE(interpreter->key);
+		SAFE_DELETE(interpreter);
 	}
 }
 
@@ -165,86 +185,329 @@ void interpreterDestroy(void)
 // 
 //------------------------------------------------------------------------------
 void ktInterpreterRun(void)
+{
+	ktInterpreterRunCached(KT_INTERPRETER_CACHE_CAPACITY, NULL);
+}
+
+//------------------------------------------------------------------------------
+// cacheCapacity is the number of compiled expression statements kept (0
+// disables the cache). out_stats (optional) gets the cache counters.
+//------------------------------------------------------------------------------
+void ktInterpreterRunCached(size_t cacheCapacity, ktInterpreterStats* out_stats)
 {
 	printf("%s v%s\nCopyright (c) %s %s.\n\n", SOFTWARE_TITLE, SOFTWARE_VERSION, SOFTWARE_COPYRIGHT_YEAR, SOFTWARE_AUTHOR);
 
-	interpreterCreate();
+	ktInterpreter* interpreter = interpreterCreate(cacheCapacity);
 
-	char str[KT_EXPR_INPUT_MAX_LENGTH] = { 0 };
-	size_t strLength = 0;
+	char chunk[KT_INPUT_CHUNK_SIZE] = { 0 };
+	bool isNewLine = true;
 
-	while (g_interpreter && g_interpreter->isRunning)
+	while (interpreter && interpreter->isRunning)
 	{
-		printf("> ");
-		if (fgets(str, KT_EXPR_INPUT_MAX_LENGTH, stdin))
+		if (isNewLine)
+		{
+			printf("> ");
+		}
+
+		if (!fgets(chunk, KT_INPUT_CHUNK_SIZE, stdin))
 		{
-			strLength = strlen(str);
-			if (str[strLength - 1] == '\n')
-			{
-				str[strLength - 1] = '\0';
-			}
-			strLength = strlen(str);
-			interpreterExecute(ktStringToUpper(str));
+			// End of input: run the last statement, even without a line break.
+			interpreterFinish(interpreter);
+			break;
 		}
+
+		size_t chunkLength = strlen(chunk);
+		isNewLine = (chunkLength > 0 && chunk[chunkLength - 1] == '\n');
+		interpreterFeed(interpreter, ktStringToUpper(chunk), chunkLength);
 	}
 
-	interpreterDestroy();
+	ktStmtCache* cache = interpreter ? interpreter->cache : NULL;
+
+#if _DEBUG_STMT_CACHE
+	if (cache)
+	{
+		printf("[cache] hits: %zu, misses: %zu, evictions: %zu\n", cache->hits, cache->misses, cache->evictions);
+	}
+#endif // #if _DEBUG_STMT_CACHE
+
+	if (out_stats)
+	{
+		out_stats->cacheHits = cache ? cache->hits : 0;
+		out_stats->cacheMisses = cache ? cache->misses : 0;
+		out_stats->cacheEvictions = cache ? cache->evictions : 0;
+	}
+
+	interpreterDestroy(interpreter);
 }
 
 //------------------------------------------------------------------------------
-// 
+// Runs a whole script file: the statements are compiled on threadCount
+// threads (0: one per processor) and then run in order, printing only their
+// output (no banner or prompts). Returns false if the file can't be read.
+//------------------------------------------------------------------------------
+bool ktInterpreterRunFile(const char* path, size_t threadCount)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		printf("*** ERROR: Can't open '%s'.\n", path);
+		return false;
+	}
+
+	char* script = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	bool isRead = true;
+
+	for (;;)
+	{
+		if (!reserve(&script, &capacity, length + KT_INPUT_CHUNK_SIZE))
+		{
+			isRead = false;
+			break;
+		}
+
+		size_t count = fread(&script[length], 1, capacity - length, file);
+		length += count;
+		if (count == 0)
+		{
+			isRead = !ferror(file);
+			break;
+		}
+	}
+
+	fclose(file);
+
+	if (!isRead)
+	{
+		printf("*** ERROR: Can't read '%s'.\n", path);
+		SAFE_DELETE(script);
+		return false;
+	}
+
+	// Same as the REPL: statements are case insensitive.
+	for (size_t i = 0; i < length; ++i)
+	{
+		script[i] = (char)toupper((unsigned char)script[i]);
+	}
+
+	ktInterpreter* interpreter = interpreterCreate(0);
+	ktBatch* batch = interpreter ? ktBatchCompile(script, length, threadCount) : NULL;
+	if (batch)
+	{
+		ktBatchReplay(batch, interpreter->callback, interpreter);
+	}
+	else
+	{
+		printf("*** ERROR: Out of memory.\n");
+	}
+
+	ktBatchDestroy(batch);
+	interpreterDestroy(interpreter);
+	SAFE_DELETE(script);
+
+	return batch != NULL;
+}
+
+//------------------------------------------------------------------------------
+// Without the statement cache, the chunks go straight to the parser.
+//------------------------------------------------------------------------------
+void interpreterFeed(ktInterpreter* interpreter, const char* bytes, size_t length)
+{
+	if (!interpreter)
+		return;
+
+	if (!interpreter->cache)
+	{
+		ktParserFeed(interpreter->parser, bytes, length);
+		return;
+	}
+
+	bool isLineDone = (length > 0 && bytes[length - 1] == '\n');
+
+	// Most lines fit in a single chunk: no need to copy them.
+	if (isLineDone && interpreter->lineLength == 0)
+	{
+		runLine(interpreter, bytes, length);
+		return;
+	}
+
+	if (!reserve(&interpreter->line, &interpreter->lineCapacity, interpreter->lineLength + length))
+	{
+		// Out of memory: this line skips the cache.
+		ktParserFeed(interpreter->parser, interpreter->line, interpreter->lineLength);
+		ktParserFeed(interpreter->parser, bytes, length);
+		interpreter->lineLength = 0;
+		return;
+	}
+
+	memcpy(&interpreter->line[interpreter->lineLength], bytes, length);
+	interpreter->lineLength += length;
+
+	if (isLineDone)
+	{
+		runLine(interpreter, interpreter->line, interpreter->lineLength);
+		interpreter->lineLength = 0;
+	}
+}
+
+//------------------------------------------------------------------------------
+// A last line without a line break always goes to the parser.
 //------------------------------------------------------------------------------
-void interpreterExecute(const char* contents)
+void interpreterFinish(ktInterpreter* interpreter)
 {
-	if (!g_interpreter)
+	if (!interpreter)
 		return;
 
-	ktParserRun(contents);
+	if (interpreter->lineLength > 0)
+	{
+		ktParserFeed(interpreter->parser, interpreter->line, interpreter->lineLength);
+		interpreter->lineLength = 0;
+	}
+
+	ktParserFinish(interpreter->parser);
+}
+
+//------------------------------------------------------------------------------
+// Runs a complete line (with its line break): from the cache if it has been
+// compiled before, through the parser otherwise.
+//------------------------------------------------------------------------------
+void runLine(ktInterpreter* interpreter, const char* bytes, size_t length)
+{
+	if (normalize(interpreter, bytes, length))
+	{
+		const ktProgram* program = ktStmtCacheGet(interpreter->cache, interpreter->key, interpreter->keyLength);
+		if (program)
+		{
+			runProgram(interpreter, program);
+			return;
+		}
+
+		interpreter->isCaching = true;
+	}
+
+	ktParserFeed(interpreter->parser, bytes, length);
+	interpreter->isCaching = false;
+}
+
+//------------------------------------------------------------------------------
+// Builds the line's cache key: blanks are trimmed and runs of them become a
+// single space, so "A+B" and "A + B" are different keys (as "1 2" and "12"
+// must be). Returns false for lines that can't be cached: empty ones, and
+// ones with a line break other than the final "\n" or "\r\n" (more than one
+// statement).
+//------------------------------------------------------------------------------
+bool normalize(ktInterpreter* interpreter, const char* bytes, size_t length)
+{
+	--length;
+	if (length > 0 && bytes[length - 1] == '\r')
+	{
+		--length;
+	}
+
+	if (!reserve(&interpreter->key, &interpreter->keyCapacity, length))
+		return false;
+
+	size_t keyLength = 0;
+	bool isBlank = false;
+	for (size_t i = 0; i < length; ++i)
+	{
+		char c = bytes[i];
+		if (c == '\n' || c == '\r')
+			return false;
+
+		if (c == ' ' || c == '\t')
+		{
+			isBlank = true;
+			continue;
+		}
+
+		if (isBlank && keyLength > 0)
+		{
+			interpreter->key[keyLength++] = ' ';
+		}
+		isBlank = false;
+		interpreter->key[keyLength++] = c;
+	}
+
+	interpreter->keyLength = keyLength;
+
+	return keyLength > 0;
+}
+
+//------------------------------------------------------------------------------
+// Grows buffer (by doubling its capacity) until it holds at least size bytes.
+//------------------------------------------------------------------------------
+bool reserve(char** buffer, size_t* capacity, size_t size)
+{
+	if (size <= *capacity)
+		return true;
+
+	size_t newCapacity = *capacity > 0 ? *capacity : KT_INTERPRETER_LINE_INITIAL_CAPACITY;
+	while (newCapacity < size)
+	{
+		newCapacity *= 2;
+	}
+
+	char* newBuffer = ktRealloc(*buffer, newCapacity);
+	if (!newBuffer)
+		return false;
+
+	*buffer = newBuffer;
+	*capacity = newCapacity;
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onLetStmt(int errorCode, char variable, double value)
+void onLetStmt(int errorCode, char variable, double value, void* userData)
 {
+	ktInterpreter* interpreter = userData;
+
 	if ((errorCode & KT_LET_STMT_VAR_FLAG) == KT_LET_STMT_VAR_FLAG)
-		printError(KT_ERROR_INTERPRETER_LET_STMT_VAR_NOT_SET);
+		printError(interpreter, KT_ERROR_INTERPRETER_LET_STMT_VAR_NOT_SET);
 	if ((errorCode & KT_LET_STMT_VALUE_FLAG) == KT_LET_STMT_VALUE_FLAG)
-		printError(KT_ERROR_INTERPRETER_LET_STMT_VALUE_NOT_SET);
+		printError(interpreter, KT_ERROR_INTERPRETER_LET_STMT_VALUE_NOT_SET);
 	if ((errorCode & KT_LET_STMT_PARAMS_FLAG) == KT_LET_STMT_PARAMS_FLAG)
-		printError(KT_ERROR_INTERPRETER_LET_STMT_INVALID_PARAMS);
+		printError(interpreter, KT_ERROR_INTERPRETER_LET_STMT_INVALID_PARAMS);
 	if (errorCode)
 		return;
 
 	size_t index = (size_t)variable - (size_t)'A';
-	ktMemorySet(g_interpreter->memory, index, value);
-	printf("%c = %.*f\n", variable, DBL_DIG, g_interpreter->memory->vars[index]);
+	ktMemorySet(interpreter->memory, index, value);
+	printf("%c = %.*f\n", variable, DBL_DIG, interpreter->memory->vars[index]);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onResetStmt(int errorCode)
+void onResetStmt(int errorCode, void* userData)
 {
+	ktInterpreter* interpreter = userData;
+
 	if (errorCode)
 	{
-		printError(KT_ERROR_INTERPRETER_RESET_STMT_INVALID_PARAMS);
+		printError(interpreter, KT_ERROR_INTERPRETER_RESET_STMT_INVALID_PARAMS);
 		return;
 	}
 
 	printf("Resetting all variables... ");
-	ktMemoryReset(g_interpreter->memory);
+	ktMemoryReset(interpreter->memory);
 	printf("Done.\n");
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onVarsStmt(int errorCode)
+void onVarsStmt(int errorCode, void* userData)
 {
+	ktInterpreter* interpreter = userData;
+
 	if (errorCode)
 	{
-		printError(KT_ERROR_INTERPRETER_VARS_STMT_INVALID_PARAMS);
+		printError(interpreter, KT_ERROR_INTERPRETER_VARS_STMT_INVALID_PARAMS);
 		return;
 	}
 
@@ -253,10 +516,10 @@ void onVarsStmt(int errorCode)
 	size_t count = 0;
 	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
 	{
-		if (g_interpreter->memory->hasValue[i])
+		if (interpreter->memory->hasValue[i])
 		{
 			++count;
-			printf("%c = %.*f\n", (char)(i + 'A'), DBL_DIG, g_interpreter->memory->vars[i]);
+			printf("%c = %.*f\n", (char)(i + 'A'), DBL_DIG, interpreter->memory->vars[i]);
 		}
 	}
 
@@ -269,8 +532,10 @@ void onVarsStmt(int errorCode)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onClearStmt()
+void onClearStmt(void* userData)
 {
+	(void)userData;
+
 #if _WIN32
 	system("cls");
 #else
@@ -281,311 +546,191 @@ void onClearStmt()
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onExitStmt()
+void onExitStmt(void* userData)
 {
-	g_interpreter->isRunning = false;
+	ktInterpreter* interpreter = userData;
+
+	interpreter->isRunning = false;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Expression statements arrive as programs (see onExprStmtProgram()), so the
+// per-token callbacks below are never called.
 //------------------------------------------------------------------------------
-void onExprStmtBegin(int errorCode)
+void onExprStmtBegin(int errorCode, void* userData)
 {
-	if (errorCode)
-		return;
-
-	exprBufferReset();
+	(void)errorCode;
+	(void)userData;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onExprStmtEnd(int errorCode)
+void onExprStmtEnd(int errorCode, void* userData)
 {
-	if (errorCode)
-	{
-		exprBufferError(KT_ERROR_INTERPRETER_EXPR_STMT_GENERIC);
-	}
-
-	if (g_interpreter->expression->errorType == KT_ERROR_NONE)
-	{
-		while (!ktCharStackIsEmpty(g_interpreter->expression->symbolStack))
-		{
-			if (ktCharStackTop(g_interpreter->expression->symbolStack) == KT_TOKEN_OPEN_PAREN_SYMBOL)
-			{
-				exprBufferError(KT_ERROR_INTERPRETER_EXPR_STMT_OPEN_PAREN);
-				break;
-			}
-
-			exprBufferAppend(ktCharStackPop(g_interpreter->expression->symbolStack));
-		}
-	}
-
-#if _DEBUG_RPN
-	onRpnStmt(0);
-#endif // #if _DEBUG_RPN
-
-	if (g_interpreter->expression->errorType == KT_ERROR_NONE)
-	{
-		double result = 0.0;
-		ktErrorType errorType = evaluateExpr(&result);
-		if (errorType == KT_ERROR_NONE)
-		{
-			printf("%.*f\n", DBL_DIG, result);
-		}
-		else
-		{
-			exprBufferError(errorType);
-		}
-	}
-
-	// Ignore KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET because this error was
-	// already printed inside onVar() function.
-	if (g_interpreter->expression->errorType != KT_ERROR_NONE
-		&& g_interpreter->expression->errorType != KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET)
-	{
-		printError(g_interpreter->expression->errorType);
-	}
-
-	exprBufferReset();
+	(void)errorCode;
+	(void)userData;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onVar(int errorCode, char variable)
+void onVar(int errorCode, char variable, void* userData)
 {
-	if (errorCode)
-		return;
-
-	size_t index = (size_t)variable - (size_t)'A';
-	if (g_interpreter->memory->hasValue[index])
-	{
-		exprBufferAppend(variable);
-	}
-	else
-	{
-		char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
-		snprintf(buffer, KT_ERROR_MESSAGE_MAX_LENGTH, ktErrorDescription(KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET), variable);
-		onError(KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET, buffer);
-		
-		exprBufferError(KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET);
-	}
+	(void)errorCode;
+	(void)variable;
+	(void)userData;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onNumber(int errorCode, double number)
+void onNumber(int errorCode, double number, void* userData)
 {
+	(void)userData;
+
 	printf("[callback] onNumber(errorCode: %d, number: %f)\n", errorCode, number);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onSymbol(int errorCode, char symbol)
+void onSymbol(int errorCode, char symbol, void* userData)
 {
-	if (errorCode)
-		return;
-
-	if (symbol == KT_TOKEN_OPEN_PAREN_SYMBOL)
-	{
-		ktCharStackPush(g_interpreter->expression->symbolStack, symbol);
-	}
-	else if (symbol == KT_TOKEN_CLOSE_PAREN_SYMBOL)
-	{
-		while (ktCharStackTop(g_interpreter->expression->symbolStack) != KT_TOKEN_OPEN_PAREN_SYMBOL)
-		{
-			exprBufferAppend(ktCharStackPop(g_interpreter->expression->symbolStack));
-		}
-
-		// Discard KT_TOKEN_OPEN_PAREN_SYMBOL from the stack.
-		ktCharStackPop(g_interpreter->expression->symbolStack);
-	}
-	else if (isOperator(symbol))
-	{
-		while (!ktCharStackIsEmpty(g_interpreter->expression->symbolStack)
-			&& operatorPriority(symbol) <= operatorPriority(ktCharStackTop(g_interpreter->expression->symbolStack)))
-		{
-			exprBufferAppend(ktCharStackPop(g_interpreter->expression->symbolStack));
-		}
-
-		ktCharStackPush(g_interpreter->expression->symbolStack, symbol);
-	}
+	(void)errorCode;
+	(void)symbol;
+	(void)userData;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onError(ktErrorType errorType, const char* message)
+void onError(ktErrorType errorType, const char* message, void* userData)
 {
-	// Don't print KT_ERROR_PARSER_CONSUME_EXPECTED_GOT in the final build.
-	if (errorType == KT_ERROR_PARSER_CONSUME_EXPECTED_GOT)
-		return;
-
+	(void)userData;
 	printf("*** ERROR: (%d) %s\n", errorType, message);
 }
 
 //------------------------------------------------------------------------------
-// 
+// The parser emits the statement's instructions while it reads them, so all
+// that is left is to run them.
 //------------------------------------------------------------------------------
-bool isOperator(char symbol)
+void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData)
 {
-	return symbol == KT_TOKEN_NEG_SYMBOL
-		|| symbol == KT_TOKEN_POW_SYMBOL
-		|| symbol == KT_TOKEN_DIV_SYMBOL
-		|| symbol == KT_TOKEN_MUL_SYMBOL
-		|| symbol == KT_TOKEN_SUB_SYMBOL
-		|| symbol == KT_TOKEN_ADD_SYMBOL;
-}
+	ktInterpreter* interpreter = userData;
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-int operatorPriority(char operator)
-{
-	if (operator == KT_TOKEN_NEG_SYMBOL)
-		return 4;
-	else if (operator == KT_TOKEN_POW_SYMBOL)
-		return 3;
-	else if (operator == KT_TOKEN_MUL_SYMBOL || operator == KT_TOKEN_DIV_SYMBOL)
-		return 2;
-	else if (operator == KT_TOKEN_ADD_SYMBOL || operator == KT_TOKEN_SUB_SYMBOL)
-		return 1;
-	else
-		return 0;
+	if (errorCode)
+	{
+#if _DEBUG_RPN
+		ktProgramPrint(program);
+#endif // #if _DEBUG_RPN
+
+		printVarsNotSet(interpreter, program);
+		printError(interpreter, exprErrorType(errorCode));
+		return;
+	}
+
+	// Only complete expressions are cached: a repeated line with errors goes
+	// through the parser again, and prints the same errors.
+	if (interpreter->isCaching)
+	{
+		ktStmtCachePut(interpreter->cache, interpreter->key, interpreter->keyLength, program);
+	}
+
+	runProgram(interpreter, program);
 }
 
 //------------------------------------------------------------------------------
-// 
+// Evaluates a complete expression statement and prints its result (or why it
+// has none).
 //------------------------------------------------------------------------------
-void exprBufferAppend(char value)
+void runProgram(ktInterpreter* interpreter, const ktProgram* program)
 {
-	if (g_interpreter->expression->index + 1 >= KT_EXPR_BUFFER_SIZE)
+#if _DEBUG_RPN
+	ktProgramPrint(program);
+#endif // #if _DEBUG_RPN
+
+	double result = 0.0;
+	ktErrorType errorType = ktEvaluate(program, interpreter->memory, &result);
+	if (errorType == KT_ERROR_NONE)
 	{
-		exprBufferError(KT_ERROR_INTERPRETER_EXPR_STMT_BUFFER_OVERFLOW);
-		return;
+		printf("%.*f\n", DBL_DIG, result);
+	}
+	else if (errorType == KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET)
+	{
+		printVarsNotSet(interpreter, program);
+	}
+	else
+	{
+		printError(interpreter, errorType);
 	}
-
-	g_interpreter->expression->buffer[g_interpreter->expression->index++] = value;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Only the errors that get printed are formatted.
 //------------------------------------------------------------------------------
-void exprBufferReset(void)
+void onErrorRecord(const ktParserError* error, const char* contents, void* userData)
 {
-	memset(g_interpreter->expression->buffer, 0, KT_EXPR_BUFFER_SIZE);
-	g_interpreter->expression->index = 0;
-	g_interpreter->expression->errorType = KT_ERROR_NONE;
-	ktCharStackClear(g_interpreter->expression->symbolStack);
+	// Don't print KT_ERROR_PARSER_CONSUME_EXPECTED_GOT in the final build.
+	if (error->type == KT_ERROR_PARSER_CONSUME_EXPECTED_GOT)
+		return;
+
+	char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+	ktParserErrorFormat(error, contents, buffer, KT_ERROR_MESSAGE_MAX_LENGTH);
+	onError(error->type, buffer, userData);
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void exprBufferError(ktErrorType errorType)
+ktErrorType exprErrorType(int errorCode)
 {
-	g_interpreter->expression->errorType = errorType;
+	if ((errorCode & KT_EXPR_STMT_SYNTAX_FLAG) == KT_EXPR_STMT_SYNTAX_FLAG)
+		return KT_ERROR_INTERPRETER_EXPR_STMT_GENERIC;
+	if ((errorCode & KT_EXPR_STMT_OPEN_PAREN_FLAG) == KT_EXPR_STMT_OPEN_PAREN_FLAG)
+		return KT_ERROR_INTERPRETER_EXPR_STMT_OPEN_PAREN;
+	if ((errorCode & KT_EXPR_STMT_OPERAND_FLAG) == KT_EXPR_STMT_OPERAND_FLAG)
+		return KT_ERROR_INTERPRETER_EXPR_STMT_MISSING_OPERAND;
+
+	return KT_ERROR_INTERPRETER_EXPR_STMT_GENERIC;
 }
 
 //------------------------------------------------------------------------------
-// 
+// One error per variable without a value, in the order they appear in the
+// expression.
 //------------------------------------------------------------------------------
-ktErrorType evaluateExpr(double *out_result)
+void printVarsNotSet(ktInterpreter* interpreter, const ktProgram* program)
 {
-	*out_result = 0.0;
-	ktDoubleStack stack =
-	{
-		.data = { 0 },
-		.count = 0
-	};
-
-	const char* expr = g_interpreter->expression->buffer;
-	size_t exprLength = strlen(expr);
-	for (size_t i = 0; i < exprLength; ++i)
+	for (size_t i = 0; i < program->count; ++i)
 	{
-		if (isOperator(expr[i]))
-		{
-			if (ktDoubleStackIsEmpty(&stack))
-				return KT_ERROR_INTERPRETER_EXPR_STMT_EXTRA_OPERATOR;
-
-			double result = 0.0;
-
-			if (expr[i] == KT_TOKEN_NEG_SYMBOL)
-			{
-				result = -ktDoubleStackPop(&stack);
-			}
-			else
-			{
-				double n2 = ktDoubleStackPop(&stack);
-
-				if (ktDoubleStackIsEmpty(&stack))
-					return KT_ERROR_INTERPRETER_EXPR_STMT_MISSING_OPERAND;
-
-				double n1 = ktDoubleStackPop(&stack);
-
-				if (expr[i] == KT_TOKEN_ADD_SYMBOL)
-				{
-					result = n1 + n2;
-				}
-				else if (expr[i] == KT_TOKEN_SUB_SYMBOL)
-				{
-					result = n1 - n2;
-				}
-				else if (expr[i] == KT_TOKEN_MUL_SYMBOL)
-				{
-					result = n1 * n2;
-				}
-				else if (expr[i] == KT_TOKEN_DIV_SYMBOL)
-				{
-					if (fabs(n2) < DBL_EPSILON)
-						return KT_ERROR_INTERPRETER_EXPR_STMT_DIV_BY_ZERO;
-
-					result = n1 / n2;
-				}
-				else if (expr[i] == KT_TOKEN_POW_SYMBOL)
-				{
-					result = pow(n1, n2);
-				}
-			}
-
-			ktDoubleStackPush(&stack, result);
-		}
-		else
-		{
-			size_t index = (size_t)expr[i] - (size_t)'A';
-			ktDoubleStackPush(&stack, g_interpreter->memory->vars[index]);
-		}
-	}
+		const ktInstruction* instruction = &program->code[i];
+		if (instruction->opcode != KT_OP_LOAD_VAR || interpreter->memory->hasValue[instruction->slot])
+			continue;
 
-	if (!ktDoubleStackIsEmpty(&stack))
-	{
-		*out_result = ktDoubleStackPop(&stack);
+		char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+		snprintf(buffer, KT_ERROR_MESSAGE_MAX_LENGTH, ktErrorDescription(KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET), (char)(instruction->slot + 'A'));
+		onError(KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET, buffer, interpreter);
 	}
-
-	return ktDoubleStackIsEmpty(&stack) ? KT_ERROR_NONE : KT_ERROR_INTERPRETER_EXPR_STMT_GENERIC;
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void printError(ktErrorType errorType)
+void printError(ktInterpreter* interpreter, ktErrorType errorType)
 {
-	onError(errorType, ktErrorDescription(errorType));
+	onError(errorType, ktErrorDescription(errorType), interpreter);
 }
 
 #if _DEBUG_RPN
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void onRpnStmt(int errorCode)
+void onRpnStmt(int errorCode, void* userData)
 {
-	if (errorCode)
-		return;
+	(void)errorCode;
+	(void)userData;
 
-	printf("RPN: %s\n", g_interpreter->expression->buffer);
-	printf("symbolStack: %s\n", g_interpreter->expression->symbolStack->data);
+	// Every expression statement already prints its instructions (see
+	// onExprStmtProgram()).
 }
 #endif // #if _DEBUG_RPN
@@ -17,9 +17,37 @@
 #ifndef __KISHITECH_INTERPRETER_H__
 #define __KISHITECH_INTERPRETER_H__
 
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktInterpreterStats ktInterpreterStats;
+
+enum ktInterpreterCacheConstants
+{
+	// Compiled expression statements kept by ktInterpreterRun().
+	KT_INTERPRETER_CACHE_CAPACITY = 64,
+};
+
+// Statement cache counters. A miss is any line that had to be parsed (LET,
+// VARS, etc. are never cached, so they always miss).
+struct ktInterpreterStats
+{
+	size_t cacheHits;
+	size_t cacheMisses;
+	size_t cacheEvictions;
+};
+
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
 void ktInterpreterRun(void);
+void ktInterpreterRunCached(size_t cacheCapacity, ktInterpreterStats* out_stats);
+bool ktInterpreterRunFile(const char* path, size_t threadCount);
 
 #endif // __KISHITECH_INTERPRETER_H__
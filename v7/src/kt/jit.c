@@ -0,0 +1,476 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+// MAP_ANONYMOUS isn't part of strict C17/POSIX.
+#define _DEFAULT_SOURCE
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "jit.h"
+#include "alloc.h"
+#include "utils.h"
+
+#if KT_JIT_ENABLED
+#include <sys/mman.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define EMIT(buffer, ...) \
+	emit(buffer, (const unsigned char[]){ __VA_ARGS__ }, sizeof((const unsigned char[]){ __VA_ARGS__ }))
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktJitBuffer ktJitBuffer;
+
+// The generated code: returns 0 with the value of the expression in
+// *out_result, or 1 if the interpreter must run instead (a variable without a
+// value, or a division by zero). stack has the program's stackSize.
+typedef int (*ktJitFunction)(const double* vars, const bool* hasValue, double* stack, double* out_result);
+
+enum ktJitConstants
+{
+	KT_JIT_INITIAL_CAPACITY = 256,
+
+	// Stack slots are addressed with 32-bit displacements.
+	KT_JIT_MAX_STACK_SIZE = INT32_MAX / sizeof(double),
+
+	// SSE registers, as numbered in ModR/M bytes.
+	KT_JIT_XMM0 = 0,
+	KT_JIT_XMM1 = 1,
+
+	// Jcc rel32 opcodes (after 0F).
+	KT_JIT_JE = 0x84,
+	KT_JIT_JA = 0x87,
+};
+
+struct ktJitBuffer
+{
+	unsigned char* bytes;
+	size_t count;
+	size_t capacity;
+	bool hasError;
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+#if KT_JIT_ENABLED
+static ktErrorType evaluateJit(const ktProgram* program, const ktMemory* memory, double* stack, double* out_result);
+static bool isLeaf(const ktInstruction* instruction);
+static bool isBinary(const ktInstruction* instruction);
+static void emitLeaf(ktJitBuffer* buffer, const ktInstruction* instruction, unsigned int xmm);
+static void emitBinary(ktJitBuffer* buffer, ktOpcode opcode);
+static void emitSlot(ktJitBuffer* buffer, unsigned char opcode, unsigned int xmm, size_t slot);
+static void emitImmediate(ktJitBuffer* buffer, double value, unsigned int xmm);
+static void emitCall(ktJitBuffer* buffer, uintptr_t function);
+static void emitJumpToBail(ktJitBuffer* buffer, unsigned char condition);
+static void emit32(ktJitBuffer* buffer, uint32_t value);
+static void emit64(ktJitBuffer* buffer, uint64_t value);
+static void emit(ktJitBuffer* buffer, const unsigned char* bytes, size_t count);
+#endif // #if KT_JIT_ENABLED
+
+//------------------------------------------------------------------------------
+// Translates the stack code of a complete program into x86-64 (scalar SSE2)
+// code, in a page that is never writable and executable at the same time.
+// The operand stack is kept as in ktEvaluateStack(), except that its top lives
+// in xmm0, and a variable or constant that is the right operand of a binary
+// operator goes straight into xmm1. pow() and sqrt() are ktPow() and
+// ktPowHalf() themselves, so results are the interpreter's, bit for bit.
+// Nothing calls it on its own: mapping a page per program only pays off for
+// programs evaluated many times. Returns false (the program keeps running in
+// the VMs) if it isn't complete, out of memory, or the JIT isn't available.
+//------------------------------------------------------------------------------
+bool ktProgramCompileJit(ktProgram* program)
+{
+#if KT_JIT_ENABLED
+	if (!program || program->count == 0 || program->depth != 1 || program->stackSize > KT_JIT_MAX_STACK_SIZE)
+		return false;
+
+	ktJitBuffer buffer = { NULL, 0, 0, false };
+
+	// Bail out at offset 0, so the checks below jump backwards to a known
+	// address.
+	EMIT(&buffer, 0xB8, 0x01, 0x00, 0x00, 0x00);	// mov eax, 1
+	EMIT(&buffer, 0x41, 0x5D, 0x41, 0x5C, 0x5B);	// pop r13, pop r12, pop rbx
+	EMIT(&buffer, 0xC3);							// ret
+
+	// Entry: rbx = vars, r12 = stack, r13 = out_result. Three pushes leave rsp
+	// 16-byte aligned for the calls.
+	size_t entry = buffer.count;
+	EMIT(&buffer, 0x53, 0x41, 0x54, 0x41, 0x55);	// push rbx, push r12, push r13
+	EMIT(&buffer, 0x48, 0x89, 0xFB);				// mov rbx, rdi
+	EMIT(&buffer, 0x49, 0x89, 0xD4);				// mov r12, rdx
+	EMIT(&buffer, 0x49, 0x89, 0xCD);				// mov r13, rcx
+
+	bool isUsed[KT_VAR_COUNT] = { false };
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		if (program->code[i].opcode == KT_OP_LOAD_VAR)
+			isUsed[program->code[i].slot] = true;
+	}
+
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		if (isUsed[i])
+		{
+			EMIT(&buffer, 0x80, 0x7E, (unsigned char)i, 0x00);	// cmp byte [rsi + i], 0
+			emitJumpToBail(&buffer, KT_JIT_JE);
+		}
+	}
+
+	// depth counts the values on the stack, the top one in xmm0.
+	size_t depth = 0;
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		const ktInstruction* instruction = &program->code[i];
+
+		if (isLeaf(instruction) && depth > 0 && i + 1 < program->count && isBinary(&program->code[i + 1]))
+		{
+			emitLeaf(&buffer, instruction, KT_JIT_XMM1);
+			emitBinary(&buffer, program->code[++i].opcode);
+			continue;
+		}
+
+		switch (instruction->opcode)
+		{
+		case KT_OP_LOAD_VAR:
+		case KT_OP_LOAD_CONST:
+			if (depth > 0)
+				emitSlot(&buffer, 0x11, KT_JIT_XMM0, depth - 1);	// movsd [r12 + slot], xmm0
+
+			emitLeaf(&buffer, instruction, KT_JIT_XMM0);
+			++depth;
+			break;
+
+		case KT_OP_NEG:
+			EMIT(&buffer, 0x66, 0x48, 0x0F, 0x7E, 0xC0);	// movq rax, xmm0
+			EMIT(&buffer, 0x48, 0x0F, 0xBA, 0xF8, 0x3F);	// btc rax, 63
+			EMIT(&buffer, 0x66, 0x48, 0x0F, 0x6E, 0xC0);	// movq xmm0, rax
+			break;
+
+		case KT_OP_SQRT:
+			emitCall(&buffer, (uintptr_t)ktPowHalf);
+			break;
+
+		case KT_OP_SQUARE:
+			EMIT(&buffer, 0xF2, 0x0F, 0x59, 0xC0);			// mulsd xmm0, xmm0
+			break;
+
+		case KT_OP_CUBE:
+			EMIT(&buffer, 0x66, 0x0F, 0x28, 0xC8);			// movapd xmm1, xmm0
+			EMIT(&buffer, 0xF2, 0x0F, 0x59, 0xC0);			// mulsd xmm0, xmm0
+			EMIT(&buffer, 0xF2, 0x0F, 0x59, 0xC1);			// mulsd xmm0, xmm1
+			break;
+
+		case KT_OP_RECIPROCAL:
+			EMIT(&buffer, 0x66, 0x0F, 0x28, 0xC8);			// movapd xmm1, xmm0
+			emitImmediate(&buffer, 1.0, KT_JIT_XMM0);
+			EMIT(&buffer, 0xF2, 0x0F, 0x5E, 0xC1);			// divsd xmm0, xmm1
+			break;
+
+		default:
+			// The left operand comes back from its slot.
+			EMIT(&buffer, 0x66, 0x0F, 0x28, 0xC8);			// movapd xmm1, xmm0
+			emitSlot(&buffer, 0x10, KT_JIT_XMM0, depth - 2);	// movsd xmm0, [r12 + slot]
+			emitBinary(&buffer, instruction->opcode);
+			--depth;
+			break;
+		}
+	}
+
+	EMIT(&buffer, 0xF2, 0x41, 0x0F, 0x11, 0x45, 0x00);	// movsd [r13], xmm0
+	EMIT(&buffer, 0x31, 0xC0);							// xor eax, eax
+	EMIT(&buffer, 0x41, 0x5D, 0x41, 0x5C, 0x5B);		// pop r13, pop r12, pop rbx
+	EMIT(&buffer, 0xC3);								// ret
+
+	void* code = MAP_FAILED;
+	if (!buffer.hasError)
+	{
+		code = mmap(NULL, buffer.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+
+	if (code != MAP_FAILED)
+	{
+		memcpy(code, buffer.bytes, buffer.count);
+		if (mprotect(code, buffer.count, PROT_READ | PROT_EXEC) != 0)
+		{
+			munmap(code, buffer.count);
+			code = MAP_FAILED;
+		}
+	}
+
+	size_t size = buffer.count;
+	SAFE_DELETE(buffer.bytes);
+	if (code == MAP_FAILED)
+		return false;
+
+	ktProgramFreeJit(program);
+	program->jitCode = code;
+	program->jitSize = size;
+	program->jitEntry = entry;
+	program->hasJit = true;
+
+	return true;
+#else
+	(void)program;
+	return false;
+#endif // #if KT_JIT_ENABLED
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktProgramFreeJit(ktProgram* program)
+{
+#if KT_JIT_ENABLED
+	if (program && program->jitCode)
+	{
+		munmap(program->jitCode, program->jitSize);
+	}
+#endif // #if KT_JIT_ENABLED
+
+	if (program)
+	{
+		program->jitCode = NULL;
+		program->jitSize = 0;
+		program->jitEntry = 0;
+		program->hasJit = false;
+	}
+}
+
+//------------------------------------------------------------------------------
+// The operand stack is a local array, or comes from the heap for programs
+// deeper than KT_PROGRAM_LOCAL_STACK_SIZE (like ktEvaluateStack()'s).
+//------------------------------------------------------------------------------
+ktErrorType ktEvaluateJit(const ktProgram* program, const ktMemory* memory, double* out_result)
+{
+#if KT_JIT_ENABLED
+	if (!program->hasJit)
+		return ktEvaluateStack(program, memory, out_result);
+
+	if (program->stackSize <= KT_PROGRAM_LOCAL_STACK_SIZE)
+	{
+		double stack[KT_PROGRAM_LOCAL_STACK_SIZE];
+		return evaluateJit(program, memory, stack, out_result);
+	}
+
+	double* stack = ktAlloc(program->stackSize * sizeof(double));
+	if (!stack)
+		return KT_ERROR_INTERPRETER_EXPR_STMT_BUFFER_OVERFLOW;
+
+	ktErrorType error = evaluateJit(program, memory, stack, out_result);
+	SAFE_DELETE(stack);
+
+	return error;
+#else
+	return ktEvaluateStack(program, memory, out_result);
+#endif // #if KT_JIT_ENABLED
+}
+
+#if KT_JIT_ENABLED
+//------------------------------------------------------------------------------
+// If the generated code bails out, the stack code is run instead, so the
+// error is the same one ktEvaluateStack() finds first.
+//------------------------------------------------------------------------------
+ktErrorType evaluateJit(const ktProgram* program, const ktMemory* memory, double* stack, double* out_result)
+{
+	ktJitFunction function;
+	void* entry = (unsigned char*)program->jitCode + program->jitEntry;
+	memcpy(&function, &entry, sizeof(function));
+
+	double result = 0.0;
+	if (function(memory->vars, memory->hasValue, stack, &result) != 0)
+		return ktEvaluateStack(program, memory, out_result);
+
+	// Same NaN as ktEvaluateStack().
+	*out_result = isnan(result) ? NAN : result;
+	return KT_ERROR_NONE;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool isLeaf(const ktInstruction* instruction)
+{
+	return instruction->opcode == KT_OP_LOAD_VAR || instruction->opcode == KT_OP_LOAD_CONST;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool isBinary(const ktInstruction* instruction)
+{
+	return instruction->opcode >= KT_OP_ADD && instruction->opcode <= KT_OP_POW;
+}
+
+//------------------------------------------------------------------------------
+// Loads a variable or constant into xmm0 or xmm1.
+//------------------------------------------------------------------------------
+void emitLeaf(ktJitBuffer* buffer, const ktInstruction* instruction, unsigned int xmm)
+{
+	if (instruction->opcode == KT_OP_LOAD_CONST)
+	{
+		emitImmediate(buffer, instruction->number, xmm);
+		return;
+	}
+
+	// movsd xmm, [rbx + slot * 8]
+	EMIT(buffer, 0xF2, 0x0F, 0x10, (unsigned char)(0x83 | (xmm << 3)));
+	emit32(buffer, (uint32_t)instruction->slot * sizeof(double));
+}
+
+//------------------------------------------------------------------------------
+// xmm0 = xmm0 op xmm1.
+//------------------------------------------------------------------------------
+void emitBinary(ktJitBuffer* buffer, ktOpcode opcode)
+{
+	switch (opcode)
+	{
+	case KT_OP_ADD:
+		EMIT(buffer, 0xF2, 0x0F, 0x58, 0xC1);			// addsd xmm0, xmm1
+		break;
+
+	case KT_OP_SUB:
+		EMIT(buffer, 0xF2, 0x0F, 0x5C, 0xC1);			// subsd xmm0, xmm1
+		break;
+
+	case KT_OP_MUL:
+		EMIT(buffer, 0xF2, 0x0F, 0x59, 0xC1);			// mulsd xmm0, xmm1
+		break;
+
+	case KT_OP_DIV:
+		// Bail out if fabs(xmm1) < DBL_EPSILON (false for NaN, as in C).
+		EMIT(buffer, 0x66, 0x48, 0x0F, 0x7E, 0xC8);	// movq rax, xmm1
+		EMIT(buffer, 0x48, 0x0F, 0xBA, 0xF0, 0x3F);	// btr rax, 63
+		EMIT(buffer, 0x66, 0x48, 0x0F, 0x6E, 0xD0);	// movq xmm2, rax
+		EMIT(buffer, 0x48, 0xB8);						// mov rax, DBL_EPSILON
+		{
+			double epsilon = DBL_EPSILON;
+			uint64_t bits;
+			memcpy(&bits, &epsilon, sizeof(bits));
+			emit64(buffer, bits);
+		}
+		EMIT(buffer, 0x66, 0x48, 0x0F, 0x6E, 0xD8);	// movq xmm3, rax
+		EMIT(buffer, 0x66, 0x0F, 0x2E, 0xDA);			// ucomisd xmm3, xmm2
+		emitJumpToBail(buffer, KT_JIT_JA);
+		EMIT(buffer, 0xF2, 0x0F, 0x5E, 0xC1);			// divsd xmm0, xmm1
+		break;
+
+	default:
+		emitCall(buffer, (uintptr_t)ktPow);
+		break;
+	}
+}
+
+//------------------------------------------------------------------------------
+// movsd between xmm and [r12 + slot * 8]: opcode 0x10 loads, 0x11 stores.
+//------------------------------------------------------------------------------
+void emitSlot(ktJitBuffer* buffer, unsigned char opcode, unsigned int xmm, size_t slot)
+{
+	EMIT(buffer, 0xF2, 0x41, 0x0F, opcode, (unsigned char)(0x84 | (xmm << 3)), 0x24);
+	emit32(buffer, (uint32_t)(slot * sizeof(double)));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void emitImmediate(ktJitBuffer* buffer, double value, unsigned int xmm)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	EMIT(buffer, 0x48, 0xB8);														// mov rax, value
+	emit64(buffer, bits);
+	EMIT(buffer, 0x66, 0x48, 0x0F, 0x6E, (unsigned char)(0xC0 | (xmm << 3)));	// movq xmm, rax
+}
+
+//------------------------------------------------------------------------------
+// Arguments and result are already in xmm0 (and xmm1).
+//------------------------------------------------------------------------------
+void emitCall(ktJitBuffer* buffer, uintptr_t function)
+{
+	EMIT(buffer, 0x48, 0xB8);	// mov rax, function
+	emit64(buffer, (uint64_t)function);
+	EMIT(buffer, 0xFF, 0xD0);	// call rax
+}
+
+//------------------------------------------------------------------------------
+// Jcc rel32 to offset 0.
+//------------------------------------------------------------------------------
+void emitJumpToBail(ktJitBuffer* buffer, unsigned char condition)
+{
+	EMIT(buffer, 0x0F, condition);
+	emit32(buffer, (uint32_t)-(int64_t)(buffer->count + 4));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void emit32(ktJitBuffer* buffer, uint32_t value)
+{
+	EMIT(buffer,
+		(unsigned char)value, (unsigned char)(value >> 8),
+		(unsigned char)(value >> 16), (unsigned char)(value >> 24));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void emit64(ktJitBuffer* buffer, uint64_t value)
+{
+	emit32(buffer, (uint32_t)value);
+	emit32(buffer, (uint32_t)(value >> 32));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void emit(ktJitBuffer* buffer, const unsigned char* bytes, size_t count)
+{
+	if (buffer->hasError)
+		return;
+
+	if (buffer->count + count > buffer->capacity)
+	{
+		size_t capacity = buffer->capacity ? buffer->capacity : KT_JIT_INITIAL_CAPACITY;
+		while (buffer->count + count > capacity)
+		{
+			capacity *= 2;
+		}
+
+		unsigned char* bytes = ktRealloc(buffer->bytes, capacity);
+		if (!bytes)
+		{
+			buffer->hasError = true;
+			return;
+		}
+
+		buffer->bytes = bytes;
+		buffer->capacity = capacity;
+	}
+
+	memcpy(&buffer->bytes[buffer->count], bytes, count);
+	buffer->count += count;
+}
+#endif // #if KT_JIT_ENABLED
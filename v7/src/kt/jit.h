@@ -14,41 +14,38 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
-#ifndef __KISHITECH_CHAR_STACK_H__
-#define __KISHITECH_CHAR_STACK_H__
+#ifndef __KISHITECH_JIT_H__
+#define __KISHITECH_JIT_H__
 
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include <stddef.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "error_type.h"
+#include "memory.h"
+#include "program.h"
 
 //------------------------------------------------------------------------------
-// Custom types, structs, etc.
-//------------------------------------------------------------------------------
-typedef struct ktCharStack ktCharStack;
-
-enum ktCharStackConstants
-{
-	KT_CHAR_STACK_SIZE = 32,
-};
-
-struct ktCharStack
-{
-	char data[KT_CHAR_STACK_SIZE];
-	size_t count;
-};
+// Macros
+//------------------------------------------------------------------------------
+// Native code is only generated for x86-64 with the System V calling
+// convention and mmap()/mprotect() (Linux). Anywhere else, or with
+// -DKT_JIT_ENABLED=0, ktProgramCompileJit() returns false and programs keep
+// running in the VMs.
+#if !defined(KT_JIT_ENABLED)
+#if defined(__x86_64__) && defined(__linux__)
+#define KT_JIT_ENABLED 1
+#else
+#define KT_JIT_ENABLED 0
+#endif
+#endif // #if !defined(KT_JIT_ENABLED)
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-ktCharStack* ktCharStackCreate(void);
-void ktCharStackDestroy(ktCharStack* stack);
-void ktCharStackPush(ktCharStack* stack, char value);
-char ktCharStackPop(ktCharStack* stack);
-char ktCharStackTop(ktCharStack* stack);
-void ktCharStackClear(ktCharStack* stack);
-bool ktCharStackIsEmpty(ktCharStack* stack);
-bool ktCharStackIsFull(ktCharStack* stack);
+bool ktProgramCompileJit(ktProgram* program);
+void ktProgramFreeJit(ktProgram* program);
+ktErrorType ktEvaluateJit(const ktProgram* program, const ktMemory* memory, double* out_result);
 
-#endif // __KISHITECH_CHAR_STACK_H__
+#endif // __KISHITECH_JIT_H__
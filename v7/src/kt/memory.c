@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "memory.h"
+#include "alloc.h"
 #include "utils.h"
 
 //------------------------------------------------------------------------------
@@ -27,7 +28,7 @@
 //------------------------------------------------------------------------------
 ktMemory* ktMemoryCreate(void)
 {
-    ktMemory* memory = malloc(sizeof(ktMemory));
+    ktMemory* memory = ktAlloc(sizeof(ktMemory));
     if (memory)
     {
         ktMemoryReset(memory);
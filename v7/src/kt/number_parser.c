@@ -0,0 +1,360 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "number_parser.h"
+#include "powers_of_five.h"
+#include "utils.h"
+#include "consts.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktNumberParserConstants
+{
+	// Up to 19 decimal digits always fit in an uint64_t.
+	KT_NUMBER_MAX_MANTISSA_DIGITS = 19,
+	// w * 10^q is exact in a single multiplication/division when both w and
+	// 10^q are exact doubles (Clinger's fast path).
+	KT_NUMBER_MAX_FAST_EXPONENT = 22,
+};
+
+#define KT_NUMBER_MAX_FAST_MANTISSA (UINT64_C(1) << 53)
+
+typedef struct ktUInt128 ktUInt128;
+
+struct ktUInt128
+{
+	uint64_t low;
+	uint64_t high;
+};
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+static const double POWERS_OF_TEN[KT_NUMBER_MAX_FAST_EXPONENT + 1] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static inline int leadingZeros(uint64_t value);
+static inline ktUInt128 multiply(uint64_t a, uint64_t b);
+static bool clinger(uint64_t mantissa, int64_t exponent, double* out_number);
+static bool eiselLemire(uint64_t mantissa, int64_t exponent, double* out_number);
+static bool fallback(const char* data, size_t length, double* out_number);
+
+//------------------------------------------------------------------------------
+// The digits are read once: the first 19 significant digits go to the mantissa
+// and the decimal point position becomes a power of ten exponent, so that the
+// number is mantissa * 10^exponent. Only the rare inputs the fast algorithms
+// can't decide go through strtod().
+//------------------------------------------------------------------------------
+ktErrorType ktNumberParse(const char* data, size_t length, double* out_number)
+{
+	uint64_t mantissa = 0;
+	int64_t exponent = 0;
+	int mantissaDigits = 0;
+	bool hasDigits = false;
+	bool hasDecimalPoint = false;
+	bool hasInvalidChar = false;
+	bool isTruncated = false;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		unsigned char c = (unsigned char)data[i];
+
+		if (c == '.')
+		{
+			// A valid number has zero or only one decimal point.
+			if (hasDecimalPoint)
+			{
+				return KT_ERROR_TOKENIZER_EXTRA_DECIMAL_POINT;
+			}
+
+			hasDecimalPoint = true;
+			continue;
+		}
+
+		unsigned int digit = c - (unsigned int)'0';
+		if (digit > 9)
+		{
+			// Keep going, an extra decimal point takes precedence.
+			hasInvalidChar = true;
+			continue;
+		}
+
+		hasDigits = true;
+
+		if (mantissaDigits == 0 && digit == 0)
+		{
+			// Leading zeros only move the decimal point.
+			exponent -= hasDecimalPoint;
+		}
+		else if (mantissaDigits < KT_NUMBER_MAX_MANTISSA_DIGITS)
+		{
+			mantissa = mantissa * 10 + digit;
+			++mantissaDigits;
+			exponent -= hasDecimalPoint;
+		}
+		else
+		{
+			// Digits that don't fit are dropped; the integer ones still count
+			// towards the magnitude.
+			isTruncated |= (digit != 0);
+			exponent += !hasDecimalPoint;
+		}
+	}
+
+	if (!hasDigits || hasInvalidChar)
+	{
+		return KT_ERROR_TOKENIZER_STR_TO_NUMBER;
+	}
+
+	if (mantissa == 0)
+	{
+		*out_number = 0.0;
+		return KT_ERROR_NONE;
+	}
+
+	if (!isTruncated)
+	{
+		if (clinger(mantissa, exponent, out_number) || eiselLemire(mantissa, exponent, out_number))
+		{
+			return KT_ERROR_NONE;
+		}
+	}
+	else
+	{
+		// The exact value lies between mantissa * 10^exponent and
+		// (mantissa + 1) * 10^exponent; if both round to the same double, so
+		// does the number.
+		double lower = 0.0;
+		double upper = 0.0;
+		if (eiselLemire(mantissa, exponent, &lower)
+			&& eiselLemire(mantissa + 1, exponent, &upper)
+			&& lower == upper)
+		{
+			*out_number = lower;
+			return KT_ERROR_NONE;
+		}
+	}
+
+	return fallback(data, length, out_number) ? KT_ERROR_NONE : KT_ERROR_TOKENIZER_STR_TO_NUMBER;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int leadingZeros(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_clzll(value);
+#else
+	int count = 0;
+	while (!(value & (UINT64_C(1) << 63)))
+	{
+		value <<= 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktUInt128 multiply(uint64_t a, uint64_t b)
+{
+	ktUInt128 result;
+#if defined(__SIZEOF_INT128__)
+	__extension__ unsigned __int128 product = (unsigned __int128)a * b;
+	result.low = (uint64_t)product;
+	result.high = (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	result.low = _umul128(a, b, &result.high);
+#else
+	uint64_t aLow = (uint32_t)a;
+	uint64_t aHigh = a >> 32;
+	uint64_t bLow = (uint32_t)b;
+	uint64_t bHigh = b >> 32;
+
+	uint64_t lowLow = aLow * bLow;
+	uint64_t highLow = aHigh * bLow;
+	uint64_t lowHigh = aLow * bHigh;
+	uint64_t highHigh = aHigh * bHigh;
+
+	uint64_t middle = (lowLow >> 32) + (uint32_t)highLow + lowHigh;
+	result.low = (middle << 32) | (uint32_t)lowLow;
+	result.high = highHigh + (highLow >> 32) + (middle >> 32);
+#endif
+	return result;
+}
+
+//------------------------------------------------------------------------------
+// When the mantissa and 10^|exponent| are both exact doubles, a single IEEE
+// multiplication or division is correctly rounded.
+//------------------------------------------------------------------------------
+bool clinger(uint64_t mantissa, int64_t exponent, double* out_number)
+{
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	if (mantissa > KT_NUMBER_MAX_FAST_MANTISSA
+		|| exponent < -KT_NUMBER_MAX_FAST_EXPONENT
+		|| exponent > KT_NUMBER_MAX_FAST_EXPONENT)
+	{
+		return false;
+	}
+
+	double value = (double)mantissa;
+	*out_number = exponent < 0 ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+	return true;
+#else
+	// Extended precision intermediates would round twice.
+	(void)mantissa;
+	(void)exponent;
+	(void)out_number;
+	return false;
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Eisel-Lemire: multiplies the normalized mantissa by a truncated 128-bit
+// approximation of 5^exponent and keeps the top 54 bits. Returns false when
+// the truncation error or a tie could change the rounding, or when the result
+// is subnormal.
+// Reference: Daniel Lemire, "Number Parsing at a Gigabyte per Second" (2021).
+//------------------------------------------------------------------------------
+bool eiselLemire(uint64_t mantissa, int64_t exponent, double* out_number)
+{
+	if (exponent < KT_POWERS_OF_FIVE_MIN_EXPONENT)
+	{
+		// Less than half of the smallest subnormal.
+		*out_number = 0.0;
+		return true;
+	}
+
+	if (exponent > KT_POWERS_OF_FIVE_MAX_EXPONENT)
+	{
+		*out_number = HUGE_VAL;
+		return true;
+	}
+
+	const uint64_t* power = KT_POWERS_OF_FIVE[exponent - KT_POWERS_OF_FIVE_MIN_EXPONENT];
+
+	// floor(log2(10^exponent)) + IEEE bias + 63 (the product's top bit).
+	int64_t binaryExponent = (((152170 + 65536) * exponent) >> 16) + 1024 + 63;
+
+	int shift = leadingZeros(mantissa);
+	mantissa <<= shift;
+
+	ktUInt128 product = multiply(mantissa, power[0]);
+
+	// The ignored low half of the power adds less than one mantissa to the
+	// low word. Only when that may carry into the bits we keep do we need it.
+	if ((product.high & 0x1FF) == 0x1FF && product.low + mantissa < product.low)
+	{
+		ktUInt128 lowProduct = multiply(mantissa, power[1]);
+		uint64_t middle = product.low + lowProduct.high;
+		if (middle < product.low)
+		{
+			++product.high;
+		}
+
+		if (middle + 1 == 0 && (product.high & 0x1FF) == 0x1FF && lowProduct.low + mantissa < lowProduct.low)
+		{
+			return false;
+		}
+
+		product.low = middle;
+	}
+
+	uint64_t upperBit = product.high >> 63;
+	uint64_t significand = product.high >> (upperBit + 9);
+	shift += (int)(1 ^ upperBit);
+
+	// Possibly right between two doubles: round-half-to-even needs more bits.
+	if (product.low == 0 && (product.high & 0x1FF) == 0 && (significand & 3) == 1)
+	{
+		return false;
+	}
+
+	significand += significand & 1;
+	significand >>= 1;
+
+	if (significand >= (UINT64_C(1) << 53))
+	{
+		// Rounding overflowed to the next power of two.
+		significand = UINT64_C(1) << 52;
+		--shift;
+	}
+
+	significand &= ~(UINT64_C(1) << 52);
+
+	int64_t biasedExponent = binaryExponent - shift;
+	if (biasedExponent < 1 || biasedExponent > 2046)
+	{
+		return false;
+	}
+
+	uint64_t bits = significand | ((uint64_t)biasedExponent << 52);
+	memcpy(out_number, &bits, sizeof(bits));
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// strtod() needs a NUL-terminated string. Numbers that short are copied to the
+// stack, anything longer than KT_NUMBER_MAX_LENGTH is copied to the heap.
+//------------------------------------------------------------------------------
+bool fallback(const char* data, size_t length, double* out_number)
+{
+	char buffer[KT_NUMBER_MAX_LENGTH];
+	char* numberStr = buffer;
+	if (length < KT_NUMBER_MAX_LENGTH)
+	{
+		memcpy(numberStr, data, length);
+		numberStr[length] = '\0';
+	}
+	else if (!ktStringCopyInterval(&numberStr, data, 0, length - 1))
+	{
+		return false;
+	}
+
+	char* endPtr = NULL;
+	*out_number = strtod(numberStr, &endPtr);
+	bool converted = (endPtr == numberStr + length);
+
+	if (numberStr != buffer)
+	{
+		ktStringDestroy(numberStr);
+	}
+
+	return converted;
+}
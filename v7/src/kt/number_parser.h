@@ -0,0 +1,38 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_NUMBER_PARSER_H__
+#define __KISHITECH_NUMBER_PARSER_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include "error_type.h"
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+
+// Converts the number in data[0, length) - digits with zero or one decimal
+// point, not NUL-terminated - to the nearest double, the same value strtod()
+// returns for it. Returns KT_ERROR_NONE on success,
+// KT_ERROR_TOKENIZER_EXTRA_DECIMAL_POINT if there is more than one decimal
+// point and KT_ERROR_TOKENIZER_STR_TO_NUMBER for anything else that isn't a
+// number (e.g. a lone ".").
+ktErrorType ktNumberParse(const char* data, size_t length, double* out_number);
+
+#endif // __KISHITECH_NUMBER_PARSER_H__
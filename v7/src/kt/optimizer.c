@@ -0,0 +1,273 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <float.h>
+#include <math.h>
+#include "optimizer.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static size_t appendNegate(ktInstruction* code, size_t count);
+static size_t appendUnary(ktInstruction* code, size_t count, ktInstruction instruction);
+static size_t appendBinary(ktInstruction* code, size_t count, ktInstruction instruction);
+static bool canFold(ktOpcode opcode, double right);
+static double fold(ktOpcode opcode, double left, double right);
+static bool hasExactReciprocal(double number);
+
+//------------------------------------------------------------------------------
+// Rewrites a complete program in place, with fewer (or as many) instructions:
+// - constant subexpressions are folded into one KT_OP_LOAD_CONST;
+// - a negation of a negation is dropped (the tokenizer drops "--", but not
+//   "-(-A)");
+// - x * 1, x / 1, x ^ 1, x - 0 and x + (-0) become x; x * -1 and x / -1
+//   become -x;
+// - x / c becomes x * (1 / c) when c is a power of two (1 / c is exact, so
+//   both round the same way);
+// - x ^ 0.5 becomes KT_OP_SQRT (correctly rounded, where pow() may be one ulp
+//   off; see ktPowHalf()), and x ^ 2, x ^ 3 and x ^ -1 become KT_OP_SQUARE,
+//   KT_OP_CUBE and KT_OP_RECIPROCAL (what ktPow() does for them at run time,
+//   without its checks).
+// Every other rewrite gives the same result as the original code, bit for
+// bit. Nothing that may fail is removed: a division by a constant that
+// ktEvaluate() would reject is kept as it is, and subexpressions with
+// variables are never dropped. x + 0 stays, since it turns -0 into +0.
+//
+// In postfix code, an operand that ends with a KT_OP_LOAD_CONST is that
+// constant alone (a folded subexpression is always a single load), so looking
+// at the last instructions written is enough: no operand stack is needed and
+// nothing is allocated.
+//------------------------------------------------------------------------------
+void ktProgramOptimize(ktProgram* program)
+{
+	if (!program || program->count == 0 || program->depth != 1)
+		return;
+
+	ktInstruction* code = program->code;
+	size_t count = 0;
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		// Never more instructions written than read, so code[i] is still
+		// there.
+		ktInstruction instruction = code[i];
+		switch (instruction.opcode)
+		{
+		case KT_OP_LOAD_VAR:
+		case KT_OP_LOAD_CONST:
+			code[count++] = instruction;
+			break;
+
+		case KT_OP_NEG:
+			count = appendNegate(code, count);
+			break;
+
+		case KT_OP_SQRT:
+		case KT_OP_SQUARE:
+		case KT_OP_CUBE:
+		case KT_OP_RECIPROCAL:
+			count = appendUnary(code, count, instruction);
+			break;
+
+		default:
+			count = appendBinary(code, count, instruction);
+			break;
+		}
+	}
+
+	// Folding leaves the stack shallower.
+	size_t depth = 0;
+	size_t stackSize = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		switch (code[i].opcode)
+		{
+		case KT_OP_LOAD_VAR:
+		case KT_OP_LOAD_CONST:
+			stackSize = ktMax(stackSize, ++depth);
+			break;
+
+		case KT_OP_NEG:
+		case KT_OP_SQRT:
+		case KT_OP_SQUARE:
+		case KT_OP_CUBE:
+		case KT_OP_RECIPROCAL:
+			break;
+
+		default:
+			--depth;
+			break;
+		}
+	}
+
+	program->count = count;
+	program->stackSize = stackSize;
+	program->hasRegisters = false;
+}
+
+//------------------------------------------------------------------------------
+// Negates the operand that ends at code[count - 1]. Returns the new count.
+//------------------------------------------------------------------------------
+size_t appendNegate(ktInstruction* code, size_t count)
+{
+	ktInstruction* last = &code[count - 1];
+	if (last->opcode == KT_OP_LOAD_CONST)
+	{
+		last->number = -last->number;
+		return count;
+	}
+
+	if (last->opcode == KT_OP_NEG)
+		return count - 1;
+
+	code[count] = (ktInstruction){ .opcode = KT_OP_NEG };
+
+	return count + 1;
+}
+
+//------------------------------------------------------------------------------
+// Applies a power with a constant exponent (other than a negation) to the
+// operand that ends at code[count - 1]. Returns the new count.
+//------------------------------------------------------------------------------
+size_t appendUnary(ktInstruction* code, size_t count, ktInstruction instruction)
+{
+	ktInstruction* last = &code[count - 1];
+	if (last->opcode != KT_OP_LOAD_CONST)
+	{
+		code[count] = instruction;
+		return count + 1;
+	}
+
+	switch (instruction.opcode)
+	{
+	case KT_OP_SQRT: last->number = ktPowHalf(last->number); break;
+	case KT_OP_SQUARE: last->number = ktPow(last->number, 2.0); break;
+	case KT_OP_CUBE: last->number = ktPow(last->number, 3.0); break;
+	default: last->number = ktPow(last->number, -1.0); break;
+	}
+
+	return count;
+}
+
+//------------------------------------------------------------------------------
+// Applies a binary operator to the two operands that end at code[count - 1].
+// Returns the new count.
+//------------------------------------------------------------------------------
+size_t appendBinary(ktInstruction* code, size_t count, ktInstruction instruction)
+{
+	ktInstruction* right = &code[count - 1];
+	if (right->opcode != KT_OP_LOAD_CONST)
+	{
+		code[count] = instruction;
+		return count + 1;
+	}
+
+	ktOpcode opcode = (ktOpcode)instruction.opcode;
+	double number = right->number;
+	ktInstruction* left = &code[count - 2];
+	if (left->opcode == KT_OP_LOAD_CONST && canFold(opcode, number))
+	{
+		left->number = fold(opcode, left->number, number);
+		return count - 1;
+	}
+
+	switch (opcode)
+	{
+	case KT_OP_ADD:
+		if (number == 0.0 && signbit(number))
+			return count - 1;
+		break;
+
+	case KT_OP_SUB:
+		if (number == 0.0 && !signbit(number))
+			return count - 1;
+		break;
+
+	case KT_OP_MUL:
+	case KT_OP_DIV:
+		if (number == 1.0)
+			return count - 1;
+
+		if (number == -1.0)
+			return appendNegate(code, count - 1);
+
+		if (opcode == KT_OP_DIV && hasExactReciprocal(number))
+		{
+			right->number = 1.0 / number;
+			instruction.opcode = KT_OP_MUL;
+		}
+		break;
+
+	case KT_OP_POW:
+		if (number == 1.0)
+			return count - 1;
+
+		if (number == 0.5 || number == 2.0 || number == 3.0 || number == -1.0)
+		{
+			*right = (ktInstruction){ .opcode = (number == 0.5 ? KT_OP_SQRT
+				: number == 2.0 ? KT_OP_SQUARE
+				: number == 3.0 ? KT_OP_CUBE
+				: KT_OP_RECIPROCAL) };
+			return count;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	code[count] = instruction;
+
+	return count + 1;
+}
+
+//------------------------------------------------------------------------------
+// ktEvaluate() rejects divisions by (almost) zero, so those are left for it.
+//------------------------------------------------------------------------------
+bool canFold(ktOpcode opcode, double right)
+{
+	return opcode != KT_OP_DIV || fabs(right) >= DBL_EPSILON;
+}
+
+//------------------------------------------------------------------------------
+// Same operations as ktEvaluate(), so a folded constant is what the program
+// would have computed.
+//------------------------------------------------------------------------------
+double fold(ktOpcode opcode, double left, double right)
+{
+	switch (opcode)
+	{
+	case KT_OP_ADD: return left + right;
+	case KT_OP_SUB: return left - right;
+	case KT_OP_MUL: return left * right;
+	case KT_OP_DIV: return left / right;
+	default: return ktPow(left, right);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Powers of two that ktEvaluate() would divide by: their reciprocals
+// (2^-1023 at the smallest) are exact.
+//------------------------------------------------------------------------------
+bool hasExactReciprocal(double number)
+{
+	int exponent = 0;
+
+	return isfinite(number) && fabs(number) >= DBL_EPSILON && fabs(frexp(number, &exponent)) == 0.5;
+}
@@ -29,7 +29,7 @@
 // 10) <expr>		::= <term> (("+" | "-") <term>)*
 // 11) <term>		::= <factor> (("*" | "/") <factor>)*
 // 12) <factor>		::= <base> ("^" <factor>)*
-// 13) <base>		::= "(" <expr> ")" | (<negate> <term>) | <var>
+// 13) <base>		::= "(" <expr> ")" | (<negate> <term>) | <var> | <number>
 // 14) <var>		::= [A-Z]
 // 15) <number>		::= <negate>? [0-9]+ ("." [0-9]+)?
 // 16) <negate>		::= "~"
@@ -41,8 +41,13 @@
 //------------------------------------------------------------------------------
 #include <stdio.h>
 #include "parser.h"
+#include "alloc.h"
+#include "ast.h"
+#include "event_ring.h"
+#include "optimizer.h"
+#include "program.h"
 #include "tokenizer.h"
-#include "token_list.h"
+#include "token_buffer.h"
 #include "token.h"
 #include "consts.h"
 #include "error_type.h"
@@ -51,261 +56,631 @@
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
-typedef struct ktParser ktParser;
+typedef struct ktParserFrame ktParserFrame;
+
+enum ktParserConstants
+{
+	KT_PARSER_FRAMES_INITIAL_CAPACITY = 32,
+	KT_PARSER_EVENT_RING_CAPACITY = 1024,
+	KT_PARSER_ERRORS_INITIAL_CAPACITY = 16,
+};
+
+// Binding power of the binary operators: <expr> (+ -), <term> (* /) and
+// <factor> (^). 0 means "not a binary operator".
+enum ktParserPrecedence
+{
+	KT_PRECEDENCE_NONE,
+	KT_PRECEDENCE_EXPR,
+	KT_PRECEDENCE_TERM,
+	KT_PRECEDENCE_FACTOR,
+};
+
+enum ktParserFrameType
+{
+	KT_PARSER_FRAME_BINARY,
+	KT_PARSER_FRAME_NEGATE,
+	KT_PARSER_FRAME_PAREN,
+};
+
+typedef enum ktParserFrameType ktParserFrameType;
+
+// Pending work of the expression parser (see expr()): a binary operator
+// waiting for its right operand, a negation waiting for its <term>, or a "("
+// waiting for its ")". minPrecedence is restored when the frame is popped.
+struct ktParserFrame
+{
+	unsigned char type;
+	unsigned char node;
+	unsigned char minPrecedence;
+	ktAstIndex left;
+};
 
 struct ktParser
 {
-	ktTokenList* tokenList;
-	ktToken* token;
+	ktTokenizer* tokenizer;
+	ktTokenBuffer* tokenBuffer;
+
+	// Tokens being parsed: tokenBuffer for ktParserRun(), or the statement
+	// the tokenizer is streaming for ktParserFeed()/ktParserFinish(). NULL
+	// when the tokens are pulled from the tokenizer (lazy token mode).
+	const ktTokenBuffer* tokens;
+	const char* contents;
+	ktParserTokenMode tokenMode;
+	ktParserOutputMode outputMode;
+	ktParserErrorMode errorMode;
+	bool isOptimizing;
+	ktToken token;
+	ktToken lastConsumed;
 	int index;
 
-	ktParserCallback* callback;
+	// KT_PARSER_OUTPUT_MODE_AST/KT_PARSER_OUTPUT_MODE_PROGRAM: tree or
+	// instructions of the expression statement being parsed (no var/symbol
+	// callbacks while isBuildingExpr is set), and its KT_EXPR_STMT_*_FLAG
+	// errors so far.
+	ktAst* ast;
+	ktProgram* program;
+	bool isBuildingExpr;
+	int exprErrorCode;
+
+	// KT_PARSER_OUTPUT_MODE_EVENTS: events recorded instead of calling the
+	// per-token callbacks, and how many were pushed since the last eventBatch.
+	ktEventRing* events;
+	size_t pendingEvents;
+
+	// KT_PARSER_ERROR_MODE_COLLECT: every error since ktParserClearErrors().
+	ktParserError* errors;
+	size_t errorCount;
+	size_t errorCapacity;
+
+	// Explicit stack of expr(), so nesting depth is only limited by memory.
+	ktParserFrame* frames;
+	size_t frameCount;
+	size_t frameCapacity;
+
+	const ktParserCallback* callback;
+	void* userData;
 };
 
-//------------------------------------------------------------------------------
-// Globals (argh!)
-//------------------------------------------------------------------------------
-static ktParser* g_parser = NULL;
-static ktToken* lastConsumed = NULL;
-
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-static void reset(void);
-static void start(void);
-static bool advance(void);
-#if 0
-static ktToken* peek(size_t ahead);
-#endif
-static bool consume(ktTokenType expected);
-
-static void program(void);
-static void stmt(void);
-static void letStmt(void);
-static void resetStmt(void);
-static void varsStmt(void);
-static void clearStmt(void);
-static void exitStmt(void);
-static void exprStmt(void);
-static void expr(void);
-static void term(void);
-static void factor(void);
-static void base(void);
-static void var(bool evaluate);
-static void number(bool evaluate);
-static void negate(bool evaluate);
-static void newline(void);
-static void callbackSymbol(bool consumed);
+static void reset(ktParser* parser);
+static void parse(ktParser* parser, const char* contents, const ktTokenBuffer* tokens);
+static void onStmt(const char* contents, const ktTokenBuffer* tokens, void* userData);
+static void start(ktParser* parser);
+static bool advance(ktParser* parser);
+static bool fetch(ktParser* parser, ktToken* out_token);
+static bool consume(ktParser* parser, ktTokenType expected);
+static void skipToNewline(ktParser* parser);
+static void reportError(ktParser* parser, ktErrorType type, ktTokenType expected);
+static size_t errorOffset(const ktParser* parser);
+static bool appendError(ktParser* parser, const ktParserError* error);
+
+static void program(ktParser* parser);
+static void stmt(ktParser* parser);
+static void letStmt(ktParser* parser);
+static void resetStmt(ktParser* parser);
+static void varsStmt(ktParser* parser);
+static void clearStmt(ktParser* parser);
+static void exitStmt(ktParser* parser);
+static void exprStmt(ktParser* parser);
+static ktAstIndex expr(ktParser* parser);
+static bool pushFrame(ktParser* parser, ktParserFrameType type, ktAstNodeType node, ktAstIndex left, int minPrecedence);
+static int binaryPrecedence(ktTokenType type);
+static void var(ktParser* parser, bool evaluate);
+static void number(ktParser* parser, bool evaluate);
+static void negate(ktParser* parser, bool evaluate);
+static void newline(ktParser* parser);
+static void callbackSymbol(ktParser* parser, bool consumed);
+static ktAstIndex makeNode(ktParser* parser, ktAstNodeType type, char var, double number, ktAstIndex left, ktAstIndex right);
+static ktOpcode nodeOpcode(ktAstNodeType type);
+static void pushEvent(ktParser* parser, ktEventType type, int errorCode, char value, double number);
+static void flushEvents(ktParser* parser);
 
 #if _DEBUG_RPN
-static void rpnStmt(void);
+static void rpnStmt(ktParser* parser);
 #endif // #if _DEBUG_RPN
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void ktParserCreate(ktParserCallback* callback)
+ktParser* ktParserCreate(const ktParserCallback* callback, void* userData)
 {
-	g_parser = malloc(sizeof(ktParser));
-	if (g_parser)
+	ktParser* parser = ktAlloc(sizeof(ktParser));
+	if (parser)
 	{
-		g_parser->tokenList = ktTokenListCreate();
-		g_parser->token = NULL;
-		g_parser->index = -1;
-		g_parser->callback = callback;
+		parser->tokenizer = ktTokenizerCreate();
+		parser->tokenBuffer = ktTokenBufferCreate();
+		parser->tokens = parser->tokenBuffer;
+		parser->contents = NULL;
+		parser->tokenMode = KT_PARSER_TOKEN_MODE_LAZY;
+		parser->outputMode = KT_PARSER_OUTPUT_MODE_CALLBACKS;
+		parser->errorMode = KT_PARSER_ERROR_MODE_MESSAGES;
+		parser->isOptimizing = true;
+		parser->token = ktTokenMakeSymbol(KT_TOKEN_EOF);
+		parser->lastConsumed = parser->token;
+		parser->index = -1;
+		parser->ast = ktAstCreate();
+		parser->program = ktProgramCreate();
+		parser->isBuildingExpr = false;
+		parser->exprErrorCode = 0;
+		parser->events = ktEventRingCreate(KT_PARSER_EVENT_RING_CAPACITY);
+		parser->pendingEvents = 0;
+		parser->errors = NULL;
+		parser->errorCount = 0;
+		parser->errorCapacity = 0;
+		parser->frames = NULL;
+		parser->frameCount = 0;
+		parser->frameCapacity = 0;
+		parser->callback = callback;
+		parser->userData = userData;
+
+		ktTokenizerSetStmtCallback(parser->tokenizer, onStmt, parser);
 	}
+
+	return parser;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktParserDestroy(ktParser* parser)
+{
+	if (parser)
+	{
+		ktTokenizerDestroy(parser->tokenizer);
+		ktTokenBufferDestroy(parser->tokenBuffer);
+		ktAstDestroy(parser->ast);
+		ktProgramDestroy(parser->program);
+		ktEventRingDestroy(parser->events);
+		SAFE_DELETE(parser->errors);
+		SAFE_DELETE(parser->frames);
+		SAFE_DELETE(parser);
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktParserSetTokenMode(ktParser* parser, ktParserTokenMode mode)
+{
+	if (!parser)
+		return;
+
+	parser->tokenMode = mode;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktParserSetOutputMode(ktParser* parser, ktParserOutputMode mode)
+{
+	if (!parser)
+		return;
+
+	parser->outputMode = mode;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktParserSetErrorMode(ktParser* parser, ktParserErrorMode mode)
+{
+	if (!parser)
+		return;
+
+	parser->errorMode = mode;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktParserSetOptimize(ktParser* parser, bool isOptimizing)
+{
+	if (!parser)
+		return;
+
+	parser->isOptimizing = isOptimizing;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktParserRun(ktParser* parser, const char* contents)
+{
+	if (!parser)
+		return;
+
+	reset(parser);
+
+	if (parser->tokenMode == KT_PARSER_TOKEN_MODE_LAZY)
+	{
+		ktTokenizerBegin(parser->tokenizer, contents);
+		parse(parser, contents, NULL);
+	}
+	else
+	{
+		ktTokenizerRun(parser->tokenizer, contents, parser->tokenBuffer);
+		parse(parser, contents, parser->tokenBuffer);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Streams the input through the tokenizer; each statement is parsed as soon as
+// its line break arrives (see ktTokenizerFeed()).
+//------------------------------------------------------------------------------
+bool ktParserFeed(ktParser* parser, const char* bytes, size_t length)
+{
+	if (!parser)
+		return false;
+
+	return ktTokenizerFeed(parser->tokenizer, bytes, length);
+}
+
+//------------------------------------------------------------------------------
+// Parses the last statement if the input didn't end with a line break.
+//------------------------------------------------------------------------------
+void ktParserFinish(ktParser* parser)
+{
+	if (!parser)
+		return;
+
+	ktTokenizerFinish(parser->tokenizer);
+}
+
+//------------------------------------------------------------------------------
+// KT_PARSER_ERROR_MODE_COLLECT: errors are kept (across runs and statements)
+// until ktParserClearErrors().
+//------------------------------------------------------------------------------
+size_t ktParserErrorCount(const ktParser* parser)
+{
+	return parser ? parser->errorCount : 0;
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void ktParserDestroy()
+const ktParserError* ktParserErrorGet(const ktParser* parser, size_t index)
+{
+	if (!parser || index >= parser->errorCount)
+		return NULL;
+
+	return &parser->errors[index];
+}
+
+//------------------------------------------------------------------------------
+// O(1), keeps the capacity for the next batch.
+//------------------------------------------------------------------------------
+void ktParserClearErrors(ktParser* parser)
 {
-	if (g_parser)
+	if (!parser)
+		return;
+
+	parser->errorCount = 0;
+}
+
+//------------------------------------------------------------------------------
+// Builds the message of an error. Unknown commands and tokenizer errors quote
+// the contents, so they must be the ones the error came from.
+//------------------------------------------------------------------------------
+void ktParserErrorFormat(const ktParserError* error, const char* contents, char* buffer, size_t size)
+{
+	if (!error || !buffer || size == 0)
+		return;
+
+	buffer[0] = '\0';
+
+	switch (error->type)
 	{
-		ktTokenListDestroy(g_parser->tokenList);
-		SAFE_DELETE(g_parser);
+	case KT_ERROR_PARSER_UNKNOWN_COMMAND:
+	{
+		// The word text is only copied from the contents when we need it,
+		// and only as much as fits in the error message.
+		char word[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+		if (contents)
+		{
+			ktTokenCopyStringToBuffer(&error->token, contents, word, KT_ERROR_MESSAGE_MAX_LENGTH);
+		}
+		snprintf(buffer, size, ktErrorDescription(error->type), word);
+		break;
+	}
+
+	case KT_ERROR_PARSER_TOKENIZER_ERROR:
+		if (contents)
+		{
+			ktTokenErrorMessage(&error->token, contents, buffer, size);
+		}
+		break;
+
+	case KT_ERROR_PARSER_CONSUME_EXPECTED_GOT:
+		snprintf(buffer, size, ktErrorDescription(error->type), KT_TOKEN_TYPE_STR[error->expected], KT_TOKEN_TYPE_STR[error->token.type]);
+		break;
+
+	default:
+		snprintf(buffer, size, "%s", ktErrorDescription(error->type));
+		break;
 	}
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void ktParserRun(const char* contents)
+void reset(ktParser* parser)
 {
-	reset();
-	ktTokenizerRun(contents, g_parser->tokenList);
+	ktTokenBufferClear(parser->tokenBuffer);
+	parser->token = ktTokenMakeSymbol(KT_TOKEN_EOF);
+	parser->index = -1;
+
+	// Don't let a token consumed in the previous run leak into this one.
+	parser->lastConsumed = parser->token;
+}
+
+//------------------------------------------------------------------------------
+// The contents don't need to be NUL-terminated; tokens only point into them.
+// Without a token buffer, tokens are pulled from the tokenizer on demand.
+//------------------------------------------------------------------------------
+void parse(ktParser* parser, const char* contents, const ktTokenBuffer* tokens)
+{
+	parser->tokens = tokens;
+	parser->contents = contents;
 
 #if _DEBUG_PARSER_SHOW_TOKENLIST
-	ktTokenNode* curr = g_parser->tokenList->head;
-	while (curr)
+	for (size_t i = 0; tokens && i < tokens->count; ++i)
 	{
-		ktTokenPrint(curr->token);
-		curr = curr->next;
+		ktToken token = ktTokenBufferGet(tokens, i);
+		ktTokenPrint(&token, contents);
 	}
 #endif // #if _DEBUG_PARSER_SHOW_TOKENLIST
 
-	start();
+	start(parser);
 
-	if (g_parser->token->type != KT_TOKEN_EOF)
+	if (parser->token.type != KT_TOKEN_EOF)
 	{
 		// If we reached this point, then we found an error!
-		if (g_parser->token->type == KT_TOKEN_WORD)
+		if (parser->token.type == KT_TOKEN_WORD)
 		{
-			char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
-			snprintf(buffer, KT_ERROR_MESSAGE_MAX_LENGTH, ktErrorDescription(KT_ERROR_PARSER_UNKNOWN_COMMAND), g_parser->token->string);
-			g_parser->callback->error(KT_ERROR_PARSER_UNKNOWN_COMMAND, buffer);
+			reportError(parser, KT_ERROR_PARSER_UNKNOWN_COMMAND, KT_TOKEN_EOF);
 		}
-		else if (g_parser->token->type == KT_TOKEN_NUMBER || g_parser->token->type == KT_TOKEN_EQUALS)
+		else if (parser->token.type == KT_TOKEN_EQUALS)
 		{
-			g_parser->callback->error(KT_ERROR_PARSER_DID_YOU_MEAN_LET, ktErrorDescription(KT_ERROR_PARSER_DID_YOU_MEAN_LET));
+			reportError(parser, KT_ERROR_PARSER_DID_YOU_MEAN_LET, KT_TOKEN_EOF);
 		}
-		else if (g_parser->token->type == KT_TOKEN_ERROR)
+		else if (parser->token.type == KT_TOKEN_ERROR)
 		{
-			g_parser->callback->error(KT_ERROR_PARSER_TOKENIZER_ERROR, g_parser->token->string);
+			reportError(parser, KT_ERROR_PARSER_TOKENIZER_ERROR, KT_TOKEN_EOF);
 		}
 	}
 }
 
 //------------------------------------------------------------------------------
-//
+// Tokenizer statement callback used by ktParserFeed()/ktParserFinish().
 //------------------------------------------------------------------------------
-void reset(void)
+void onStmt(const char* contents, const ktTokenBuffer* tokens, void* userData)
 {
-	if (!g_parser)
-		return;
+	ktParser* parser = userData;
 
-	ktTokenListClear(g_parser->tokenList);
-	g_parser->token = NULL;
-	g_parser->index = -1;
+	reset(parser);
+	parse(parser, contents, tokens);
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void start(void)
+void start(ktParser* parser)
 {
-	advance();
-	program();
+	advance(parser);
+	program(parser);
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-bool advance(void)
+bool advance(ktParser* parser)
 {
-	++g_parser->index;
-	if (g_parser->index >= (int)g_parser->tokenList->count)
+	++parser->index;
+
+	ktToken token;
+	if (!fetch(parser, &token))
 	{
 		// If we reached this point, then we found an error!
-		g_parser->callback->error(KT_ERROR_PARSER_NO_MORE_TOKENS, ktErrorDescription(KT_ERROR_PARSER_NO_MORE_TOKENS));
+		reportError(parser, KT_ERROR_PARSER_NO_MORE_TOKENS, KT_TOKEN_EOF);
 
 		return false;
 	}
 	else
 	{
-		if (g_parser->index > 0)
-		{
-			ktTokenListCursorAdvance(g_parser->tokenList);
-		}
-		g_parser->token = g_parser->tokenList->cursor->token;
+		parser->token = token;
 		
 		return true;
 	}
 }
 
-#if 0
 //------------------------------------------------------------------------------
-//
+// Gets the token at parser->index, either from the token buffer or by
+// pulling the next one from the tokenizer.
 //------------------------------------------------------------------------------
-ktToken* peek(size_t ahead)
+bool fetch(ktParser* parser, ktToken* out_token)
 {
-	if (!g_parser)
-		return NULL;
-
-	if (g_parser->index + ahead < g_parser->tokenList->count)
+	if (parser->tokens)
 	{
-		ktTokenNode* originalCursor = g_parser->tokenList->cursor;
-		for (size_t i = 0; i < ahead; ++i)
-		{
-			ktTokenListCursorAdvance(g_parser->tokenList);
-		}
-		ktToken* token = g_parser->tokenList->cursor->token;
-		g_parser->tokenList->cursor = originalCursor;
+		if (parser->index >= (int)parser->tokens->count)
+			return false;
 
-		return token;
+		*out_token = ktTokenBufferGet(parser->tokens, parser->index);
+		return true;
 	}
 
-	return NULL;
+	if (!ktTokenizerNext(parser->tokenizer, out_token))
+		return false;
+
+#if _DEBUG_PARSER_SHOW_TOKENLIST
+	ktTokenPrint(out_token, parser->contents);
+#endif // #if _DEBUG_PARSER_SHOW_TOKENLIST
+
+	return true;
 }
-#endif
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-bool consume(ktTokenType expected)
+bool consume(ktParser* parser, ktTokenType expected)
 {
-	if (g_parser->token->type == expected)
+	if (parser->token.type == expected)
 	{
-		lastConsumed = g_parser->token;
-		advance();
+		parser->lastConsumed = parser->token;
+		advance(parser);
 		
 		return true;
 	}
 	else
 	{
 		// If we reached this point, then we found an error!
+		reportError(parser, KT_ERROR_PARSER_CONSUME_EXPECTED_GOT, expected);
+
+		// HACK: Since there is an error, let's skip right to the next KT_TOKEN_NEWLINE in the token buffer.
+		skipToNewline(parser);
+
+		return false;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Records an error about the current token. Only KT_PARSER_ERROR_MODE_MESSAGES
+// turns it into text right away.
+//------------------------------------------------------------------------------
+void reportError(ktParser* parser, ktErrorType type, ktTokenType expected)
+{
+	ktParserError error =
+	{
+		.type = type,
+		.tokenIndex = parser->index,
+		.offset = errorOffset(parser),
+		.expected = expected,
+		.token = parser->token
+	};
+
+	switch (parser->errorMode)
+	{
+	case KT_PARSER_ERROR_MODE_RECORDS:
+		parser->callback->errorRecord(&error, parser->contents, parser->userData);
+		break;
+
+	case KT_PARSER_ERROR_MODE_COLLECT:
+		appendError(parser, &error);
+		break;
+
+	case KT_PARSER_ERROR_MODE_MESSAGES:
+	default:
+	{
 		char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
-		snprintf(buffer, KT_ERROR_MESSAGE_MAX_LENGTH, ktErrorDescription(KT_ERROR_PARSER_CONSUME_EXPECTED_GOT), KT_TOKEN_TYPE_STR[expected], KT_TOKEN_TYPE_STR[g_parser->token->type]);
-		g_parser->callback->error(KT_ERROR_PARSER_CONSUME_EXPECTED_GOT, buffer);
+		ktParserErrorFormat(&error, parser->contents, buffer, KT_ERROR_MESSAGE_MAX_LENGTH);
+		parser->callback->error(type, buffer, parser->userData);
+		break;
+	}
+	}
+}
 
-		// HACK: Since there is an error, let's skip right to the next KT_TOKEN_NEWLINE in the token list.
-		size_t steps = (g_parser->tokenList->count - 1) - g_parser->index;
-		while (steps && g_parser->tokenList->cursor->token->type != KT_TOKEN_NEWLINE)
+//------------------------------------------------------------------------------
+// Where the current token starts. Outside a token buffer (before the first
+// token, or after fetch() ran out of them), that is where the nearest token
+// starts.
+//------------------------------------------------------------------------------
+size_t errorOffset(const ktParser* parser)
+{
+	if (!parser->tokens)
+		return ktTokenizerLastOffset(parser->tokenizer);
+
+	size_t count = parser->tokens->count;
+	if (count == 0)
+		return 0;
+
+	if (parser->index < 0)
+		return parser->tokens->offsets[0];
+
+	size_t index = (size_t)parser->index;
+	return parser->tokens->offsets[index < count ? index : count - 1];
+}
+
+//------------------------------------------------------------------------------
+// Out of memory drops the error.
+//------------------------------------------------------------------------------
+bool appendError(ktParser* parser, const ktParserError* error)
+{
+	if (parser->errorCount == parser->errorCapacity)
+	{
+		size_t capacity = parser->errorCapacity > 0 ? parser->errorCapacity * 2 : KT_PARSER_ERRORS_INITIAL_CAPACITY;
+		ktParserError* errors = ktRealloc(parser->errors, capacity * sizeof(ktParserError));
+		if (!errors)
+			return false;
+
+		parser->errors = errors;
+		parser->errorCapacity = capacity;
+	}
+
+	parser->errors[parser->errorCount++] = *error;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void skipToNewline(ktParser* parser)
+{
+	if (parser->tokens)
+	{
+		int last = (int)parser->tokens->count - 1;
+		while (parser->index < last && parser->tokens->types[parser->index] != KT_TOKEN_NEWLINE)
 		{
-			++g_parser->index;
-			ktTokenListCursorAdvance(g_parser->tokenList);
-			--steps;
+			++parser->index;
+		}
+		parser->token = ktTokenBufferGet(parser->tokens, parser->index);
+	}
+	else
+	{
+		ktToken token;
+		while (parser->token.type != KT_TOKEN_NEWLINE && fetch(parser, &token))
+		{
+			++parser->index;
+			parser->token = token;
 		}
-		g_parser->token = g_parser->tokenList->cursor->token;
-
-		return false;
 	}
 }
 
 //------------------------------------------------------------------------------
 // 1) <program>		::= (<stmt> | <newline>)* 
 //------------------------------------------------------------------------------
-void program(void)
+void program(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] program()\n");
 
-	while (g_parser->token->type == KT_TOKEN_STMT_LET
-		|| g_parser->token->type == KT_TOKEN_STMT_RESET
-		|| g_parser->token->type == KT_TOKEN_STMT_VARS
-		|| g_parser->token->type == KT_TOKEN_STMT_CLEAR
-		|| g_parser->token->type == KT_TOKEN_STMT_EXIT
-		|| g_parser->token->type == KT_TOKEN_OPEN_PAREN
-		|| g_parser->token->type == KT_TOKEN_VAR
-		|| g_parser->token->type == KT_TOKEN_NEG
-		|| g_parser->token->type == KT_TOKEN_NEWLINE
+	while (parser->token.type == KT_TOKEN_STMT_LET
+		|| parser->token.type == KT_TOKEN_STMT_RESET
+		|| parser->token.type == KT_TOKEN_STMT_VARS
+		|| parser->token.type == KT_TOKEN_STMT_CLEAR
+		|| parser->token.type == KT_TOKEN_STMT_EXIT
+		|| parser->token.type == KT_TOKEN_OPEN_PAREN
+		|| parser->token.type == KT_TOKEN_VAR
+		|| parser->token.type == KT_TOKEN_NUMBER
+		|| parser->token.type == KT_TOKEN_NEG
+		|| parser->token.type == KT_TOKEN_NEWLINE
 
 		// The tokens below were added so the interpreter outputs
 		// the same exprStmt error if a string begins with an operator
 		// or a symbol that is related to an exprStmt.
-		|| g_parser->token->type == KT_TOKEN_ADD
-		|| g_parser->token->type == KT_TOKEN_SUB
-		|| g_parser->token->type == KT_TOKEN_MUL
-		|| g_parser->token->type == KT_TOKEN_DIV
-		|| g_parser->token->type == KT_TOKEN_POW
-		|| g_parser->token->type == KT_TOKEN_CLOSE_PAREN
+		|| parser->token.type == KT_TOKEN_ADD
+		|| parser->token.type == KT_TOKEN_SUB
+		|| parser->token.type == KT_TOKEN_MUL
+		|| parser->token.type == KT_TOKEN_DIV
+		|| parser->token.type == KT_TOKEN_POW
+		|| parser->token.type == KT_TOKEN_CLOSE_PAREN
 
 #if _DEBUG_RPN
-		|| g_parser->token->type == KT_TOKEN_STMT_RPN
+		|| parser->token.type == KT_TOKEN_STMT_RPN
 #endif // #if _DEBUG_RPN
 	)
 	{
-		switch (g_parser->token->type)
+		switch (parser->token.type)
 		{
 		case KT_TOKEN_STMT_LET:
 		case KT_TOKEN_STMT_RESET:
@@ -314,6 +689,7 @@ void program(void)
 		case KT_TOKEN_STMT_EXIT:
 		case KT_TOKEN_OPEN_PAREN:
 		case KT_TOKEN_VAR:
+		case KT_TOKEN_NUMBER:
 		case KT_TOKEN_NEG:
 			// The tokens below were added so the interpreter outputs
 			// the same exprStmt error if a string begins with an operator
@@ -328,12 +704,12 @@ void program(void)
 #if _DEBUG_RPN
 		case KT_TOKEN_STMT_RPN:
 #endif // #if _DEBUG_RPN
-			stmt();
+			stmt(parser);
 			break;
 
 		case KT_TOKEN_NEWLINE:
 		default:
-			advance();
+			advance(parser);
 			break;
 		}
 	}
@@ -343,376 +719,627 @@ void program(void)
 // 2) <stmt>		::= <stmt_list> <newline>
 // 3) <stmt_list>	::= <let_stmt> | <reset_stmt> | <vars_stmt> | <clear_stmt> | <exit_stmt> | <expr_stmt>
 //------------------------------------------------------------------------------
-void stmt(void)
+void stmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] stmt()\n");
 
-	switch (g_parser->token->type)
+	switch (parser->token.type)
 	{
 	case KT_TOKEN_STMT_LET:
-		letStmt();
+		letStmt(parser);
 		break;
 
 	case KT_TOKEN_STMT_RESET:
-		resetStmt();
+		resetStmt(parser);
 		break;
 
 	case KT_TOKEN_STMT_VARS:
-		varsStmt();
+		varsStmt(parser);
 		break;
 
 	case KT_TOKEN_STMT_CLEAR:
-		clearStmt();
+		clearStmt(parser);
 		break;
 
 	case KT_TOKEN_STMT_EXIT:
-		exitStmt();
+		exitStmt(parser);
 		break;
 
 #if _DEBUG_RPN
 	case KT_TOKEN_STMT_RPN:
-		rpnStmt();
+		rpnStmt(parser);
 		break;
 #endif // #if _DEBUG_RPN
 
 	default:
-		exprStmt();
+		exprStmt(parser);
 		break;
 	}
+
+	flushEvents(parser);
 }
 
 //------------------------------------------------------------------------------
 // 4) <let_stmt>	::= "LET" <var> "=" <number>
 //------------------------------------------------------------------------------
-void letStmt(void)
+void letStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] letStmt()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_STMT_LET)\n");
-	consume(KT_TOKEN_STMT_LET);
+	consume(parser, KT_TOKEN_STMT_LET);
 
-	var(false);
-	bool variableConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_VAR);
-	char variable = variableConsumed ? lastConsumed->var : '\0';
+	var(parser, false);
+	bool variableConsumed = (parser->lastConsumed.type == KT_TOKEN_VAR);
+	char variable = variableConsumed ? parser->lastConsumed.value.var : '\0';
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_EQUALS)\n");
-	bool equalsConsumed = consume(KT_TOKEN_EQUALS);
-	callbackSymbol(equalsConsumed);
+	bool equalsConsumed = consume(parser, KT_TOKEN_EQUALS);
+	callbackSymbol(parser, equalsConsumed);
 
-	number(false);
-	bool numberConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NUMBER);
-	double number = numberConsumed ? lastConsumed->number : 0.0;
+	number(parser, false);
+	bool numberConsumed = (parser->lastConsumed.type == KT_TOKEN_NUMBER);
+	double number = numberConsumed ? parser->lastConsumed.value.number : 0.0;
 
-	newline();
-	bool newlineConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NEWLINE);
+	newline(parser);
+	bool newlineConsumed = (parser->lastConsumed.type == KT_TOKEN_NEWLINE);
 	
 	int errorCode = 0;
 	if (!variableConsumed) errorCode |= KT_LET_STMT_VAR_FLAG;
 	if (!numberConsumed) errorCode |= KT_LET_STMT_VALUE_FLAG;
 	if (!newlineConsumed) errorCode |= KT_LET_STMT_PARAMS_FLAG;
-	g_parser->callback->letStmt(errorCode, variable, number);
+	parser->callback->letStmt(errorCode, variable, number, parser->userData);
 }
 
 //------------------------------------------------------------------------------
 // 5) <reset_stmt>	::= "RESET"
 //------------------------------------------------------------------------------
-void resetStmt(void)
+void resetStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] resetStmt()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_STMT_RESET)\n");
-	bool resetConsumed = consume(KT_TOKEN_STMT_RESET);
+	bool resetConsumed = consume(parser, KT_TOKEN_STMT_RESET);
 
-	newline();
-	bool newlineConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NEWLINE);
+	newline(parser);
+	bool newlineConsumed = (parser->lastConsumed.type == KT_TOKEN_NEWLINE);
 	int errorCode = (resetConsumed && newlineConsumed ? 0 : 1);
 
-	g_parser->callback->resetStmt(errorCode);
+	parser->callback->resetStmt(errorCode, parser->userData);
 }
 
 //------------------------------------------------------------------------------
 // 6) <vars_stmt>	::= "VARS"
 //------------------------------------------------------------------------------
-void varsStmt(void)
+void varsStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] varsStmt()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_STMT_VARS)\n");
-	bool varsConsumed = consume(KT_TOKEN_STMT_VARS);
+	bool varsConsumed = consume(parser, KT_TOKEN_STMT_VARS);
 
-	newline();
-	bool newlineConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NEWLINE);
+	newline(parser);
+	bool newlineConsumed = (parser->lastConsumed.type == KT_TOKEN_NEWLINE);
 	int errorCode = (varsConsumed && newlineConsumed ? 0 : 1);
 
-	g_parser->callback->varsStmt(errorCode);
+	parser->callback->varsStmt(errorCode, parser->userData);
 }
 
 //------------------------------------------------------------------------------
 // 7) <clear_stmt>	::= "CLEAR"
 //------------------------------------------------------------------------------
-void clearStmt(void)
+void clearStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] clearStmt()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_STMT_CLEAR)\n");
-	bool clearConsumed = consume(KT_TOKEN_STMT_CLEAR);
+	bool clearConsumed = consume(parser, KT_TOKEN_STMT_CLEAR);
 
-	newline();
-	//bool newlineConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NEWLINE);
+	newline(parser);
+	//bool newlineConsumed = (parser->lastConsumed.type == KT_TOKEN_NEWLINE);
 	//int errorCode = (clearConsumed && newlineConsumed ? 0 : 1);
 
 	if (clearConsumed)
 	{
-		g_parser->callback->clearStmt();
+		parser->callback->clearStmt(parser->userData);
 	}
 }
 
 //------------------------------------------------------------------------------
 // 8) <exit_stmt>	::= "EXIT"
 //------------------------------------------------------------------------------
-void exitStmt(void)
+void exitStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] exitStmt()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_STMT_EXIT)\n");
-	bool exitConsumed = consume(KT_TOKEN_STMT_EXIT);
+	bool exitConsumed = consume(parser, KT_TOKEN_STMT_EXIT);
 
-	newline();
-	//bool newlineConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NEWLINE);
+	newline(parser);
+	//bool newlineConsumed = (parser->lastConsumed.type == KT_TOKEN_NEWLINE);
 	//int errorCode = (exitConsumed && newlineConsumed ? 0 : 1);
 
 	if (exitConsumed)
 	{
-		g_parser->callback->exitStmt();
+		parser->callback->exitStmt(parser->userData);
 	}
 }
 
 //------------------------------------------------------------------------------
 // 9) <expr_stmt>	::= <expr>
 //------------------------------------------------------------------------------
-void exprStmt(void)
+void exprStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] exprStmt()\n");
 
-	g_parser->callback->exprStmtBegin(0);
+	parser->isBuildingExpr = (parser->outputMode == KT_PARSER_OUTPUT_MODE_AST
+		|| parser->outputMode == KT_PARSER_OUTPUT_MODE_PROGRAM);
+	if (parser->isBuildingExpr)
+	{
+		ktAstReset(parser->ast);
+		ktProgramReset(parser->program);
+		parser->exprErrorCode = 0;
+	}
+	else if (parser->outputMode == KT_PARSER_OUTPUT_MODE_EVENTS)
+	{
+		pushEvent(parser, KT_EVENT_EXPR_STMT_BEGIN, 0, '\0', 0.0);
+	}
+	else
+	{
+		parser->callback->exprStmtBegin(0, parser->userData);
+	}
 
-	expr();
+	ktAstIndex root = expr(parser);
 
 	// We know an <expr_stmt> reached its end when we find a line break.
-	newline();
-	bool newlineConsumed = (lastConsumed && lastConsumed->type == KT_TOKEN_NEWLINE);
-	int errorCode = (newlineConsumed ? 0 : 1);
+	newline(parser);
+	bool newlineConsumed = (parser->lastConsumed.type == KT_TOKEN_NEWLINE);
+	int errorCode = (newlineConsumed ? 0 : KT_EXPR_STMT_SYNTAX_FLAG);
 
-	g_parser->callback->exprStmtEnd(errorCode);
-}
-
-//------------------------------------------------------------------------------
-// 10) <expr>		::= <term> (("+" | "-") <term>)*
-//------------------------------------------------------------------------------
-void expr(void)
-{
-	DEBUG_PRINT("[parser] expr()\n");
-
-	term();
-	
-	while (g_parser->token->type == KT_TOKEN_ADD || g_parser->token->type == KT_TOKEN_SUB)
+	if (parser->isBuildingExpr)
 	{
-		if (g_parser->token->type == KT_TOKEN_ADD)
+		parser->isBuildingExpr = false;
+		errorCode |= parser->exprErrorCode;
+		if (root == KT_AST_NONE)
 		{
-			DEBUG_PRINT("[parser] consume(KT_TOKEN_ADD)\n");
-			bool addConsumed = consume(KT_TOKEN_ADD);
-			callbackSymbol(addConsumed);
-
+			errorCode |= KT_EXPR_STMT_OPERAND_FLAG;
 		}
-		else if (g_parser->token->type == KT_TOKEN_SUB)
+
+		if (parser->outputMode == KT_PARSER_OUTPUT_MODE_AST)
 		{
-			DEBUG_PRINT("[parser] consume(KT_TOKEN_SUB)\n");
-			bool subConsumed = consume(KT_TOKEN_SUB);
-			callbackSymbol(subConsumed);
+			parser->ast->root = root;
+
+#if _DEBUG_PARSER_SHOW_AST
+			ktAstPrint(parser->ast, root);
+			printf("\n");
+#endif // #if _DEBUG_PARSER_SHOW_AST
+
+			parser->callback->exprStmtAst(errorCode, parser->ast, parser->userData);
 		}
+		else
+		{
+			if (errorCode == 0 && parser->isOptimizing)
+			{
+				ktProgramOptimize(parser->program);
+			}
 
-		term();
+			parser->callback->exprStmtProgram(errorCode, parser->program, parser->userData);
+		}
+	}
+	else if (parser->outputMode == KT_PARSER_OUTPUT_MODE_EVENTS)
+	{
+		pushEvent(parser, KT_EVENT_EXPR_STMT_END, errorCode, '\0', 0.0);
+	}
+	else
+	{
+		parser->callback->exprStmtEnd(errorCode, parser->userData);
 	}
 }
 
 //------------------------------------------------------------------------------
+// 10) <expr>		::= <term> (("+" | "-") <term>)*
 // 11) <term>		::= <factor> (("*" | "/") <factor>)*
-//------------------------------------------------------------------------------
-void term(void)
+// 12) <factor>		::= <base> ("^" <factor>)*
+// 13) <base>		::= "(" <expr> ")" | (<negate> <term>) | <var> | <number>
+//
+// Precedence climbing without recursion: whatever the recursive descent
+// would keep on the C stack (operators waiting for their right operand,
+// negations waiting for their <term>, open parentheses) is pushed to
+// parser->frames instead. Tokens are consumed (and callbacks fired) in the
+// same order as the grammar above, "+ - * /" are left-associative, "^" is
+// right-associative and a negation applies to the whole <term> after it.
+//------------------------------------------------------------------------------
+ktAstIndex expr(ktParser* parser)
 {
-	DEBUG_PRINT("[parser] term()\n");
+	DEBUG_PRINT("[parser] expr()\n");
 
-	factor();
+	size_t bottom = parser->frameCount;
+	int minPrecedence = KT_PRECEDENCE_EXPR;
 
-	while (g_parser->token->type == KT_TOKEN_MUL || g_parser->token->type == KT_TOKEN_DIV)
+	while (true)
 	{
-		if (g_parser->token->type == KT_TOKEN_MUL)
+		// <base>: any number of "-" and "(" before a <var> or a <number> (or
+		// nothing, if the operand is missing).
+		while (parser->token.type == KT_TOKEN_NEG || parser->token.type == KT_TOKEN_OPEN_PAREN)
 		{
-			DEBUG_PRINT("[parser] consume(KT_TOKEN_MUL)\n");
-			bool mulConsumed = consume(KT_TOKEN_MUL);
-			callbackSymbol(mulConsumed);
+			bool isNegate = (parser->token.type == KT_TOKEN_NEG);
+			ktParserFrameType type = isNegate ? KT_PARSER_FRAME_NEGATE : KT_PARSER_FRAME_PAREN;
+			if (!pushFrame(parser, type, KT_AST_NEG, KT_AST_NONE, minPrecedence))
+			{
+				// Out of memory: drop the rest of the statement.
+				parser->frameCount = bottom;
+				parser->exprErrorCode |= KT_EXPR_STMT_SYNTAX_FLAG;
+				skipToNewline(parser);
+				return KT_AST_NONE;
+			}
+
+			if (isNegate)
+			{
+				negate(parser, true);
+				minPrecedence = KT_PRECEDENCE_TERM;
+			}
+			else
+			{
+				DEBUG_PRINT("[parser] consume(KT_TOKEN_OPEN_PAREN)\n");
+				bool openParenConsumed = consume(parser, KT_TOKEN_OPEN_PAREN);
+				callbackSymbol(parser, openParenConsumed);
+				minPrecedence = KT_PRECEDENCE_EXPR;
+			}
 		}
-		else if (g_parser->token->type == KT_TOKEN_DIV)
+
+		ktAstIndex left = KT_AST_NONE;
+		if (parser->token.type == KT_TOKEN_VAR)
+		{
+			var(parser, true);
+			left = makeNode(parser, KT_AST_VAR, parser->lastConsumed.value.var, 0.0, KT_AST_NONE, KT_AST_NONE);
+		}
+		else if (parser->token.type == KT_TOKEN_NUMBER)
 		{
-			DEBUG_PRINT("[parser] consume(KT_TOKEN_DIV)\n");
-			bool divConsumed = consume(KT_TOKEN_DIV);
-			callbackSymbol(divConsumed);
+			number(parser, true);
+			left = makeNode(parser, KT_AST_NUMBER, '\0', parser->lastConsumed.value.number, KT_AST_NONE, KT_AST_NONE);
 		}
 
-		factor();
+		// Binary operators that bind at least as tightly as minPrecedence take
+		// left as their left operand; anything else completes the top frame.
+		while (true)
+		{
+			int precedence = binaryPrecedence(parser->token.type);
+			if (precedence != KT_PRECEDENCE_NONE && precedence >= minPrecedence)
+			{
+				ktTokenType operator = parser->token.type;
+				ktAstNodeType node = (operator == KT_TOKEN_ADD ? KT_AST_ADD
+					: operator == KT_TOKEN_SUB ? KT_AST_SUB
+					: operator == KT_TOKEN_MUL ? KT_AST_MUL
+					: operator == KT_TOKEN_DIV ? KT_AST_DIV
+					: KT_AST_POW);
+
+				if (!pushFrame(parser, KT_PARSER_FRAME_BINARY, node, left, minPrecedence))
+				{
+					parser->frameCount = bottom;
+					parser->exprErrorCode |= KT_EXPR_STMT_SYNTAX_FLAG;
+					skipToNewline(parser);
+					return KT_AST_NONE;
+				}
+
+				DEBUG_PRINT("[parser] consume(%s)\n", KT_TOKEN_TYPE_STR[operator]);
+				bool operatorConsumed = consume(parser, operator);
+				callbackSymbol(parser, operatorConsumed);
+
+				// "^" is right-associative: its right operand may have more "^".
+				minPrecedence = (operator == KT_TOKEN_POW ? precedence : precedence + 1);
+				break;
+			}
+
+			if (parser->frameCount == bottom)
+				return left;
+
+			ktParserFrame frame = parser->frames[--parser->frameCount];
+			minPrecedence = frame.minPrecedence;
+
+			if (frame.type == KT_PARSER_FRAME_BINARY)
+			{
+				left = makeNode(parser, (ktAstNodeType)frame.node, '\0', 0.0, frame.left, left);
+			}
+			else if (frame.type == KT_PARSER_FRAME_NEGATE)
+			{
+				left = makeNode(parser, KT_AST_NEG, '\0', 0.0, left, KT_AST_NONE);
+			}
+			else
+			{
+				DEBUG_PRINT("[parser] consume(KT_TOKEN_CLOSE_PAREN)\n");
+				bool closeParenConsumed = consume(parser, KT_TOKEN_CLOSE_PAREN);
+				callbackSymbol(parser, closeParenConsumed);
+
+				if (!closeParenConsumed)
+				{
+					parser->exprErrorCode |= KT_EXPR_STMT_OPEN_PAREN_FLAG;
+				}
+			}
+		}
 	}
 }
 
 //------------------------------------------------------------------------------
-// 12) <factor>		::= <base> ("^" <factor>)*
+//
 //------------------------------------------------------------------------------
-void factor(void)
+bool pushFrame(ktParser* parser, ktParserFrameType type, ktAstNodeType node, ktAstIndex left, int minPrecedence)
 {
-	DEBUG_PRINT("[parser] factor()\n");
-
-	base();
-
-	while (g_parser->token->type == KT_TOKEN_POW)
+	if (parser->frameCount == parser->frameCapacity)
 	{
-		DEBUG_PRINT("[parser] consume(KT_TOKEN_POW)\n");
-		bool powConsumed = consume(KT_TOKEN_POW);
-		callbackSymbol(powConsumed);
+		size_t capacity = parser->frameCapacity > 0 ? parser->frameCapacity * 2 : KT_PARSER_FRAMES_INITIAL_CAPACITY;
+		ktParserFrame* frames = ktRealloc(parser->frames, capacity * sizeof(ktParserFrame));
+		if (!frames)
+			return false;
 
-		factor();
+		parser->frames = frames;
+		parser->frameCapacity = capacity;
 	}
+
+	ktParserFrame* frame = &parser->frames[parser->frameCount++];
+	frame->type = (unsigned char)type;
+	frame->node = (unsigned char)node;
+	frame->minPrecedence = (unsigned char)minPrecedence;
+	frame->left = left;
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
-// 13) <base>		::= "(" <expr> ")" | (<negate> <term>) | <var>
+//
 //------------------------------------------------------------------------------
-void base(void)
+int binaryPrecedence(ktTokenType type)
 {
-	DEBUG_PRINT("[parser] base()\n");
-
-	if (g_parser->token->type == KT_TOKEN_OPEN_PAREN)
+	switch (type)
 	{
-		DEBUG_PRINT("[parser] consume(KT_TOKEN_OPEN_PAREN)\n");
-		bool openParenConsumed = consume(KT_TOKEN_OPEN_PAREN);
-		callbackSymbol(openParenConsumed);
+	case KT_TOKEN_ADD:
+	case KT_TOKEN_SUB:
+		return KT_PRECEDENCE_EXPR;
 
-		expr();
+	case KT_TOKEN_MUL:
+	case KT_TOKEN_DIV:
+		return KT_PRECEDENCE_TERM;
 
-		DEBUG_PRINT("[parser] consume(KT_TOKEN_CLOSE_PAREN)\n");
-		bool closeParenConsumed = consume(KT_TOKEN_CLOSE_PAREN);
-		callbackSymbol(closeParenConsumed);
-	}
-	else if (g_parser->token->type == KT_TOKEN_NEG)
-	{
-		negate(true);
-		term();
-	}
-	else if (g_parser->token->type == KT_TOKEN_VAR)
-	{
-		var(true);
+	case KT_TOKEN_POW:
+		return KT_PRECEDENCE_FACTOR;
+
+	default:
+		return KT_PRECEDENCE_NONE;
 	}
 }
 
 //------------------------------------------------------------------------------
 // 14) <var>		::= [A-Z]
 //------------------------------------------------------------------------------
-void var(bool evaluate)
+void var(ktParser* parser, bool evaluate)
 {
 	DEBUG_PRINT("[parser] var()\n");
 
-	DEBUG_PRINT("[parser] consume(KT_TOKEN_VAR) = %c\n", g_parser->token->var);
-	bool varConsumed = consume(KT_TOKEN_VAR);
+	DEBUG_PRINT("[parser] consume(KT_TOKEN_VAR) = %c\n", parser->token.value.var);
+	bool varConsumed = consume(parser, KT_TOKEN_VAR);
 
-	if (evaluate)
+	if (evaluate && !parser->isBuildingExpr)
 	{
 		int errorCode = (varConsumed ? 0 : 1);
-		g_parser->callback->var(errorCode, lastConsumed->var);
+		if (parser->outputMode == KT_PARSER_OUTPUT_MODE_EVENTS)
+		{
+			pushEvent(parser, KT_EVENT_VAR, errorCode, parser->lastConsumed.value.var, 0.0);
+		}
+		else
+		{
+			parser->callback->var(errorCode, parser->lastConsumed.value.var, parser->userData);
+		}
 	}
 }
 
 //------------------------------------------------------------------------------
 // 15) <number>		::= <negate>? [0-9]+ ("." [0-9]+)?
 //------------------------------------------------------------------------------
-void number(bool evaluate)
+void number(ktParser* parser, bool evaluate)
 {
 	DEBUG_PRINT("[parser] number()\n");
 
-	bool isNegative = (g_parser->token->type == KT_TOKEN_NEG);
+	bool isNegative = (parser->token.type == KT_TOKEN_NEG);
 	if (isNegative)
 	{
-		negate(evaluate);
+		negate(parser, evaluate);
 	}
 
-	double number = g_parser->token->number;
+	double number = parser->token.value.number;
 	if (isNegative)
 	{
 		number = -number;
 	}
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_NUMBER) = %f\n", number);
-	bool numberConsumed = consume(KT_TOKEN_NUMBER);
+	bool numberConsumed = consume(parser, KT_TOKEN_NUMBER);
 
 	if (numberConsumed)
 	{
-		lastConsumed->number = number;
+		parser->lastConsumed.value.number = number;
 	}
 
-	if (evaluate)
+	if (evaluate && !parser->isBuildingExpr)
 	{
 		int errorCode = (numberConsumed ? 0 : 1);
-		g_parser->callback->number(errorCode, lastConsumed->number);
+		if (parser->outputMode == KT_PARSER_OUTPUT_MODE_EVENTS)
+		{
+			pushEvent(parser, KT_EVENT_NUMBER, errorCode, '\0', parser->lastConsumed.value.number);
+		}
+		else
+		{
+			parser->callback->number(errorCode, parser->lastConsumed.value.number, parser->userData);
+		}
 	}
 }
 
 //------------------------------------------------------------------------------
 // 16) <negate>		::= "~"
 //------------------------------------------------------------------------------
-void negate(bool evaluate)
+void negate(ktParser* parser, bool evaluate)
 {
 	DEBUG_PRINT("[parser] negate()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_NEG)\n");
-	bool negConsumed = consume(KT_TOKEN_NEG);
+	bool negConsumed = consume(parser, KT_TOKEN_NEG);
 	
 	if (evaluate)
 	{
-		callbackSymbol(negConsumed);
+		callbackSymbol(parser, negConsumed);
 	}
 }
 
 //------------------------------------------------------------------------------
 // 17) <newline>	::= "\n" | "\r" | "\r\n"
 //------------------------------------------------------------------------------
-void newline(void)
+void newline(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] newline()\n");
 
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_NEWLINE)\n");
-	bool newlineConsumed = consume(KT_TOKEN_NEWLINE);
-	callbackSymbol(newlineConsumed);
+	bool newlineConsumed = consume(parser, KT_TOKEN_NEWLINE);
+	callbackSymbol(parser, newlineConsumed);
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void callbackSymbol(bool consumed)
+void callbackSymbol(ktParser* parser, bool consumed)
 {
+	if (parser->isBuildingExpr)
+		return;
+
 	int errorCode = consumed ? 0 : 1;
+	char symbol = (errorCode == 0 ? parser->lastConsumed.value.symbol : '\0');
+
+	if (parser->outputMode == KT_PARSER_OUTPUT_MODE_EVENTS)
+	{
+		pushEvent(parser, KT_EVENT_SYMBOL, errorCode, symbol, 0.0);
+	}
+	else
+	{
+		parser->callback->symbol(errorCode, symbol, parser->userData);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Appends a node to the statement's tree, or its instruction to the
+// statement's program, when building one. Returns where it went (anything but
+// KT_AST_NONE tells the caller there is an operand). A missing operand (or
+// running out of memory) is recorded in exprErrorCode; no instruction is
+// emitted for it, so a program never underflows its stack.
+//------------------------------------------------------------------------------
+ktAstIndex makeNode(ktParser* parser, ktAstNodeType type, char var, double number, ktAstIndex left, ktAstIndex right)
+{
+	if (!parser->isBuildingExpr)
+		return KT_AST_NONE;
+
+	bool hasOperands = (type == KT_AST_VAR || type == KT_AST_NUMBER)
+		|| (type == KT_AST_NEG && left != KT_AST_NONE)
+		|| (left != KT_AST_NONE && right != KT_AST_NONE);
+
+	if (!hasOperands)
+	{
+		parser->exprErrorCode |= KT_EXPR_STMT_OPERAND_FLAG;
+	}
+
+	if (parser->outputMode == KT_PARSER_OUTPUT_MODE_PROGRAM)
+	{
+		if (!hasOperands)
+			return KT_AST_NONE;
+
+		unsigned char slot = (type == KT_AST_VAR ? (unsigned char)(var - 'A') : 0);
+		bool isAppended = (type == KT_AST_NUMBER
+			? ktProgramAppendConst(parser->program, number)
+			: ktProgramAppend(parser->program, nodeOpcode(type), slot));
+		if (!isAppended)
+		{
+			parser->exprErrorCode |= KT_EXPR_STMT_SYNTAX_FLAG;
+			return KT_AST_NONE;
+		}
+
+		return (ktAstIndex)(parser->program->count - 1);
+	}
+
+	ktAstNode node =
+	{
+		.type = (unsigned char)type,
+		.var = var,
+		.left = left,
+		.right = right,
+		.number = number
+	};
+
+	ktAstIndex index = ktAstAppend(parser->ast, node);
+	if (index == KT_AST_NONE)
+	{
+		parser->exprErrorCode |= KT_EXPR_STMT_SYNTAX_FLAG;
+	}
+
+	return index;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktOpcode nodeOpcode(ktAstNodeType type)
+{
+	switch (type)
+	{
+	case KT_AST_VAR: return KT_OP_LOAD_VAR;
+	case KT_AST_NUMBER: return KT_OP_LOAD_CONST;
+	case KT_AST_NEG: return KT_OP_NEG;
+	case KT_AST_ADD: return KT_OP_ADD;
+	case KT_AST_SUB: return KT_OP_SUB;
+	case KT_AST_MUL: return KT_OP_MUL;
+	case KT_AST_DIV: return KT_OP_DIV;
+	default: return KT_OP_POW;
+	}
+}
+
+//------------------------------------------------------------------------------
+// Records an event for the current statement. A full ring is handed over
+// early; eventBatch must make room before it returns.
+//------------------------------------------------------------------------------
+void pushEvent(ktParser* parser, ktEventType type, int errorCode, char value, double number)
+{
+	ktEvent event =
+	{
+		.type = (unsigned char)type,
+		.errorCode = (unsigned char)errorCode,
+		.value = value,
+		.number = number
+	};
+
+	while (!ktEventRingPush(parser->events, &event))
+	{
+		parser->pendingEvents = 0;
+		parser->callback->eventBatch(parser->events, parser->userData);
+	}
+
+	++parser->pendingEvents;
+}
+
+//------------------------------------------------------------------------------
+// Hands the statement's events over in one call, once it has been parsed.
+//------------------------------------------------------------------------------
+void flushEvents(ktParser* parser)
+{
+	if (parser->pendingEvents == 0)
+		return;
 
-	g_parser->callback->symbol(errorCode,
-		errorCode == 0
-		? (lastConsumed ? lastConsumed->symbol : '\0')
-		: '\0');
+	parser->pendingEvents = 0;
+	parser->callback->eventBatch(parser->events, parser->userData);
 }
 
 #if _DEBUG_RPN
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void rpnStmt(void)
+void rpnStmt(ktParser* parser)
 {
 	DEBUG_PRINT("[parser] consume(KT_TOKEN_STMT_RPN)\n");
-	bool rpnConsumed = consume(KT_TOKEN_STMT_RPN);
+	bool rpnConsumed = consume(parser, KT_TOKEN_STMT_RPN);
 	int errorCode = (rpnConsumed ? 0 : 1);
-	g_parser->callback->rpnStmt(errorCode);
+	parser->callback->rpnStmt(errorCode, parser->userData);
 }
 #endif // #if _DEBUG_RPN
@@ -20,38 +20,134 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include "ast.h"
 #include "error_type.h"
+#include "event_ring.h"
+#include "program.h"
+#include "token.h"
 #include "debug.h"
 
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
+typedef struct ktParser ktParser;
 typedef struct ktParserCallback ktParserCallback;
+typedef struct ktParserError ktParserError;
 
+// How ktParserRun() gets its tokens: all of them up front in a token buffer,
+// or one at a time straight from the tokenizer as the parser advances
+// (memory doesn't grow with the length of the contents).
+enum ktParserTokenMode
+{
+	KT_PARSER_TOKEN_MODE_LAZY,
+	KT_PARSER_TOKEN_MODE_BUFFERED,
+};
+
+typedef enum ktParserTokenMode ktParserTokenMode;
+
+// How expression statements are reported: one callback per variable and
+// symbol (exprStmtBegin, var, symbol, ..., exprStmtEnd), a single
+// exprStmtAst callback with the statement's tree, built in an arena that is
+// reset for every statement, or a single exprStmtProgram callback with the
+// statement's instructions, emitted while parsing. The tree and the program
+// are only valid during the callback. KT_PARSER_OUTPUT_MODE_EVENTS records
+// what the per-token callbacks would get (exprStmtBegin, var, number, symbol,
+// exprStmtEnd) as ktEvents in a ring, handed over with one eventBatch call
+// per statement. Programs of complete statements are optimized (see
+// ktProgramOptimize()) unless ktParserSetOptimize() turned it off.
+enum ktParserOutputMode
+{
+	KT_PARSER_OUTPUT_MODE_CALLBACKS,
+	KT_PARSER_OUTPUT_MODE_AST,
+	KT_PARSER_OUTPUT_MODE_PROGRAM,
+	KT_PARSER_OUTPUT_MODE_EVENTS,
+};
+
+typedef enum ktParserOutputMode ktParserOutputMode;
+
+// What the parser does with its errors: format a message for the error
+// callback, hand a ktParserError record to the errorRecord callback (no text
+// is built unless the consumer calls ktParserErrorFormat()), or only keep the
+// records for ktParserErrorGet() (bulk validation).
+enum ktParserErrorMode
+{
+	KT_PARSER_ERROR_MODE_MESSAGES,
+	KT_PARSER_ERROR_MODE_RECORDS,
+	KT_PARSER_ERROR_MODE_COLLECT,
+};
+
+typedef enum ktParserErrorMode ktParserErrorMode;
+
+// A parser error, as found. token is the offending token, tokenIndex and
+// offset are where it is in the contents given to ktParserRun() (or in the
+// statement's line, for ktParserFeed()). expected is the token type consume()
+// wanted (KT_ERROR_PARSER_CONSUME_EXPECTED_GOT only).
+struct ktParserError
+{
+	ktErrorType type;
+	int tokenIndex;
+	size_t offset;
+	ktTokenType expected;
+	ktToken token;
+};
+
+// Every callback gets the userData given to ktParserCreate(), so several
+// parsers (e.g. one per thread) can run at the same time without sharing state.
 struct ktParserCallback
 {
-	void (*letStmt)(int errorCode, char variable, double value);
-	void (*resetStmt)(int errorCode);
-	void (*varsStmt)(int errorCode);
-	void (*clearStmt)(void);
-	void (*exitStmt)(void);
-	void (*exprStmtBegin)(int errorCode);
-	void (*exprStmtEnd)(int errorCode);
-	void (*var)(int errorCode, char variable);
-	void (*number)(int errorCode, double number);
-	void (*symbol)(int errorCode, char symbol);
-	void (*error)(ktErrorType errorType, const char* message);
+	void (*letStmt)(int errorCode, char variable, double value, void* userData);
+	void (*resetStmt)(int errorCode, void* userData);
+	void (*varsStmt)(int errorCode, void* userData);
+	void (*clearStmt)(void* userData);
+	void (*exitStmt)(void* userData);
+	void (*exprStmtBegin)(int errorCode, void* userData);
+	void (*exprStmtEnd)(int errorCode, void* userData);
+	void (*var)(int errorCode, char variable, void* userData);
+	void (*number)(int errorCode, double number, void* userData);
+	void (*symbol)(int errorCode, char symbol, void* userData);
+	void (*error)(ktErrorType errorType, const char* message, void* userData);
+
+	// KT_PARSER_OUTPUT_MODE_AST and KT_PARSER_OUTPUT_MODE_PROGRAM only.
+	// errorCode has KT_EXPR_STMT_*_FLAG bits set if the statement isn't a
+	// complete expression (the tree may have KT_AST_NONE nodes, the program
+	// must not be evaluated).
+	void (*exprStmtAst)(int errorCode, const ktAst* ast, void* userData);
+	void (*exprStmtProgram)(int errorCode, const ktProgram* program, void* userData);
+
+	// KT_PARSER_OUTPUT_MODE_EVENTS only. Called once a statement that recorded
+	// events has been parsed (after its letStmt, resetStmt... callback, if
+	// any), and early if a statement fills the ring. The consumer takes the events with
+	// ktEventRingRead(), here or on another thread, but must leave room for
+	// at least one event before returning (e.g. by waiting for that thread).
+	void (*eventBatch)(ktEventRing* events, void* userData);
+
+	// KT_PARSER_ERROR_MODE_RECORDS only. contents are the ones the error's
+	// token points into (for ktParserErrorFormat()), valid during the call.
+	void (*errorRecord)(const ktParserError* error, const char* contents, void* userData);
 
 #if _DEBUG_RPN
-	void (*rpnStmt)(int errorCode);
+	void (*rpnStmt)(int errorCode, void* userData);
 #endif // #if _DEBUG_RPN
 };
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-void ktParserCreate(ktParserCallback* callback);
-void ktParserDestroy();
-void ktParserRun(const char* contents);
+ktParser* ktParserCreate(const ktParserCallback* callback, void* userData);
+void ktParserDestroy(ktParser* parser);
+void ktParserSetTokenMode(ktParser* parser, ktParserTokenMode mode);
+void ktParserSetOutputMode(ktParser* parser, ktParserOutputMode mode);
+void ktParserSetErrorMode(ktParser* parser, ktParserErrorMode mode);
+void ktParserSetOptimize(ktParser* parser, bool isOptimizing);
+void ktParserRun(ktParser* parser, const char* contents);
+bool ktParserFeed(ktParser* parser, const char* bytes, size_t length);
+void ktParserFinish(ktParser* parser);
+
+size_t ktParserErrorCount(const ktParser* parser);
+const ktParserError* ktParserErrorGet(const ktParser* parser, size_t index);
+void ktParserClearErrors(ktParser* parser);
+void ktParserErrorFormat(const ktParserError* error, const char* contents, char* buffer, size_t size);
 
 #endif // __KISHITECH_PARSER_H__
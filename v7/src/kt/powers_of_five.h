@@ -14,30 +14,24 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
-#ifndef __KISHITECH__TOKEN_NODE_H__
-#define __KISHITECH__TOKEN_NODE_H__
+#ifndef __KISHITECH_POWERS_OF_FIVE_H__
+#define __KISHITECH_POWERS_OF_FIVE_H__
 
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include "token.h"
+#include <stdint.h>
 
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
-typedef struct ktTokenNode ktTokenNode;
-
-struct ktTokenNode
+enum ktPowersOfFiveConstants
 {
-	ktToken* token;
-	ktTokenNode* previous;
-	ktTokenNode* next;
+	KT_POWERS_OF_FIVE_MIN_EXPONENT = -342,
+	KT_POWERS_OF_FIVE_MAX_EXPONENT = 308,
+	KT_POWERS_OF_FIVE_COUNT = KT_POWERS_OF_FIVE_MAX_EXPONENT - KT_POWERS_OF_FIVE_MIN_EXPONENT + 1,
 };
 
-//------------------------------------------------------------------------------
-// Function definitions
-//------------------------------------------------------------------------------
-ktTokenNode* ktTokenNodeCreate(ktToken* token);
-void ktTokenNodeDestroy(ktTokenNode* node);
+extern const uint64_t KT_POWERS_OF_FIVE[KT_POWERS_OF_FIVE_COUNT][2];
 
-#endif // __KISHITECH__TOKEN_NODE_H__
+#endif // __KISHITECH_POWERS_OF_FIVE_H__
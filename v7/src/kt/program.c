@@ -0,0 +1,575 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "program.h"
+#include "alloc.h"
+#include "jit.h"
+#include "parser.h"
+#include "register_vm.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktCompileState ktCompileState;
+
+struct ktCompileState
+{
+	ktProgram* program;
+	bool hasError;
+};
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+const char* const KT_OPCODE_STR[] =
+{
+#define X_MACRO(name) #name,
+	KT_OPCODE_LIST
+#undef X_MACRO
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool grow(ktProgram* program);
+static ktErrorType evaluateStack(const ktProgram* program, const ktMemory* memory, double* stack, double* out_result);
+
+static void onLetStmt(int errorCode, char variable, double value, void* userData);
+static void onErrorCode(int errorCode, void* userData);
+static void onNoArgs(void* userData);
+static void onVar(int errorCode, char variable, void* userData);
+static void onNumber(int errorCode, double number, void* userData);
+static void onSymbol(int errorCode, char symbol, void* userData);
+static void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData);
+
+#if _DEBUG_RPN
+static void onRpnStmt(int errorCode, void* userData);
+#endif // #if _DEBUG_RPN
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktProgram* ktProgramCreate(void)
+{
+	ktProgram* program = ktAlloc(sizeof(ktProgram));
+	if (program)
+	{
+		program->code = NULL;
+		program->count = 0;
+		program->capacity = 0;
+		program->depth = 0;
+		program->stackSize = 0;
+		program->registerCode = NULL;
+		program->registerCount = 0;
+		program->registerFileSize = 0;
+		program->hasRegisters = false;
+		program->jitCode = NULL;
+		program->jitSize = 0;
+		program->jitEntry = 0;
+		program->hasJit = false;
+	}
+
+	return program;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktProgramDestroy(ktProgram* program)
+{
+	if (program)
+	{
+		SAFE_DELETE(program->code);
+		SAFE_DELETE(program->registerCode);
+		ktProgramFreeJit(program);
+		SAFE_DELETE(program);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Also keeps track of the operand stack depth, so the program knows how much
+// stack it needs once the last instruction is in.
+//------------------------------------------------------------------------------
+bool ktProgramAppend(ktProgram* program, ktOpcode opcode, unsigned char slot)
+{
+	if (!program)
+		return false;
+
+	if (program->count == program->capacity && !grow(program))
+		return false;
+
+	ktInstruction* instruction = &program->code[program->count++];
+	instruction->opcode = (unsigned char)opcode;
+	instruction->slot = slot;
+	instruction->number = 0.0;
+	program->hasRegisters = false;
+	program->hasJit = false;
+
+	switch (opcode)
+	{
+	case KT_OP_LOAD_VAR:
+	case KT_OP_LOAD_CONST:
+		++program->depth;
+		break;
+
+	case KT_OP_NEG:
+	case KT_OP_SQRT:
+	case KT_OP_SQUARE:
+	case KT_OP_CUBE:
+	case KT_OP_RECIPROCAL:
+		break;
+
+	default:
+		--program->depth;
+		break;
+	}
+
+	if (program->depth > program->stackSize)
+	{
+		program->stackSize = program->depth;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool ktProgramAppendConst(ktProgram* program, double number)
+{
+	if (!ktProgramAppend(program, KT_OP_LOAD_CONST, 0))
+		return false;
+
+	program->code[program->count - 1].number = number;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// O(1), keeps the capacity for the next expression.
+//------------------------------------------------------------------------------
+void ktProgramReset(ktProgram* program)
+{
+	if (!program)
+		return;
+
+	program->count = 0;
+	program->depth = 0;
+	program->stackSize = 0;
+	program->hasRegisters = false;
+	program->hasJit = false;
+}
+
+//------------------------------------------------------------------------------
+// The copy's capacity is exactly what the instructions need.
+//------------------------------------------------------------------------------
+ktProgram* ktProgramCopy(const ktProgram* program)
+{
+	ktProgram* copy = ktProgramCreate();
+	if (!copy || !program || program->count == 0)
+		return copy;
+
+	copy->code = ktAlloc(program->count * sizeof(ktInstruction));
+	if (!copy->code)
+	{
+		ktProgramDestroy(copy);
+		return NULL;
+	}
+
+	memcpy(copy->code, program->code, program->count * sizeof(ktInstruction));
+	copy->count = program->count;
+	copy->capacity = program->count;
+	copy->depth = program->depth;
+	copy->stackSize = program->stackSize;
+
+	if (program->hasRegisters)
+	{
+		copy->registerCode = ktAlloc(program->registerCount * sizeof(ktRegisterInstruction));
+		if (!copy->registerCode)
+		{
+			ktProgramDestroy(copy);
+			return NULL;
+		}
+
+		memcpy(copy->registerCode, program->registerCode, program->registerCount * sizeof(ktRegisterInstruction));
+		copy->registerCount = program->registerCount;
+		copy->registerFileSize = program->registerFileSize;
+		copy->hasRegisters = true;
+	}
+
+	return copy;
+}
+
+//------------------------------------------------------------------------------
+// Compiles source, which must hold exactly one expression statement (e.g.
+// "A * (B + C)"). Returns NULL for anything else. The program is meant to be
+// evaluated many times, so it gets its register form too. Native code costs
+// a page per program, so it is up to the caller (ktProgramCompileJit()).
+//------------------------------------------------------------------------------
+ktProgram* ktCompile(const char* source)
+{
+	ktParserCallback callback =
+	{
+		.letStmt = onLetStmt,
+		.resetStmt = onErrorCode,
+		.varsStmt = onErrorCode,
+		.clearStmt = onNoArgs,
+		.exitStmt = onNoArgs,
+		.exprStmtBegin = onErrorCode,
+		.exprStmtEnd = onErrorCode,
+		.var = onVar,
+		.number = onNumber,
+		.symbol = onSymbol,
+		.error = NULL,
+		.exprStmtAst = NULL,
+		.exprStmtProgram = onExprStmtProgram,
+		.eventBatch = NULL,
+		.errorRecord = NULL,
+
+#if _DEBUG_RPN
+		.rpnStmt = onRpnStmt,
+#endif // #if _DEBUG_RPN
+	};
+
+	ktCompileState state =
+	{
+		.program = NULL,
+		.hasError = false
+	};
+
+	ktParser* parser = ktParserCreate(&callback, &state);
+	if (!parser)
+		return NULL;
+
+	// The errors are only counted, so they are never formatted.
+	ktParserSetOutputMode(parser, KT_PARSER_OUTPUT_MODE_PROGRAM);
+	ktParserSetErrorMode(parser, KT_PARSER_ERROR_MODE_COLLECT);
+	ktParserRun(parser, source);
+	if (ktParserErrorCount(parser) > 0)
+	{
+		state.hasError = true;
+	}
+	ktParserDestroy(parser);
+
+	if (state.hasError || !ktProgramCompileRegisters(state.program))
+	{
+		ktProgramDestroy(state.program);
+		return NULL;
+	}
+
+	return state.program;
+}
+
+//------------------------------------------------------------------------------
+// Runs the native code if the program has it, then the register form, then
+// the stack code. All give the same results and errors.
+//------------------------------------------------------------------------------
+ktErrorType ktEvaluate(const ktProgram* program, const ktMemory* memory, double* out_result)
+{
+	if (program->hasJit)
+		return ktEvaluateJit(program, memory, out_result);
+
+	if (program->hasRegisters)
+		return ktEvaluateRegisters(program, memory, out_result);
+
+	return ktEvaluateStack(program, memory, out_result);
+}
+
+//------------------------------------------------------------------------------
+// The operand stack has exactly the stackSize slots the program worked out as
+// it was built: a local array for most programs (nothing is allocated), the
+// heap for deeper ones, so there is no limit on how deep an expression goes.
+//------------------------------------------------------------------------------
+ktErrorType ktEvaluateStack(const ktProgram* program, const ktMemory* memory, double* out_result)
+{
+	if (program->stackSize <= KT_PROGRAM_LOCAL_STACK_SIZE)
+	{
+		double stack[KT_PROGRAM_LOCAL_STACK_SIZE];
+		return evaluateStack(program, memory, stack, out_result);
+	}
+
+	double* stack = ktAlloc(program->stackSize * sizeof(double));
+	if (!stack)
+		return KT_ERROR_INTERPRETER_EXPR_STMT_BUFFER_OVERFLOW;
+
+	ktErrorType error = evaluateStack(program, memory, stack, out_result);
+	SAFE_DELETE(stack);
+
+	return error;
+}
+
+//------------------------------------------------------------------------------
+// stack is big enough for the program, and the parser only hands out complete
+// expressions, so no instruction checks it for overflow or underflow.
+//------------------------------------------------------------------------------
+ktErrorType evaluateStack(const ktProgram* program, const ktMemory* memory, double* stack, double* out_result)
+{
+	size_t top = 0;
+
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		const ktInstruction* instruction = &program->code[i];
+		switch (instruction->opcode)
+		{
+		case KT_OP_LOAD_VAR:
+			if (!memory->hasValue[instruction->slot])
+				return KT_ERROR_INTERPRETER_EXPR_STMT_VAR_NOT_SET;
+
+			stack[top++] = memory->vars[instruction->slot];
+			break;
+
+		case KT_OP_LOAD_CONST:
+			stack[top++] = instruction->number;
+			break;
+
+		case KT_OP_NEG:
+			stack[top - 1] = -stack[top - 1];
+			break;
+
+		case KT_OP_SQRT:
+			stack[top - 1] = ktPowHalf(stack[top - 1]);
+			break;
+
+		case KT_OP_SQUARE:
+			stack[top - 1] = stack[top - 1] * stack[top - 1];
+			break;
+
+		case KT_OP_CUBE:
+			stack[top - 1] = stack[top - 1] * stack[top - 1] * stack[top - 1];
+			break;
+
+		case KT_OP_RECIPROCAL:
+			stack[top - 1] = 1.0 / stack[top - 1];
+			break;
+
+		case KT_OP_ADD:
+			--top;
+			stack[top - 1] += stack[top];
+			break;
+
+		case KT_OP_SUB:
+			--top;
+			stack[top - 1] -= stack[top];
+			break;
+
+		case KT_OP_MUL:
+			--top;
+			stack[top - 1] *= stack[top];
+			break;
+
+		case KT_OP_DIV:
+			--top;
+			if (fabs(stack[top]) < DBL_EPSILON)
+				return KT_ERROR_INTERPRETER_EXPR_STMT_DIV_BY_ZERO;
+
+			stack[top - 1] /= stack[top];
+			break;
+
+		case KT_OP_POW:
+			--top;
+			stack[top - 1] = ktPow(stack[top - 1], stack[top]);
+			break;
+		}
+	}
+
+	// Which NaN comes out of an operation depends on its operand order, which
+	// the compiler may swap: report them all as NAN, whatever the evaluator.
+	*out_result = isnan(stack[0]) ? NAN : stack[0];
+
+	return KT_ERROR_NONE;
+}
+
+//------------------------------------------------------------------------------
+// x ^ y for KT_OP_POW. The integral exponents that a multiply chain (or a
+// reciprocal) gets within one ulp of pow() skip libm: x ^ 2 and 1 / x are
+// correctly rounded, x * x * x is at most one ulp from pow(). Higher powers by
+// squaring drift further (two ulps and more for x ^ 4 and x ^ -2), so they
+// still call pow(). KT_OP_SQUARE, KT_OP_CUBE and KT_OP_RECIPROCAL compute the
+// same expressions, so a constant exponent gives the same result either way.
+//------------------------------------------------------------------------------
+double ktPow(double x, double y)
+{
+	if (y == 2.0)
+		return x * x;
+
+	if (y == 3.0)
+		return x * x * x;
+
+	if (y == -1.0)
+		return 1.0 / x;
+
+	return pow(x, y);
+}
+
+//------------------------------------------------------------------------------
+// x ^ 0.5 for KT_OP_SQRT: sqrt(), which is correctly rounded (pow() may be one
+// ulp off), with pow()'s results where they differ (+0 for -0, +inf for -inf).
+//------------------------------------------------------------------------------
+double ktPowHalf(double x)
+{
+	if (x > 0.0 && x < INFINITY)
+		return sqrt(x);
+
+	return pow(x, 0.5);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktProgramPrint(const ktProgram* program)
+{
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		const ktInstruction* instruction = &program->code[i];
+		if (instruction->opcode == KT_OP_LOAD_VAR)
+		{
+			printf("%zu: %s %c\n", i, KT_OPCODE_STR[instruction->opcode], (char)(instruction->slot + 'A'));
+		}
+		else if (instruction->opcode == KT_OP_LOAD_CONST)
+		{
+			printf("%zu: %s %.17g\n", i, KT_OPCODE_STR[instruction->opcode], instruction->number);
+		}
+		else
+		{
+			printf("%zu: %s\n", i, KT_OPCODE_STR[instruction->opcode]);
+		}
+	}
+
+	for (size_t i = 0; program->hasRegisters && i < program->registerCount; ++i)
+	{
+		const ktRegisterInstruction* instruction = &program->registerCode[i];
+		printf("r%zu: %s %u, %u, %u\n", i, KT_REGISTER_OPCODE_STR[instruction->opcode], instruction->dst, instruction->a, instruction->b);
+	}
+
+	if (program->hasJit)
+	{
+		printf("jit: %zu bytes\n", program->jitSize);
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool grow(ktProgram* program)
+{
+	size_t capacity = program->capacity > 0 ? program->capacity * 2 : KT_PROGRAM_INITIAL_CAPACITY;
+	ktInstruction* code = ktRealloc(program->code, capacity * sizeof(ktInstruction));
+	if (!code)
+		return false;
+
+	program->code = code;
+	program->capacity = capacity;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Only a single expression statement compiles: any other statement or error
+// fails ktCompile().
+//------------------------------------------------------------------------------
+void onLetStmt(int errorCode, char variable, double value, void* userData)
+{
+	(void)errorCode;
+	(void)variable;
+	(void)value;
+	((ktCompileState*)userData)->hasError = true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onErrorCode(int errorCode, void* userData)
+{
+	(void)errorCode;
+	((ktCompileState*)userData)->hasError = true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onNoArgs(void* userData)
+{
+	((ktCompileState*)userData)->hasError = true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onVar(int errorCode, char variable, void* userData)
+{
+	(void)errorCode;
+	(void)variable;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onNumber(int errorCode, double number, void* userData)
+{
+	(void)errorCode;
+	(void)number;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onSymbol(int errorCode, char symbol, void* userData)
+{
+	(void)errorCode;
+	(void)symbol;
+	(void)userData;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onExprStmtProgram(int errorCode, const ktProgram* program, void* userData)
+{
+	ktCompileState* state = userData;
+	if (errorCode || state->program)
+	{
+		state->hasError = true;
+		return;
+	}
+
+	// The parser reuses its program for the next statement.
+	state->program = ktProgramCopy(program);
+	if (!state->program)
+	{
+		state->hasError = true;
+	}
+}
+
+#if _DEBUG_RPN
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void onRpnStmt(int errorCode, void* userData)
+{
+	(void)errorCode;
+	((ktCompileState*)userData)->hasError = true;
+}
+#endif // #if _DEBUG_RPN
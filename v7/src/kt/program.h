@@ -0,0 +1,132 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_PROGRAM_H__
+#define __KISHITECH_PROGRAM_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include "error_type.h"
+#include "memory.h"
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_OPCODE_LIST \
+	X_MACRO(KT_OP_LOAD_VAR) \
+	X_MACRO(KT_OP_LOAD_CONST) \
+	X_MACRO(KT_OP_NEG) \
+	X_MACRO(KT_OP_SQRT) \
+	X_MACRO(KT_OP_SQUARE) \
+	X_MACRO(KT_OP_CUBE) \
+	X_MACRO(KT_OP_RECIPROCAL) \
+	X_MACRO(KT_OP_ADD) \
+	X_MACRO(KT_OP_SUB) \
+	X_MACRO(KT_OP_MUL) \
+	X_MACRO(KT_OP_DIV) \
+	X_MACRO(KT_OP_POW)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktInstruction ktInstruction;
+typedef struct ktRegisterInstruction ktRegisterInstruction;
+typedef struct ktProgram ktProgram;
+
+enum ktOpcode
+{
+#define X_MACRO(name) name,
+	KT_OPCODE_LIST
+#undef X_MACRO
+};
+
+typedef enum ktOpcode ktOpcode;
+
+enum ktProgramConstants
+{
+	KT_PROGRAM_INITIAL_CAPACITY = 64,
+
+	// ktEvaluate() keeps the operand stack of programs up to this deep in a
+	// local array; deeper ones get theirs from the heap.
+	KT_PROGRAM_LOCAL_STACK_SIZE = 256,
+};
+
+// slot is the variable of KT_OP_LOAD_VAR, number the value of
+// KT_OP_LOAD_CONST. KT_OP_SQRT, KT_OP_SQUARE, KT_OP_CUBE and KT_OP_RECIPROCAL
+// are x ^ 0.5, x ^ 2, x ^ 3 and x ^ -1 (see ktProgramOptimize()).
+struct ktInstruction
+{
+	unsigned char opcode;
+	unsigned char slot;
+	double number;
+};
+
+// A compiled expression: stack machine instructions in postfix order, emitted
+// by the parser (KT_PARSER_OUTPUT_MODE_PROGRAM) as it reads the expression,
+// and optionally the same expression as register machine instructions.
+// A program returned by ktCompile() is never modified afterwards, so it can
+// be evaluated by many threads at the same time (each with its own ktMemory,
+// or a shared read-only one).
+struct ktProgram
+{
+	ktInstruction* code;
+	size_t count;
+	size_t capacity;
+
+	// Operand stack depth after the last instruction, and the largest depth
+	// reached so far (what ktEvaluate() needs).
+	size_t depth;
+	size_t stackSize;
+
+	// Register form of a complete program (ktProgramCompileRegisters()),
+	// which ktEvaluate() runs instead of the stack code. registerFileSize is
+	// how many registers it uses. Appending or resetting drops it.
+	ktRegisterInstruction* registerCode;
+	size_t registerCount;
+	size_t registerFileSize;
+	bool hasRegisters;
+
+	// Native code for the whole program, only if the caller asked for it
+	// (ktProgramCompileJit()): jitSize bytes mapped at jitCode, entered at
+	// jitEntry. Appending or resetting drops it, and copies don't have it.
+	void* jitCode;
+	size_t jitSize;
+	size_t jitEntry;
+	bool hasJit;
+};
+
+extern const char* const KT_OPCODE_STR[];
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktProgram* ktProgramCreate(void);
+void ktProgramDestroy(ktProgram* program);
+bool ktProgramAppend(ktProgram* program, ktOpcode opcode, unsigned char slot);
+bool ktProgramAppendConst(ktProgram* program, double number);
+void ktProgramReset(ktProgram* program);
+ktProgram* ktProgramCopy(const ktProgram* program);
+ktProgram* ktCompile(const char* source);
+ktErrorType ktEvaluate(const ktProgram* program, const ktMemory* memory, double* out_result);
+ktErrorType ktEvaluateStack(const ktProgram* program, const ktMemory* memory, double* out_result);
+double ktPow(double x, double y);
+double ktPowHalf(double x);
+void ktProgramPrint(const ktProgram* program);
+
+#endif // __KISHITECH_PROGRAM_H__
@@ -0,0 +1,286 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <float.h>
+#include <math.h>
+#include "register_vm.h"
+#include "alloc.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_NO_REGISTER	((unsigned int)-1)
+
+//------------------------------------------------------------------------------
+// Globals (argh!)
+//------------------------------------------------------------------------------
+const char* const KT_REGISTER_OPCODE_STR[] =
+{
+#define X_MACRO(name) #name,
+	KT_REGISTER_OPCODE_LIST
+#undef X_MACRO
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static ktErrorType evaluateRegisters(const ktProgram* program, const ktMemory* memory, double* registers, double* out_result);
+static void emit(ktRegisterInstruction* code, size_t* count, ktRegisterOpcode opcode, unsigned int dst, unsigned int a, unsigned int b);
+
+//------------------------------------------------------------------------------
+// Translates the stack code of a complete program into three-address code.
+// Each variable gets a register of its own, loaded once by a prologue at the
+// start; the operand stack slot i becomes register variableCount + i. A
+// KT_OP_LOAD_VAR then only pushes its variable's register, and a
+// KT_OP_LOAD_CONST becomes a KT_REG_OP_LOAD_CONST into the register of the
+// current stack slot, in place. The instructions run in the same order (and
+// round the same way) as the stack code. Returns false (the program keeps
+// only its stack code) if it isn't complete or out of memory.
+//------------------------------------------------------------------------------
+bool ktProgramCompileRegisters(ktProgram* program)
+{
+	if (!program || program->count == 0 || program->depth != 1)
+		return false;
+
+	unsigned int variableRegister[KT_VAR_COUNT];
+	unsigned int variableCount = 0;
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		variableRegister[i] = KT_NO_REGISTER;
+	}
+
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		const ktInstruction* instruction = &program->code[i];
+		if (instruction->opcode == KT_OP_LOAD_VAR && variableRegister[instruction->slot] == KT_NO_REGISTER)
+		{
+			variableRegister[instruction->slot] = variableCount++;
+		}
+	}
+
+	// At most one load per variable, one instruction per operator, and the
+	// return.
+	ktRegisterInstruction* code = ktAlloc((variableCount + program->count + 1) * sizeof(ktRegisterInstruction));
+	unsigned int* stack = ktAlloc(program->stackSize * sizeof(unsigned int));
+	if (!code || !stack)
+	{
+		SAFE_DELETE(code);
+		SAFE_DELETE(stack);
+		return false;
+	}
+
+	size_t count = 0;
+	for (size_t i = 0; i < KT_VAR_COUNT; ++i)
+	{
+		if (variableRegister[i] != KT_NO_REGISTER)
+		{
+			emit(code, &count, KT_REG_OP_LOAD_VAR, variableRegister[i], (unsigned int)i, 0);
+		}
+	}
+
+	size_t top = 0;
+	for (size_t i = 0; i < program->count; ++i)
+	{
+		const ktInstruction* instruction = &program->code[i];
+		unsigned int dst = variableCount + (unsigned int)(top - 1);
+
+		switch (instruction->opcode)
+		{
+		case KT_OP_LOAD_VAR:
+			stack[top++] = variableRegister[instruction->slot];
+			break;
+
+		case KT_OP_LOAD_CONST:
+			dst = variableCount + (unsigned int)top;
+			emit(code, &count, KT_REG_OP_LOAD_CONST, dst, (unsigned int)i, 0);
+			stack[top++] = dst;
+			break;
+
+		case KT_OP_NEG:
+		case KT_OP_SQRT:
+		case KT_OP_SQUARE:
+		case KT_OP_CUBE:
+		case KT_OP_RECIPROCAL:
+		{
+			// Same order in both opcode lists.
+			ktRegisterOpcode opcode = KT_REG_OP_NEG + (instruction->opcode - KT_OP_NEG);
+			emit(code, &count, opcode, dst, stack[top - 1], 0);
+			stack[top - 1] = dst;
+			break;
+		}
+
+		default:
+		{
+			// The result goes to the left operand's slot.
+			ktRegisterOpcode opcode = KT_REG_OP_ADD + (instruction->opcode - KT_OP_ADD);
+			--top;
+			dst = variableCount + (unsigned int)(top - 1);
+			emit(code, &count, opcode, dst, stack[top - 1], stack[top]);
+			stack[top - 1] = dst;
+			break;
+		}
+		}
+	}
+
+	emit(code, &count, KT_REG_OP_RETURN, 0, stack[0], 0);
+	SAFE_DELETE(stack);
+
+	SAFE_DELETE(program->registerCode);
+	program->registerCode = code;
+	program->registerCount = count;
+	program->registerFileSize = variableCount + program->stackSize;
+	program->hasRegisters = true;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// The register file is a local array, or comes from the heap for programs
+// deeper than KT_PROGRAM_LOCAL_STACK_SIZE (like ktEvaluateStack()'s stack).
+//------------------------------------------------------------------------------
+ktErrorType ktEvaluateRegisters(const ktProgram* program, const ktMemory* memory, double* out_result)
+{
+	if (program->registerFileSize <= KT_VAR_COUNT + KT_PROGRAM_LOCAL_STACK_SIZE)
+	{
+		double registers[KT_VAR_COUNT + KT_PROGRAM_LOCAL_STACK_SIZE];
+		return evaluateRegisters(program, memory, registers, out_result);
+	}
+
+	double* registers = ktAlloc(program->registerFileSize * sizeof(double));
+	if (!registers)
+		return KT_ERROR_INTERPRETER_EXPR_STMT_BUFFER_OVERFLOW;
+
+	ktErrorType error = evaluateRegisters(program, memory, registers, out_result);
+	SAFE_DELETE(registers);
+
+	return error;
+}
+
+//------------------------------------------------------------------------------
+// registers has the program's registerFileSize. If a variable has no value,
+// the stack code is run instead, so the error is the same one
+// ktEvaluateStack() finds first (e.g. a division by zero before it).
+//------------------------------------------------------------------------------
+ktErrorType evaluateRegisters(const ktProgram* program, const ktMemory* memory, double* registers, double* out_result)
+{
+	const ktRegisterInstruction* ip = program->registerCode;
+
+#if KT_REGISTER_VM_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+	static void* const LABELS[] =
+	{
+#define X_MACRO(name) &&label_##name,
+		KT_REGISTER_OPCODE_LIST
+#undef X_MACRO
+	};
+
+#define CASE(name)	label_##name:
+#define NEXT()		++ip; goto *LABELS[ip->opcode]
+
+	goto *LABELS[ip->opcode];
+#else
+#define CASE(name)	case name:
+#define NEXT()		++ip; continue
+
+	for (;;) switch (ip->opcode)
+#endif // #if KT_REGISTER_VM_COMPUTED_GOTO
+	{
+	CASE(KT_REG_OP_LOAD_VAR)
+		if (!memory->hasValue[ip->a])
+			return ktEvaluateStack(program, memory, out_result);
+
+		registers[ip->dst] = memory->vars[ip->a];
+		NEXT();
+
+	CASE(KT_REG_OP_LOAD_CONST)
+		registers[ip->dst] = program->code[ip->a].number;
+		NEXT();
+
+	CASE(KT_REG_OP_NEG)
+		registers[ip->dst] = -registers[ip->a];
+		NEXT();
+
+	CASE(KT_REG_OP_SQRT)
+		registers[ip->dst] = ktPowHalf(registers[ip->a]);
+		NEXT();
+
+	CASE(KT_REG_OP_SQUARE)
+		registers[ip->dst] = registers[ip->a] * registers[ip->a];
+		NEXT();
+
+	CASE(KT_REG_OP_CUBE)
+		registers[ip->dst] = registers[ip->a] * registers[ip->a] * registers[ip->a];
+		NEXT();
+
+	CASE(KT_REG_OP_RECIPROCAL)
+		registers[ip->dst] = 1.0 / registers[ip->a];
+		NEXT();
+
+	CASE(KT_REG_OP_ADD)
+		registers[ip->dst] = registers[ip->a] + registers[ip->b];
+		NEXT();
+
+	CASE(KT_REG_OP_SUB)
+		registers[ip->dst] = registers[ip->a] - registers[ip->b];
+		NEXT();
+
+	CASE(KT_REG_OP_MUL)
+		registers[ip->dst] = registers[ip->a] * registers[ip->b];
+		NEXT();
+
+	CASE(KT_REG_OP_DIV)
+		if (fabs(registers[ip->b]) < DBL_EPSILON)
+			return KT_ERROR_INTERPRETER_EXPR_STMT_DIV_BY_ZERO;
+
+		registers[ip->dst] = registers[ip->a] / registers[ip->b];
+		NEXT();
+
+	CASE(KT_REG_OP_POW)
+		registers[ip->dst] = ktPow(registers[ip->a], registers[ip->b]);
+		NEXT();
+
+	CASE(KT_REG_OP_RETURN)
+		// Same NaN as ktEvaluateStack().
+		*out_result = isnan(registers[ip->a]) ? NAN : registers[ip->a];
+		return KT_ERROR_NONE;
+	}
+
+#undef CASE
+#undef NEXT
+
+#if KT_REGISTER_VM_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#else
+	return KT_ERROR_NONE;
+#endif // #if KT_REGISTER_VM_COMPUTED_GOTO
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void emit(ktRegisterInstruction* code, size_t* count, ktRegisterOpcode opcode, unsigned int dst, unsigned int a, unsigned int b)
+{
+	ktRegisterInstruction* instruction = &code[(*count)++];
+	instruction->opcode = (unsigned int)opcode;
+	instruction->dst = dst;
+	instruction->a = a;
+	instruction->b = b;
+}
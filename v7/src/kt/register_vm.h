@@ -0,0 +1,89 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_REGISTER_VM_H__
+#define __KISHITECH_REGISTER_VM_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include "error_type.h"
+#include "memory.h"
+#include "program.h"
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_REGISTER_OPCODE_LIST \
+	X_MACRO(KT_REG_OP_LOAD_VAR) \
+	X_MACRO(KT_REG_OP_LOAD_CONST) \
+	X_MACRO(KT_REG_OP_NEG) \
+	X_MACRO(KT_REG_OP_SQRT) \
+	X_MACRO(KT_REG_OP_SQUARE) \
+	X_MACRO(KT_REG_OP_CUBE) \
+	X_MACRO(KT_REG_OP_RECIPROCAL) \
+	X_MACRO(KT_REG_OP_ADD) \
+	X_MACRO(KT_REG_OP_SUB) \
+	X_MACRO(KT_REG_OP_MUL) \
+	X_MACRO(KT_REG_OP_DIV) \
+	X_MACRO(KT_REG_OP_POW) \
+	X_MACRO(KT_REG_OP_RETURN)
+
+// GCC and Clang dispatch with computed goto (one indirect jump per
+// instruction, each with its own branch history); other compilers with a
+// switch in a loop. -DKT_REGISTER_VM_COMPUTED_GOTO=0 forces the switch.
+#if !defined(KT_REGISTER_VM_COMPUTED_GOTO)
+#if defined(__GNUC__) || defined(__clang__)
+#define KT_REGISTER_VM_COMPUTED_GOTO 1
+#else
+#define KT_REGISTER_VM_COMPUTED_GOTO 0
+#endif
+#endif // #if !defined(KT_REGISTER_VM_COMPUTED_GOTO)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+enum ktRegisterOpcode
+{
+#define X_MACRO(name) name,
+	KT_REGISTER_OPCODE_LIST
+#undef X_MACRO
+};
+
+typedef enum ktRegisterOpcode ktRegisterOpcode;
+
+// Three-address instruction: registers[dst] = registers[a] op registers[b].
+// KT_REG_OP_LOAD_VAR loads variable a into dst, KT_REG_OP_LOAD_CONST the
+// number of the stack instruction a; KT_REG_OP_RETURN returns registers[a].
+struct ktRegisterInstruction
+{
+	unsigned int opcode;
+	unsigned int dst;
+	unsigned int a;
+	unsigned int b;
+};
+
+extern const char* const KT_REGISTER_OPCODE_STR[];
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+bool ktProgramCompileRegisters(ktProgram* program);
+ktErrorType ktEvaluateRegisters(const ktProgram* program, const ktMemory* memory, double* out_result);
+
+#endif // __KISHITECH_REGISTER_VM_H__
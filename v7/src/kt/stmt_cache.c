@@ -0,0 +1,308 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <string.h>
+#include "stmt_cache.h"
+#include "alloc.h"
+#include "register_vm.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static uint64_t hashText(const char* text, size_t length);
+static size_t find(const ktStmtCache* cache, uint64_t hash, const char* text, size_t length);
+static void detach(ktStmtCache* cache, size_t index);
+static void pushFront(ktStmtCache* cache, size_t index);
+static void unchain(ktStmtCache* cache, size_t index);
+static void release(ktStmtCacheEntry* entry);
+
+//------------------------------------------------------------------------------
+// There are at least as many buckets as entries (a power of two).
+//------------------------------------------------------------------------------
+ktStmtCache* ktStmtCacheCreate(size_t capacity)
+{
+	if (capacity == 0)
+		return NULL;
+
+	size_t bucketCount = 1;
+	while (bucketCount < capacity)
+	{
+		bucketCount *= 2;
+	}
+
+	ktStmtCache* cache = ktAlloc(sizeof(ktStmtCache));
+	if (!cache)
+		return NULL;
+
+	cache->entries = ktAlloc(capacity * sizeof(ktStmtCacheEntry));
+	cache->buckets = ktAlloc(bucketCount * sizeof(size_t));
+	if (!cache->entries || !cache->buckets)
+	{
+		SAFE_DELETE(cache->entries);
+		SAFE_DELETE(cache->buckets);
+		SAFE_DELETE(cache);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < bucketCount; ++i)
+	{
+		cache->buckets[i] = KT_STMT_CACHE_NONE;
+	}
+
+	cache->bucketMask = bucketCount - 1;
+	cache->capacity = capacity;
+	cache->count = 0;
+	cache->head = KT_STMT_CACHE_NONE;
+	cache->tail = KT_STMT_CACHE_NONE;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+
+	return cache;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktStmtCacheDestroy(ktStmtCache* cache)
+{
+	if (cache)
+	{
+		ktStmtCacheClear(cache);
+		SAFE_DELETE(cache->entries);
+		SAFE_DELETE(cache->buckets);
+		SAFE_DELETE(cache);
+	}
+}
+
+//------------------------------------------------------------------------------
+// A hit makes the entry the most recently used one. The program stays owned by
+// the cache and is valid until the next ktStmtCachePut() or ktStmtCacheClear().
+//------------------------------------------------------------------------------
+const ktProgram* ktStmtCacheGet(ktStmtCache* cache, const char* text, size_t length)
+{
+	if (!cache)
+		return NULL;
+
+	size_t index = find(cache, hashText(text, length), text, length);
+	if (index == KT_STMT_CACHE_NONE)
+	{
+		++cache->misses;
+		return NULL;
+	}
+
+	++cache->hits;
+
+	if (index != cache->head)
+	{
+		detach(cache, index);
+		pushFront(cache, index);
+	}
+
+	return cache->entries[index].program;
+}
+
+//------------------------------------------------------------------------------
+// Stores copies of text and program, evicting the least recently used entry if
+// the cache is full. Returns false (cache unchanged) if the copies can't be
+// allocated.
+//------------------------------------------------------------------------------
+bool ktStmtCachePut(ktStmtCache* cache, const char* text, size_t length, const ktProgram* program)
+{
+	if (!cache || !program)
+		return false;
+
+	char* textCopy = ktAlloc(length > 0 ? length : 1);
+	ktProgram* programCopy = ktProgramCopy(program);
+	if (!textCopy || !programCopy)
+	{
+		SAFE_DELETE(textCopy);
+		ktProgramDestroy(programCopy);
+		return false;
+	}
+
+	// Cached programs are evaluated again and again: worth their register
+	// form (without it, they still run as stack code).
+	ktProgramCompileRegisters(programCopy);
+
+	memcpy(textCopy, text, length);
+
+	uint64_t hash = hashText(text, length);
+	size_t index = find(cache, hash, text, length);
+	if (index != KT_STMT_CACHE_NONE)
+	{
+		// Same statement: only the program is replaced.
+		detach(cache, index);
+		unchain(cache, index);
+		release(&cache->entries[index]);
+	}
+	else if (cache->count < cache->capacity)
+	{
+		index = cache->count++;
+	}
+	else
+	{
+		index = cache->tail;
+		detach(cache, index);
+		unchain(cache, index);
+		release(&cache->entries[index]);
+		++cache->evictions;
+	}
+
+	ktStmtCacheEntry* entry = &cache->entries[index];
+	entry->hash = hash;
+	entry->text = textCopy;
+	entry->length = length;
+	entry->program = programCopy;
+
+	size_t bucket = hash & cache->bucketMask;
+	entry->chain = cache->buckets[bucket];
+	cache->buckets[bucket] = index;
+	pushFront(cache, index);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Removes every entry; the counters are kept.
+//------------------------------------------------------------------------------
+void ktStmtCacheClear(ktStmtCache* cache)
+{
+	if (!cache)
+		return;
+
+	for (size_t i = 0; i < cache->count; ++i)
+	{
+		release(&cache->entries[i]);
+	}
+
+	for (size_t i = 0; i <= cache->bucketMask; ++i)
+	{
+		cache->buckets[i] = KT_STMT_CACHE_NONE;
+	}
+
+	cache->count = 0;
+	cache->head = KT_STMT_CACHE_NONE;
+	cache->tail = KT_STMT_CACHE_NONE;
+}
+
+//------------------------------------------------------------------------------
+// FNV-1a (64-bit).
+//------------------------------------------------------------------------------
+uint64_t hashText(const char* text, size_t length)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+size_t find(const ktStmtCache* cache, uint64_t hash, const char* text, size_t length)
+{
+	size_t index = cache->buckets[hash & cache->bucketMask];
+	while (index != KT_STMT_CACHE_NONE)
+	{
+		const ktStmtCacheEntry* entry = &cache->entries[index];
+		if (entry->hash == hash && entry->length == length && memcmp(entry->text, text, length) == 0)
+			return index;
+
+		index = entry->chain;
+	}
+
+	return KT_STMT_CACHE_NONE;
+}
+
+//------------------------------------------------------------------------------
+// Takes the entry out of the recently used list.
+//------------------------------------------------------------------------------
+void detach(ktStmtCache* cache, size_t index)
+{
+	ktStmtCacheEntry* entry = &cache->entries[index];
+
+	if (entry->prev != KT_STMT_CACHE_NONE)
+	{
+		cache->entries[entry->prev].next = entry->next;
+	}
+	else
+	{
+		cache->head = entry->next;
+	}
+
+	if (entry->next != KT_STMT_CACHE_NONE)
+	{
+		cache->entries[entry->next].prev = entry->prev;
+	}
+	else
+	{
+		cache->tail = entry->prev;
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void pushFront(ktStmtCache* cache, size_t index)
+{
+	ktStmtCacheEntry* entry = &cache->entries[index];
+	entry->prev = KT_STMT_CACHE_NONE;
+	entry->next = cache->head;
+
+	if (cache->head != KT_STMT_CACHE_NONE)
+	{
+		cache->entries[cache->head].prev = index;
+	}
+	else
+	{
+		cache->tail = index;
+	}
+
+	cache->head = index;
+}
+
+//------------------------------------------------------------------------------
+// Takes the entry out of its bucket.
+//------------------------------------------------------------------------------
+void unchain(ktStmtCache* cache, size_t index)
+{
+	size_t* link = &cache->buckets[cache->entries[index].hash & cache->bucketMask];
+	while (*link != index)
+	{
+		link = &cache->entries[*link].chain;
+	}
+
+	*link = cache->entries[index].chain;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void release(ktStmtCacheEntry* entry)
+{
+	SAFE_DELETE(entry->text);
+	ktProgramDestroy(entry->program);
+	entry->program = NULL;
+}
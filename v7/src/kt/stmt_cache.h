@@ -0,0 +1,84 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_STMT_CACHE_H__
+#define __KISHITECH_STMT_CACHE_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "program.h"
+
+//------------------------------------------------------------------------------
+// Macros
+//------------------------------------------------------------------------------
+#define KT_STMT_CACHE_NONE	((size_t)-1)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktStmtCacheEntry ktStmtCacheEntry;
+typedef struct ktStmtCache ktStmtCache;
+
+struct ktStmtCacheEntry
+{
+	uint64_t hash;
+	char* text;
+	size_t length;
+	ktProgram* program;
+
+	// Neighbours in the recently used list, and the next entry in the same
+	// bucket (KT_STMT_CACHE_NONE if there isn't one).
+	size_t prev;
+	size_t next;
+	size_t chain;
+};
+
+// Bounded map of statement text (already normalized by the caller) to its
+// compiled program. Lookups hash the text and compare it in full, so hash
+// collisions can't return the wrong program. When it is full, the least
+// recently used entry is evicted. The entries are allocated up front; only
+// the text and program copies of new entries touch the heap.
+struct ktStmtCache
+{
+	ktStmtCacheEntry* entries;
+	size_t* buckets;
+	size_t bucketMask;
+	size_t capacity;
+	size_t count;
+
+	// Most and least recently used entries.
+	size_t head;
+	size_t tail;
+
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktStmtCache* ktStmtCacheCreate(size_t capacity);
+void ktStmtCacheDestroy(ktStmtCache* cache);
+const ktProgram* ktStmtCacheGet(ktStmtCache* cache, const char* text, size_t length);
+bool ktStmtCachePut(ktStmtCache* cache, const char* text, size_t length, const ktProgram* program);
+void ktStmtCacheClear(ktStmtCache* cache);
+
+#endif // __KISHITECH_STMT_CACHE_H__
@@ -0,0 +1,247 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "thread_pool.h"
+#include "alloc.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static int worker(void* userData);
+static void stop(ktThreadPool* pool, size_t threadCount);
+
+//------------------------------------------------------------------------------
+// Returns NULL if the threads (or the synchronization objects) can't be
+// created.
+//------------------------------------------------------------------------------
+ktThreadPool* ktThreadPoolCreate(size_t threadCount)
+{
+	if (threadCount == 0)
+		return NULL;
+
+	ktThreadPool* pool = ktAlloc(sizeof(ktThreadPool));
+	if (!pool)
+		return NULL;
+
+	pool->threads = ktAlloc(threadCount * sizeof(thrd_t));
+	pool->threadCount = 0;
+	pool->tasks = NULL;
+	pool->taskHead = 0;
+	pool->taskCount = 0;
+	pool->taskCapacity = 0;
+	pool->pendingCount = 0;
+	pool->isStopping = false;
+
+	if (!pool->threads)
+	{
+		SAFE_DELETE(pool);
+		return NULL;
+	}
+
+	if (mtx_init(&pool->mutex, mtx_plain) != thrd_success)
+	{
+		SAFE_DELETE(pool->threads);
+		SAFE_DELETE(pool);
+		return NULL;
+	}
+
+	if (cnd_init(&pool->hasTask) != thrd_success)
+	{
+		mtx_destroy(&pool->mutex);
+		SAFE_DELETE(pool->threads);
+		SAFE_DELETE(pool);
+		return NULL;
+	}
+
+	if (cnd_init(&pool->isIdle) != thrd_success)
+	{
+		cnd_destroy(&pool->hasTask);
+		mtx_destroy(&pool->mutex);
+		SAFE_DELETE(pool->threads);
+		SAFE_DELETE(pool);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		if (thrd_create(&pool->threads[i], worker, pool) != thrd_success)
+		{
+			stop(pool, i);
+			cnd_destroy(&pool->isIdle);
+			cnd_destroy(&pool->hasTask);
+			mtx_destroy(&pool->mutex);
+			SAFE_DELETE(pool->threads);
+			SAFE_DELETE(pool);
+			return NULL;
+		}
+	}
+
+	pool->threadCount = threadCount;
+
+	return pool;
+}
+
+//------------------------------------------------------------------------------
+// Waits for the tasks already submitted.
+//------------------------------------------------------------------------------
+void ktThreadPoolDestroy(ktThreadPool* pool)
+{
+	if (pool)
+	{
+		ktThreadPoolWait(pool);
+		stop(pool, pool->threadCount);
+		cnd_destroy(&pool->isIdle);
+		cnd_destroy(&pool->hasTask);
+		mtx_destroy(&pool->mutex);
+		SAFE_DELETE(pool->tasks);
+		SAFE_DELETE(pool->threads);
+		SAFE_DELETE(pool);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Returns false (task not submitted) if the queue can't grow.
+//------------------------------------------------------------------------------
+bool ktThreadPoolSubmit(ktThreadPool* pool, void (*run)(void* userData), void* userData)
+{
+	if (!pool || !run)
+		return false;
+
+	mtx_lock(&pool->mutex);
+
+	// The queue is empty: start over from the beginning of the array.
+	if (pool->taskHead == pool->taskCount)
+	{
+		pool->taskHead = 0;
+		pool->taskCount = 0;
+	}
+
+	if (pool->taskCount == pool->taskCapacity)
+	{
+		size_t capacity = pool->taskCapacity > 0 ? pool->taskCapacity * 2 : KT_THREAD_POOL_INITIAL_CAPACITY;
+		ktThreadPoolTask* tasks = ktRealloc(pool->tasks, capacity * sizeof(ktThreadPoolTask));
+		if (!tasks)
+		{
+			mtx_unlock(&pool->mutex);
+			return false;
+		}
+
+		pool->tasks = tasks;
+		pool->taskCapacity = capacity;
+	}
+
+	pool->tasks[pool->taskCount].run = run;
+	pool->tasks[pool->taskCount].userData = userData;
+	++pool->taskCount;
+	++pool->pendingCount;
+
+	cnd_signal(&pool->hasTask);
+	mtx_unlock(&pool->mutex);
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Blocks until every submitted task has run.
+//------------------------------------------------------------------------------
+void ktThreadPoolWait(ktThreadPool* pool)
+{
+	if (!pool)
+		return;
+
+	mtx_lock(&pool->mutex);
+	while (pool->pendingCount > 0)
+	{
+		cnd_wait(&pool->isIdle, &pool->mutex);
+	}
+	mtx_unlock(&pool->mutex);
+}
+
+//------------------------------------------------------------------------------
+// One thread per online processor (1 if that can't be found out).
+//------------------------------------------------------------------------------
+size_t ktThreadPoolDefaultSize(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long count = (long)info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return count > 0 ? (size_t)count : 1;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+int worker(void* userData)
+{
+	ktThreadPool* pool = userData;
+
+	mtx_lock(&pool->mutex);
+	for (;;)
+	{
+		while (pool->taskHead == pool->taskCount && !pool->isStopping)
+		{
+			cnd_wait(&pool->hasTask, &pool->mutex);
+		}
+
+		if (pool->taskHead == pool->taskCount)
+			break;
+
+		ktThreadPoolTask task = pool->tasks[pool->taskHead++];
+		mtx_unlock(&pool->mutex);
+
+		task.run(task.userData);
+
+		mtx_lock(&pool->mutex);
+		if (--pool->pendingCount == 0)
+		{
+			cnd_broadcast(&pool->isIdle);
+		}
+	}
+	mtx_unlock(&pool->mutex);
+
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+// Tells the first threadCount workers to exit (once the queue is empty) and
+// joins them.
+//------------------------------------------------------------------------------
+void stop(ktThreadPool* pool, size_t threadCount)
+{
+	mtx_lock(&pool->mutex);
+	pool->isStopping = true;
+	cnd_broadcast(&pool->hasTask);
+	mtx_unlock(&pool->mutex);
+
+	for (size_t i = 0; i < threadCount; ++i)
+	{
+		thrd_join(pool->threads[i], NULL);
+	}
+}
@@ -0,0 +1,73 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_THREAD_POOL_H__
+#define __KISHITECH_THREAD_POOL_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
+#include <threads.h>
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktThreadPoolTask ktThreadPoolTask;
+typedef struct ktThreadPool ktThreadPool;
+
+enum ktThreadPoolConstants
+{
+	KT_THREAD_POOL_INITIAL_CAPACITY = 16,
+};
+
+struct ktThreadPoolTask
+{
+	void (*run)(void* userData);
+	void* userData;
+};
+
+// Fixed number of worker threads running tasks from a single queue (tasks
+// run in any order, on any worker). tasks[taskHead, taskCount) are waiting to
+// run; pendingCount also counts the ones that are running.
+struct ktThreadPool
+{
+	thrd_t* threads;
+	size_t threadCount;
+
+	ktThreadPoolTask* tasks;
+	size_t taskHead;
+	size_t taskCount;
+	size_t taskCapacity;
+	size_t pendingCount;
+	bool isStopping;
+
+	mtx_t mutex;
+	cnd_t hasTask;
+	cnd_t isIdle;
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktThreadPool* ktThreadPoolCreate(size_t threadCount);
+void ktThreadPoolDestroy(ktThreadPool* pool);
+bool ktThreadPoolSubmit(ktThreadPool* pool, void (*run)(void* userData), void* userData);
+void ktThreadPoolWait(ktThreadPool* pool);
+size_t ktThreadPoolDefaultSize(void);
+
+#endif // __KISHITECH_THREAD_POOL_H__
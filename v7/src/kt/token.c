@@ -14,27 +14,32 @@
 // limitations under the License.
 //------------------------------------------------------------------------------
 
+//------------------------------------------------------------------------------
+// MS Visual Studio-specific (disable C4996 'strncpy unsafe').
+//------------------------------------------------------------------------------
+#if defined(_MSC_VER)
+#pragma warning(disable : 4996)
+#endif
+
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "token.h"
 #include "token_symbols.h"
+#include "consts.h"
 #include "utils.h"
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateWord(const char* string)
+ktToken ktTokenMakeWord(ktTokenSpan span)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_WORD;
-		ktStringCopy(&token->string, string);
-	}
+	ktToken token = { .type = KT_TOKEN_WORD };
+	token.value.span = span;
 
 	return token;
 }
@@ -42,14 +47,10 @@ ktToken* ktTokenCreateWord(const char* string)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateVar(char var)
+ktToken ktTokenMakeVar(char var)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_VAR;
-		token->var = toupper(var);
-	}
+	ktToken token = { .type = KT_TOKEN_VAR };
+	token.value.var = toupper(var);
 
 	return token;
 }
@@ -57,14 +58,10 @@ ktToken* ktTokenCreateVar(char var)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateNumber(double number)
+ktToken ktTokenMakeNumber(double number)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_NUMBER;
-		token->number = number;
-	}
+	ktToken token = { .type = KT_TOKEN_NUMBER };
+	token.value.number = number;
 
 	return token;
 }
@@ -72,51 +69,47 @@ ktToken* ktTokenCreateNumber(double number)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateSymbol(ktTokenType type)
+ktToken ktTokenMakeSymbol(ktTokenType type)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
+	ktToken token = { .type = type };
+	switch (token.type)
 	{
-		token->type = type;
-		switch (token->type)
-		{
-			case KT_TOKEN_NEWLINE:
-				token->symbol = KT_TOKEN_NEWLINE_SYMBOL;
-				break;
-			case KT_TOKEN_EOF:
-				token->symbol = KT_TOKEN_EOF_SYMBOL;
-				break;
-			case KT_TOKEN_EQUALS:
-				token->symbol = KT_TOKEN_EQUALS_SYMBOL;
-				break;
-			case KT_TOKEN_ADD:
-				token->symbol = KT_TOKEN_ADD_SYMBOL;
-				break;
-			case KT_TOKEN_SUB:
-				token->symbol = KT_TOKEN_SUB_SYMBOL;
-				break;
-			case KT_TOKEN_MUL:
-				token->symbol = KT_TOKEN_MUL_SYMBOL;
-				break;
-			case KT_TOKEN_DIV:
-				token->symbol = KT_TOKEN_DIV_SYMBOL;
-				break;
-			case KT_TOKEN_POW:
-				token->symbol = KT_TOKEN_POW_SYMBOL;
-				break;
-			case KT_TOKEN_NEG:
-				token->symbol = KT_TOKEN_NEG_SYMBOL;
-				break;
-			case KT_TOKEN_OPEN_PAREN:
-				token->symbol = KT_TOKEN_OPEN_PAREN_SYMBOL;
-				break;
-			case KT_TOKEN_CLOSE_PAREN:
-				token->symbol = KT_TOKEN_CLOSE_PAREN_SYMBOL;
-				break;
-			default:
-				token->symbol = '\0';
-				break;
-		}
+		case KT_TOKEN_NEWLINE:
+			token.value.symbol = KT_TOKEN_NEWLINE_SYMBOL;
+			break;
+		case KT_TOKEN_EOF:
+			token.value.symbol = KT_TOKEN_EOF_SYMBOL;
+			break;
+		case KT_TOKEN_EQUALS:
+			token.value.symbol = KT_TOKEN_EQUALS_SYMBOL;
+			break;
+		case KT_TOKEN_ADD:
+			token.value.symbol = KT_TOKEN_ADD_SYMBOL;
+			break;
+		case KT_TOKEN_SUB:
+			token.value.symbol = KT_TOKEN_SUB_SYMBOL;
+			break;
+		case KT_TOKEN_MUL:
+			token.value.symbol = KT_TOKEN_MUL_SYMBOL;
+			break;
+		case KT_TOKEN_DIV:
+			token.value.symbol = KT_TOKEN_DIV_SYMBOL;
+			break;
+		case KT_TOKEN_POW:
+			token.value.symbol = KT_TOKEN_POW_SYMBOL;
+			break;
+		case KT_TOKEN_NEG:
+			token.value.symbol = KT_TOKEN_NEG_SYMBOL;
+			break;
+		case KT_TOKEN_OPEN_PAREN:
+			token.value.symbol = KT_TOKEN_OPEN_PAREN_SYMBOL;
+			break;
+		case KT_TOKEN_CLOSE_PAREN:
+			token.value.symbol = KT_TOKEN_CLOSE_PAREN_SYMBOL;
+			break;
+		default:
+			token.value.symbol = '\0';
+			break;
 	}
 
 	return token;
@@ -125,14 +118,10 @@ ktToken* ktTokenCreateSymbol(ktTokenType type)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateStmtLet(void)
+ktToken ktTokenMakeStmt(ktTokenType type, ktTokenSpan span)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_STMT_LET;
-		ktStringCopy(&token->string, KT_TOKEN_STMT_LET_VALUE);
-	}
+	ktToken token = { .type = type };
+	token.value.span = span;
 
 	return token;
 }
@@ -140,118 +129,130 @@ ktToken* ktTokenCreateStmtLet(void)
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateStmtReset(void)
+ktToken ktTokenMakeError(ktErrorType errorType, ktTokenSpan span)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_STMT_RESET;
-		ktStringCopy(&token->string, KT_TOKEN_STMT_RESET_VALUE);
-	}
+	ktToken token = { .type = KT_TOKEN_ERROR };
+	token.value.error.type = errorType;
+	token.value.error.span = span;
 
 	return token;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Words and statements don't own a copy of their text. Instead, they keep
+// a span that points to the contents given to the tokenizer.
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateStmtVars(void)
+bool ktTokenHasSpan(const ktToken* token)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_STMT_VARS;
-		ktStringCopy(&token->string, KT_TOKEN_STMT_VARS_VALUE);
-	}
-
-	return token;
+	return token->type == KT_TOKEN_WORD
+		|| token->type == KT_TOKEN_STMT_LET
+		|| token->type == KT_TOKEN_STMT_RESET
+		|| token->type == KT_TOKEN_STMT_VARS
+		|| token->type == KT_TOKEN_STMT_CLEAR
+		|| token->type == KT_TOKEN_STMT_EXIT
+#if _DEBUG_RPN
+		|| token->type == KT_TOKEN_STMT_RPN
+#endif // #if _DEBUG_RPN
+		;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Copies the token text to a new string (the caller must destroy it).
+// The contents must be the same ones used to tokenize the token.
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateStmtClear(void)
+bool ktTokenCopyString(const ktToken* token, const char* contents, char** destination)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
+	if (token->type == KT_TOKEN_ERROR)
 	{
-		token->type = KT_TOKEN_STMT_CLEAR;
-		ktStringCopy(&token->string, KT_TOKEN_STMT_CLEAR_VALUE);
+		char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+		ktTokenErrorMessage(token, contents, buffer, KT_ERROR_MESSAGE_MAX_LENGTH);
+
+		return ktStringCopy(destination, buffer);
+	}
+	else if (ktTokenHasSpan(token) && token->value.span.length > 0)
+	{
+		return ktStringCopyInterval(destination, contents, token->value.span.offset, token->value.span.offset + token->value.span.length - 1);
 	}
 
-	return token;
+	return ktStringCopy(destination, "");
 }
 
 //------------------------------------------------------------------------------
-// 
+// Same as ktTokenCopyString(), but writes to the buffer (truncating the text
+// if it doesn't fit) instead of allocating a new string.
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateStmtExit(void)
+void ktTokenCopyStringToBuffer(const ktToken* token, const char* contents, char* buffer, size_t size)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
+	if (!buffer || size == 0)
+		return;
+
+	if (token->type == KT_TOKEN_ERROR)
 	{
-		token->type = KT_TOKEN_STMT_EXIT;
-		ktStringCopy(&token->string, KT_TOKEN_STMT_EXIT_VALUE);
+		ktTokenErrorMessage(token, contents, buffer, size);
+	}
+	else if (ktTokenHasSpan(token))
+	{
+		size_t length = ktMin(token->value.span.length, size - 1);
+		memcpy(buffer, &contents[token->value.span.offset], length);
+		buffer[length] = '\0';
+	}
+	else
+	{
+		buffer[0] = '\0';
 	}
-
-	return token;
 }
 
 //------------------------------------------------------------------------------
-// 
+// Builds the message of a KT_TOKEN_ERROR. The contents must be the same ones
+// used to tokenize the token.
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateError(const char* string)
+void ktTokenErrorMessage(const ktToken* token, const char* contents, char* buffer, size_t size)
 {
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
+	if (!buffer || size == 0)
+		return;
+
+	buffer[0] = '\0';
+	if (token->type != KT_TOKEN_ERROR)
+		return;
+
+	const ktTokenError* error = &token->value.error;
+	switch (error->type)
 	{
-		token->type = KT_TOKEN_ERROR;
-		ktStringCopy(&token->string, string);
+	case KT_ERROR_TOKENIZER_STR_TO_NUMBER:
+	{
+		char numberStr[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+		strncpy(numberStr, &contents[error->span.offset], ktMin(error->span.length, KT_ERROR_MESSAGE_MAX_LENGTH - 1));
+		snprintf(buffer, size, ktErrorDescription(error->type), numberStr);
+		break;
 	}
 
-	return token;
-}
+	case KT_ERROR_TOKENIZER_INVALID_TOKEN:
+		snprintf(buffer, size, ktErrorDescription(error->type), contents[error->span.offset]);
+		break;
 
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-void ktTokenDestroy(ktToken* token)
-{
-	if (token)
-	{
-		bool mustDestroyString = token->type == KT_TOKEN_WORD
-			|| token->type == KT_TOKEN_STMT_LET
-			|| token->type == KT_TOKEN_STMT_RESET
-			|| token->type == KT_TOKEN_STMT_VARS
-			|| token->type == KT_TOKEN_STMT_CLEAR
-			|| token->type == KT_TOKEN_STMT_EXIT
-			|| token->type == KT_TOKEN_ERROR;
-		if (mustDestroyString)
-		{
-			ktStringDestroy(token->string);
-		}
-
-		SAFE_DELETE(token);
+	default:
+		snprintf(buffer, size, "%s", ktErrorDescription(error->type));
+		break;
 	}
 }
 
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-void ktTokenPrint(const ktToken* token)
+void ktTokenPrint(const ktToken* token, const char* contents)
 {
 	switch (token->type)
 	{
 	case KT_TOKEN_WORD:
-		printf("  WORD: %s\n", token->string);
+		printf("  WORD: %.*s\n", (int)token->value.span.length, &contents[token->value.span.offset]);
 		break;
 
 	case KT_TOKEN_VAR:
-		printf("   VAR: %c\n", token->var);
+		printf("   VAR: %c\n", token->value.var);
 		break;
 
 	case KT_TOKEN_NUMBER:
-		printf("NUMBER: %f\n", token->number);
+		printf("NUMBER: %f\n", token->value.number);
 		break;
 
 	case KT_TOKEN_NEWLINE:
@@ -270,11 +271,11 @@ void ktTokenPrint(const ktToken* token)
 	case KT_TOKEN_POW:
 	case KT_TOKEN_OPEN_PAREN:
 	case KT_TOKEN_CLOSE_PAREN:
-		printf("SYMBOL: %c\n", token->symbol);
+		printf("SYMBOL: %c\n", token->value.symbol);
 		break;
 
 	case KT_TOKEN_NEG:
-		printf("SYMBOL: %c (KT_TOKEN_NEG)\n", token->symbol);
+		printf("SYMBOL: %c (KT_TOKEN_NEG)\n", token->value.symbol);
 		break;
 
 	case KT_TOKEN_STMT_LET:
@@ -282,34 +283,21 @@ void ktTokenPrint(const ktToken* token)
 	case KT_TOKEN_STMT_VARS:
 	case KT_TOKEN_STMT_CLEAR:
 	case KT_TOKEN_STMT_EXIT:
-		printf("  STMT: %s\n", token->string);
+		printf("  STMT: %.*s\n", (int)token->value.span.length, &contents[token->value.span.offset]);
 		break;
 
 	case KT_TOKEN_ERROR:
-		printf(" ERROR: %s\n", token->string);
+	{
+		char buffer[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
+		ktTokenErrorMessage(token, contents, buffer, KT_ERROR_MESSAGE_MAX_LENGTH);
+		printf(" ERROR: %s\n", buffer);
 		break;
+	}
 
 #if _DEBUG_RPN
 	case KT_TOKEN_STMT_RPN:
-		printf("  STMT: %s (DEBUG)\n", token->string);
+		printf("  STMT: %.*s (DEBUG)\n", (int)token->value.span.length, &contents[token->value.span.offset]);
 		break;
 #endif
 	}
 }
-
-#if _DEBUG_RPN
-//------------------------------------------------------------------------------
-// 
-//------------------------------------------------------------------------------
-ktToken* ktTokenCreateStmtRpn(void)
-{
-	ktToken* token = malloc(sizeof(ktToken));
-	if (token)
-	{
-		token->type = KT_TOKEN_STMT_RPN;
-		ktStringCopy(&token->string, KT_TOKEN_STMT_RPN_VALUE);
-	}
-
-	return token;
-}
-#endif // #if _DEBUG_RPN
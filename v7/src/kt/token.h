@@ -20,45 +20,63 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
+#include <stdbool.h>
+#include <stddef.h>
 #include "token_type.h"
+#include "error_type.h"
 #include "debug.h"
 
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
+typedef struct ktTokenSpan ktTokenSpan;
+typedef struct ktTokenError ktTokenError;
+typedef union ktTokenValue ktTokenValue;
 typedef struct ktToken ktToken;
 
+// Interval of characters [offset, offset + length) in the tokenized contents.
+struct ktTokenSpan
+{
+	size_t offset;
+	size_t length;
+};
+
+// Tokenizer errors only store what is needed to build the error message
+// later (see ktTokenErrorMessage()).
+struct ktTokenError
+{
+	ktErrorType type;
+	ktTokenSpan span;
+};
+
+union ktTokenValue
+{
+	ktTokenSpan span;
+	ktTokenError error;
+	char var;
+	char symbol;
+	double number;
+};
+
 struct ktToken
 {
 	ktTokenType type;
-	
-	union
-	{
-		char* string;
-		char var;
-		char symbol;
-		double number;
-	};
+	ktTokenValue value;
 };
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-ktToken* ktTokenCreateWord(const char* string);
-ktToken* ktTokenCreateVar(char var);
-ktToken* ktTokenCreateNumber(double number);
-ktToken* ktTokenCreateSymbol(ktTokenType type);
-ktToken* ktTokenCreateStmtLet(void);
-ktToken* ktTokenCreateStmtReset(void);
-ktToken* ktTokenCreateStmtVars(void);
-ktToken* ktTokenCreateStmtClear(void);
-ktToken* ktTokenCreateStmtExit(void);
-ktToken* ktTokenCreateError(const char* string);
-void ktTokenDestroy(ktToken* token);
-void ktTokenPrint(const ktToken* token);
-
-#if _DEBUG_RPN
-ktToken* ktTokenCreateStmtRpn(void);
-#endif // #if _DEBUG_RPN
+ktToken ktTokenMakeWord(ktTokenSpan span);
+ktToken ktTokenMakeVar(char var);
+ktToken ktTokenMakeNumber(double number);
+ktToken ktTokenMakeSymbol(ktTokenType type);
+ktToken ktTokenMakeStmt(ktTokenType type, ktTokenSpan span);
+ktToken ktTokenMakeError(ktErrorType errorType, ktTokenSpan span);
+bool ktTokenHasSpan(const ktToken* token);
+bool ktTokenCopyString(const ktToken* token, const char* contents, char** destination);
+void ktTokenCopyStringToBuffer(const ktToken* token, const char* contents, char* buffer, size_t size);
+void ktTokenErrorMessage(const ktToken* token, const char* contents, char* buffer, size_t size);
+void ktTokenPrint(const ktToken* token, const char* contents);
 
 #endif // __KISHITECH_TOKEN_H__
@@ -0,0 +1,150 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include "token_buffer.h"
+#include "alloc.h"
+#include "utils.h"
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+static bool grow(ktTokenBuffer* buffer);
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktTokenBuffer* ktTokenBufferCreate(void)
+{
+	ktTokenBuffer* buffer = ktAlloc(sizeof(ktTokenBuffer));
+	if (buffer)
+	{
+		buffer->types = NULL;
+		buffer->values = NULL;
+		buffer->offsets = NULL;
+		buffer->count = 0;
+		buffer->capacity = 0;
+	}
+
+	return buffer;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktTokenBufferDestroy(ktTokenBuffer* buffer)
+{
+	if (buffer)
+	{
+		SAFE_DELETE(buffer->types);
+		SAFE_DELETE(buffer->values);
+		SAFE_DELETE(buffer->offsets);
+		SAFE_DELETE(buffer);
+	}
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool ktTokenBufferAppend(ktTokenBuffer* buffer, ktToken token, size_t offset)
+{
+	if (!buffer)
+		return false;
+
+	if (buffer->count == buffer->capacity && !grow(buffer))
+		return false;
+
+	buffer->types[buffer->count] = (unsigned char)token.type;
+	buffer->values[buffer->count] = token.value;
+	buffer->offsets[buffer->count] = offset;
+	++buffer->count;
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktTokenBufferRemoveLast(ktTokenBuffer* buffer)
+{
+	if (!buffer || ktTokenBufferIsEmpty(buffer))
+		return;
+
+	--buffer->count;
+}
+
+//------------------------------------------------------------------------------
+// Tokens don't own any memory, so clearing the buffer is O(1) and keeps the
+// capacity for the next line.
+//------------------------------------------------------------------------------
+void ktTokenBufferClear(ktTokenBuffer* buffer)
+{
+	if (!buffer)
+		return;
+
+	buffer->count = 0;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool ktTokenBufferIsEmpty(const ktTokenBuffer* buffer)
+{
+	return buffer != NULL && buffer->count == 0;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+ktToken ktTokenBufferGet(const ktTokenBuffer* buffer, size_t index)
+{
+	ktToken token =
+	{
+		.type = (ktTokenType)buffer->types[index],
+		.value = buffer->values[index]
+	};
+
+	return token;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool grow(ktTokenBuffer* buffer)
+{
+	size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2 : KT_TOKEN_BUFFER_INITIAL_CAPACITY;
+
+	unsigned char* types = ktRealloc(buffer->types, capacity * sizeof(unsigned char));
+	if (!types)
+		return false;
+	buffer->types = types;
+
+	ktTokenValue* values = ktRealloc(buffer->values, capacity * sizeof(ktTokenValue));
+	if (!values)
+		return false;
+	buffer->values = values;
+
+	size_t* offsets = ktRealloc(buffer->offsets, capacity * sizeof(size_t));
+	if (!offsets)
+		return false;
+	buffer->offsets = offsets;
+
+	buffer->capacity = capacity;
+
+	return true;
+}
@@ -0,0 +1,61 @@
+//------------------------------------------------------------------------------
+// Copyright 2024 Andre Kishimoto
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+#ifndef __KISHITECH_TOKEN_BUFFER_H__
+#define __KISHITECH_TOKEN_BUFFER_H__
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdbool.h>
+#include "token.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktTokenBuffer ktTokenBuffer;
+
+enum ktTokenBufferConstants
+{
+	KT_TOKEN_BUFFER_INITIAL_CAPACITY = 64,
+};
+
+// Growable array of tokens stored as a structure of arrays: the parser mostly
+// looks at token types, so they are kept packed together (one byte each) and
+// the values live in a parallel array. offsets has where each token starts in
+// the contents it was read from (only looked at when reporting errors).
+struct ktTokenBuffer
+{
+	unsigned char* types;
+	ktTokenValue* values;
+	size_t* offsets;
+	size_t count;
+	size_t capacity;
+};
+
+//------------------------------------------------------------------------------
+// Function definitions
+//------------------------------------------------------------------------------
+ktTokenBuffer* ktTokenBufferCreate(void);
+void ktTokenBufferDestroy(ktTokenBuffer* buffer);
+bool ktTokenBufferAppend(ktTokenBuffer* buffer, ktToken token, size_t offset);
+void ktTokenBufferRemoveLast(ktTokenBuffer* buffer);
+void ktTokenBufferClear(ktTokenBuffer* buffer);
+bool ktTokenBufferIsEmpty(const ktTokenBuffer* buffer);
+ktToken ktTokenBufferGet(const ktTokenBuffer* buffer, size_t index);
+
+#endif // __KISHITECH_TOKEN_BUFFER_H__
@@ -22,24 +22,10 @@
 //------------------------------------------------------------------------------
 // Custom types, structs, etc.
 //------------------------------------------------------------------------------
-const char KT_TOKEN_NEWLINE_SYMBOL = '\n';
-const char KT_TOKEN_EOF_SYMBOL = '\0';
-const char KT_TOKEN_EQUALS_SYMBOL = '=';
-const char KT_TOKEN_ADD_SYMBOL = '+';
-const char KT_TOKEN_SUB_SYMBOL = '-';
-const char KT_TOKEN_MUL_SYMBOL = '*';
-const char KT_TOKEN_DIV_SYMBOL = '/';
-const char KT_TOKEN_POW_SYMBOL = '^';
-const char KT_TOKEN_NEG_SYMBOL = '~'; // Negation uses a different symbol.
-const char KT_TOKEN_OPEN_PAREN_SYMBOL = '(';
-const char KT_TOKEN_CLOSE_PAREN_SYMBOL = ')';
+#define X_MACRO(type, symbol) const char type##_SYMBOL = symbol;
+KT_TOKEN_SYMBOL_LIST
+#undef X_MACRO
 
-const char* const KT_TOKEN_STMT_LET_VALUE = "LET";
-const char* const KT_TOKEN_STMT_RESET_VALUE = "RESET";
-const char* const KT_TOKEN_STMT_VARS_VALUE = "VARS";
-const char* const KT_TOKEN_STMT_CLEAR_VALUE = "CLEAR";
-const char* const KT_TOKEN_STMT_EXIT_VALUE = "EXIT";
-
-#if _DEBUG_RPN
-const char* const KT_TOKEN_STMT_RPN_VALUE = "RPN";
-#endif // #if _DEBUG_RPN
+#define X_MACRO(type, first, value) const char* const type##_VALUE = value;
+KT_TOKEN_STMT_KEYWORD_LIST
+#undef X_MACRO
@@ -23,28 +23,49 @@
 #include "debug.h"
 
 //------------------------------------------------------------------------------
-// Custom types, structs, etc.
+// Macros
 //------------------------------------------------------------------------------
-extern const char KT_TOKEN_NEWLINE_SYMBOL;
-extern const char KT_TOKEN_EOF_SYMBOL;
-extern const char KT_TOKEN_EQUALS_SYMBOL;
-extern const char KT_TOKEN_ADD_SYMBOL;
-extern const char KT_TOKEN_SUB_SYMBOL;
-extern const char KT_TOKEN_MUL_SYMBOL;
-extern const char KT_TOKEN_DIV_SYMBOL;
-extern const char KT_TOKEN_POW_SYMBOL;
-extern const char KT_TOKEN_NEG_SYMBOL;
-extern const char KT_TOKEN_OPEN_PAREN_SYMBOL;
-extern const char KT_TOKEN_CLOSE_PAREN_SYMBOL;
-
-extern const char* const KT_TOKEN_STMT_LET_VALUE;
-extern const char* const KT_TOKEN_STMT_RESET_VALUE;
-extern const char* const KT_TOKEN_STMT_VARS_VALUE;
-extern const char* const KT_TOKEN_STMT_CLEAR_VALUE;
-extern const char* const KT_TOKEN_STMT_EXIT_VALUE;
+#define KT_TOKEN_SYMBOL_LIST \
+	X_MACRO(KT_TOKEN_NEWLINE, '\n') \
+	X_MACRO(KT_TOKEN_EOF, '\0') \
+	X_MACRO(KT_TOKEN_EQUALS, '=') \
+	X_MACRO(KT_TOKEN_ADD, '+') \
+	X_MACRO(KT_TOKEN_SUB, '-') \
+	X_MACRO(KT_TOKEN_MUL, '*') \
+	X_MACRO(KT_TOKEN_DIV, '/') \
+	X_MACRO(KT_TOKEN_POW, '^') \
+	X_MACRO(KT_TOKEN_NEG, '~') /* Negation uses a different symbol. */ \
+	X_MACRO(KT_TOKEN_OPEN_PAREN, '(') \
+	X_MACRO(KT_TOKEN_CLOSE_PAREN, ')')
+
+// Statement keywords. New statements only need an entry here (and a token
+// type). The first letter is repeated because characters of a string literal
+// aren't constant expressions, and the tokenizer's keyword table is built from
+// it at compile time.
+#define KT_TOKEN_STMT_KEYWORD_LIST_BASE \
+	X_MACRO(KT_TOKEN_STMT_LET, 'L', "LET") \
+	X_MACRO(KT_TOKEN_STMT_RESET, 'R', "RESET") \
+	X_MACRO(KT_TOKEN_STMT_VARS, 'V', "VARS") \
+	X_MACRO(KT_TOKEN_STMT_CLEAR, 'C', "CLEAR") \
+	X_MACRO(KT_TOKEN_STMT_EXIT, 'E', "EXIT")
 
 #if _DEBUG_RPN
-extern const char* const KT_TOKEN_STMT_RPN_VALUE;
+#define KT_TOKEN_STMT_KEYWORD_LIST \
+	KT_TOKEN_STMT_KEYWORD_LIST_BASE \
+	X_MACRO(KT_TOKEN_STMT_RPN, 'R', "RPN")
+#else
+#define KT_TOKEN_STMT_KEYWORD_LIST KT_TOKEN_STMT_KEYWORD_LIST_BASE
 #endif // #if _DEBUG_RPN
 
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+#define X_MACRO(type, symbol) extern const char type##_SYMBOL;
+KT_TOKEN_SYMBOL_LIST
+#undef X_MACRO
+
+#define X_MACRO(type, first, value) extern const char* const type##_VALUE;
+KT_TOKEN_STMT_KEYWORD_LIST
+#undef X_MACRO
+
 #endif // __KISHITECH_TOKEN_SYMBOLS_H__
@@ -17,310 +17,625 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include <ctype.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <string.h>
 #include "tokenizer.h"
+#include "alloc.h"
+#include "char_scan.h"
+#include "number_parser.h"
 #include "token_symbols.h"
 #include "utils.h"
 #include "error_type.h"
-#include "consts.h"
 #include "debug.h"
 
 //------------------------------------------------------------------------------
-// Globals (argh!)
+// Macros
 //------------------------------------------------------------------------------
-static const char* data = NULL;
-static unsigned char curr = '\0';
-static int length = 0;
-static int index = 0;
+// index before the first advance() (the next one wraps it around to 0).
+#define KT_TOKENIZER_BEFORE_START	((size_t)-1)
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+struct ktTokenizer
+{
+	const char* data;
+	unsigned char curr;
+	size_t length;
+	size_t index;
+
+	// Functions that find the end of blank, number and word runs (SIMD when
+	// the CPU supports it).
+	const ktCharScan* scan;
+
+	// Streaming (ktTokenizerFeed()/ktTokenizerFinish()). Statements that are
+	// complete inside a chunk are tokenized in place; only a statement that
+	// straddles chunks is kept in the carry buffer until its line break
+	// arrives.
+	ktTokenizerStmtCallback stmtCallback;
+	void* userData;
+	ktTokenBuffer* stmtBuffer;
+	char* carry;
+	size_t carryLength;
+	size_t carryCapacity;
+	bool skipLineFeed;
+
+	// Pull mode (ktTokenizerBegin()/ktTokenizerNext()). The window holds the
+	// last token returned (the previous token for lexStep()) followed by the
+	// tokens scanned but not returned yet: at most a KT_TOKEN_NEG that may
+	// still be cancelled by the next one, plus the token after it.
+	ktTokenBuffer* window;
+	size_t windowHead;
+	bool isWindowDone;
+};
+
+enum ktTokenizerConstants
+{
+	KT_TOKENIZER_CARRY_INITIAL_CAPACITY = 128,
+};
+
+// Character classes (C locale). ktTokenizerRun() dispatches each character
+// with a single lookup in CHAR_CLASS instead of a chain of comparisons.
+enum ktCharClass
+{
+	KT_CHAR_INVALID,
+	KT_CHAR_EOF,
+	KT_CHAR_BLANK,
+	KT_CHAR_NEWLINE,
+	KT_CHAR_CARRIAGE_RETURN,
+	KT_CHAR_SYMBOL,
+	KT_CHAR_SUB,
+	KT_CHAR_DIGIT,
+	KT_CHAR_DECIMAL_POINT,
+	KT_CHAR_ALPHA,
+	KT_CHAR_PUNCT,
+};
+
+#define CLASS_BIT(charClass)	(1u << (charClass))
+
+#define INV	KT_CHAR_INVALID
+#define EOS	KT_CHAR_EOF
+#define BLK	KT_CHAR_BLANK
+#define NLN	KT_CHAR_NEWLINE
+#define CRT	KT_CHAR_CARRIAGE_RETURN
+#define SYM	KT_CHAR_SYMBOL
+#define SUB	KT_CHAR_SUB
+#define DIG	KT_CHAR_DIGIT
+#define DOT	KT_CHAR_DECIMAL_POINT
+#define ALP	KT_CHAR_ALPHA
+#define PCT	KT_CHAR_PUNCT
+
+// Every SYM entry must have its token type in SYMBOL_TOKEN.
+static const unsigned char CHAR_CLASS[256] =
+{
+	EOS, INV, INV, INV, INV, INV, INV, INV, INV, BLK, NLN, INV, INV, CRT, INV, INV, // 0x00
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0x10
+	BLK, PCT, PCT, PCT, PCT, PCT, PCT, PCT, SYM, SYM, SYM, SYM, PCT, SUB, DOT, SYM, // 0x20
+	DIG, DIG, DIG, DIG, DIG, DIG, DIG, DIG, DIG, DIG, PCT, PCT, PCT, SYM, PCT, PCT, // 0x30
+	PCT, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, // 0x40
+	ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, PCT, PCT, PCT, SYM, PCT, // 0x50
+	PCT, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, // 0x60
+	ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, ALP, PCT, PCT, PCT, PCT, INV, // 0x70
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0x80
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0x90
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0xA0
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0xB0
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0xC0
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0xD0
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0xE0
+	INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, INV, // 0xF0
+};
+
+#undef INV
+#undef EOS
+#undef BLK
+#undef NLN
+#undef CRT
+#undef SYM
+#undef SUB
+#undef DIG
+#undef DOT
+#undef ALP
+#undef PCT
+
+static const unsigned char SYMBOL_TOKEN[256] =
+{
+#define X_MACRO(type, symbol) [(unsigned char)(symbol)] = type,
+	KT_TOKEN_SYMBOL_LIST
+#undef X_MACRO
+};
+
+// A single letter followed by one of these is a variable (e.g. "A+B").
+static const unsigned int VAR_END_CLASSES = CLASS_BIT(KT_CHAR_EOF)
+	| CLASS_BIT(KT_CHAR_BLANK)
+	| CLASS_BIT(KT_CHAR_NEWLINE)
+	| CLASS_BIT(KT_CHAR_SYMBOL)
+	| CLASS_BIT(KT_CHAR_SUB);
+
+// sizeof() of this union is the length of the longest keyword plus one.
+union ktKeywordSizes
+{
+#define X_MACRO(type, first, value) char type##_SIZE[sizeof(value)];
+	KT_TOKEN_STMT_KEYWORD_LIST
+#undef X_MACRO
+};
+
+enum ktKeywordConstants
+{
+	KT_KEYWORD_LENGTHS = sizeof(union ktKeywordSizes),
+	KT_KEYWORD_FIRST_LETTERS = 'Z' - 'A' + 1,
+};
+
+// Keywords indexed by length and first letter; KT_TOKEN_WORD means there is
+// no keyword. Two keywords with the same length and first letter would make
+// -Woverride-init complain, and need another key.
+static const unsigned char KEYWORD_TOKEN[KT_KEYWORD_LENGTHS][KT_KEYWORD_FIRST_LETTERS] =
+{
+#define X_MACRO(type, first, value) [sizeof(value) - 1][(first) - 'A'] = type,
+	KT_TOKEN_STMT_KEYWORD_LIST
+#undef X_MACRO
+};
+
+static const char* const KEYWORD_VALUE[] =
+{
+#define X_MACRO(type, first, value) [type] = value,
+	KT_TOKEN_STMT_KEYWORD_LIST
+#undef X_MACRO
+};
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-static void reset(void);
-static void advance(void);
-static void retreat(void);
-static unsigned char peek(size_t ahead);
+static inline void reset(ktTokenizer* tokenizer);
+static inline void advance(ktTokenizer* tokenizer);
+static inline void retreat(ktTokenizer* tokenizer);
+static inline unsigned char peek(const ktTokenizer* tokenizer, size_t ahead);
+static inline void seek(ktTokenizer* tokenizer, size_t index);
+static inline size_t runEnd(const ktTokenizer* tokenizer, size_t (*scanRun)(const char*, size_t, size_t));
+static inline bool isClass(unsigned char c, unsigned int classes);
+static inline ktTokenType keywordType(const char* data, ktTokenSpan span);
+static void tokenize(ktTokenizer* tokenizer, const char* data, size_t length, ktTokenBuffer* out_buffer);
+static void begin(ktTokenizer* tokenizer, const char* data, size_t length);
+static inline bool lexStep(ktTokenizer* tokenizer, ktTokenBuffer* out_buffer);
+static void emitStmt(ktTokenizer* tokenizer, const char* data, size_t length);
+static bool carryAppend(ktTokenizer* tokenizer, const char* bytes, size_t length);
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void ktTokenizerRun(const char* contents, ktTokenList* out_list)
+ktTokenizer* ktTokenizerCreate(void)
+{
+	ktTokenizer* tokenizer = ktAlloc(sizeof(ktTokenizer));
+	if (tokenizer)
+	{
+		tokenizer->data = NULL;
+		tokenizer->length = 0;
+		tokenizer->scan = ktCharScanGet(ktCharScanBestPath());
+		tokenizer->stmtCallback = NULL;
+		tokenizer->userData = NULL;
+		tokenizer->stmtBuffer = NULL;
+		tokenizer->carry = NULL;
+		tokenizer->carryLength = 0;
+		tokenizer->carryCapacity = 0;
+		tokenizer->skipLineFeed = false;
+		tokenizer->window = NULL;
+		tokenizer->windowHead = 0;
+		tokenizer->isWindowDone = true;
+		reset(tokenizer);
+	}
+
+	return tokenizer;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktTokenizerDestroy(ktTokenizer* tokenizer)
+{
+	if (tokenizer)
+	{
+		ktTokenBufferDestroy(tokenizer->stmtBuffer);
+		ktTokenBufferDestroy(tokenizer->window);
+		SAFE_DELETE(tokenizer->carry);
+		SAFE_DELETE(tokenizer);
+	}
+}
+
+//------------------------------------------------------------------------------
+// Unsupported paths fall back to the scalar path.
+//------------------------------------------------------------------------------
+void ktTokenizerSetCharScanPath(ktTokenizer* tokenizer, ktCharScanPath path)
 {
-	if (!out_list)
+	if (!tokenizer)
 		return;
 
-	ktTokenListClear(out_list);
+	tokenizer->scan = ktCharScanGet(path);
+}
 
-	data = contents;
-	length = (int)strlen(data);
+//------------------------------------------------------------------------------
+// Each ktTokenizer owns its scanning state, so different threads can run
+// their own tokenizer at the same time without any locking.
+//------------------------------------------------------------------------------
+void ktTokenizerRun(ktTokenizer* tokenizer, const char* contents, ktTokenBuffer* out_buffer)
+{
+	if (!tokenizer || !contents || !out_buffer)
+		return;
 
-	reset();
+	tokenize(tokenizer, contents, strlen(contents), out_buffer);
+}
 
-	while (true)
+//------------------------------------------------------------------------------
+// Starts pulling tokens from the contents, one ktTokenizerNext() call at a
+// time, instead of tokenizing everything up front. The contents must outlive
+// the calls to ktTokenizerNext().
+//------------------------------------------------------------------------------
+bool ktTokenizerBegin(ktTokenizer* tokenizer, const char* contents)
+{
+	if (!tokenizer || !contents)
+		return false;
+
+	if (!tokenizer->window)
 	{
-		if (index >= length)
+		tokenizer->window = ktTokenBufferCreate();
+		if (!tokenizer->window)
+			return false;
+	}
+
+	ktTokenBufferClear(tokenizer->window);
+	tokenizer->windowHead = 0;
+	tokenizer->isWindowDone = false;
+	begin(tokenizer, contents, strlen(contents));
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Returns the same tokens ktTokenizerRun() would have put in the buffer, in
+// order, ending with KT_TOKEN_EOF. Returns false when there are no more tokens.
+//------------------------------------------------------------------------------
+bool ktTokenizerNext(ktTokenizer* tokenizer, ktToken* out_token)
+{
+	if (!tokenizer || !tokenizer->window)
+		return false;
+
+	ktTokenBuffer* window = tokenizer->window;
+
+	// A pending KT_TOKEN_NEG is only returned once we know the next token
+	// doesn't cancel it.
+	while (!tokenizer->isWindowDone
+		&& (window->count == tokenizer->windowHead
+			|| (window->count == tokenizer->windowHead + 1 && window->types[tokenizer->windowHead] == KT_TOKEN_NEG)))
+	{
+		tokenizer->isWindowDone = !lexStep(tokenizer, window);
+	}
+
+	if (tokenizer->windowHead >= window->count)
+		return false;
+
+	*out_token = ktTokenBufferGet(window, tokenizer->windowHead);
+	++tokenizer->windowHead;
+
+	// Everything was returned: keep only the last token, the previous token
+	// for the next lexStep().
+	if (tokenizer->windowHead == window->count && window->count > 1)
+	{
+		window->types[0] = window->types[window->count - 1];
+		window->values[0] = window->values[window->count - 1];
+		window->offsets[0] = window->offsets[window->count - 1];
+		window->count = 1;
+		tokenizer->windowHead = 1;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Where the last token returned by ktTokenizerNext() starts in the contents.
+//------------------------------------------------------------------------------
+size_t ktTokenizerLastOffset(const ktTokenizer* tokenizer)
+{
+	if (!tokenizer || !tokenizer->window || tokenizer->windowHead == 0)
+		return 0;
+
+	return tokenizer->window->offsets[tokenizer->windowHead - 1];
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void ktTokenizerSetStmtCallback(ktTokenizer* tokenizer, ktTokenizerStmtCallback callback, void* userData)
+{
+	if (!tokenizer)
+		return;
+
+	tokenizer->stmtCallback = callback;
+	tokenizer->userData = userData;
+}
+
+//------------------------------------------------------------------------------
+// Accepts the input in chunks of any size (e.g. read from a pipe or socket)
+// and calls the statement callback for every statement as soon as its line
+// break ("\n", "\r" or "\r\n") arrives, even if the line break, a number or
+// a word is split between two chunks.
+// Returns false if the carry buffer couldn't grow; the statement that was
+// being carried is lost.
+//------------------------------------------------------------------------------
+bool ktTokenizerFeed(ktTokenizer* tokenizer, const char* bytes, size_t length)
+{
+	if (!tokenizer || !bytes)
+		return false;
+
+	if (!tokenizer->stmtBuffer)
+	{
+		tokenizer->stmtBuffer = ktTokenBufferCreate();
+		if (!tokenizer->stmtBuffer)
+			return false;
+	}
+
+	size_t start = 0;
+
+	// The previous chunk ended with '\r'; if this one starts with '\n', it
+	// belongs to the same "\r\n" line break.
+	if (tokenizer->skipLineFeed && length > 0)
+	{
+		tokenizer->skipLineFeed = false;
+		if (bytes[0] == '\n')
 		{
-			// HACK: Adding a KT_TOKEN_NEWLINE before KT_TOKEN_EOF because our grammar
-			// requires a line break after every valid statement. If we are calling
-			// the parser from our own REPL (contents come from fgets(stdin)), then
-			// we are probably changing the '\n' (added via fgets) to '\0'. If that
-			// is the case, then there is no line break after a statement.
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_NEWLINE));
-
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_EOF));
-			break;
+			start = 1;
 		}
+	}
 
-		advance();
+	for (size_t i = start; i < length; ++i)
+	{
+		unsigned char charClass = CHAR_CLASS[(unsigned char)bytes[i]];
+		if (charClass != KT_CHAR_NEWLINE && charClass != KT_CHAR_CARRIAGE_RETURN)
+			continue;
 
-		if (isblank(curr))
+		if (tokenizer->carryLength > 0)
 		{
-			// Skip all whitespaces.
-			while (isblank(curr))
+			bool carried = carryAppend(tokenizer, &bytes[start], i - start);
+			if (carried)
 			{
-				advance();
+				emitStmt(tokenizer, tokenizer->carry, tokenizer->carryLength);
 			}
+			tokenizer->carryLength = 0;
 
-			// Go back one character so the first advance() call in the next
-			// loop iteration gets the correct character. This must be done
-			// because we always advance to the next character in the loop
-			// above that is used to skip blank characters.
-			retreat();
+			if (!carried)
+				return false;
 		}
-		else if (curr == '\n' || curr == '\r')
-		{
-			// Handle the case where "\r\n" is used for a newline.
-			if (curr == '\r' && peek(1) == '\n')
-			{
-				advance();
-			}
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_NEWLINE));
-		}
-		else if (curr == KT_TOKEN_EQUALS_SYMBOL)
-		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_EQUALS));
-		}
-		else if (curr == KT_TOKEN_ADD_SYMBOL)
+		else
 		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_ADD));
+			emitStmt(tokenizer, &bytes[start], i - start);
 		}
-		else if (curr == KT_TOKEN_SUB_SYMBOL)
+
+		if (charClass == KT_CHAR_CARRIAGE_RETURN)
 		{
-			ktTokenType previousTokenType = ktTokenListIsEmpty(out_list) ? KT_TOKEN_EOF : out_list->tail->token->type;
-			
-			bool isNegate = previousTokenType == KT_TOKEN_EOF
-				|| previousTokenType == KT_TOKEN_NEWLINE
-				|| previousTokenType == KT_TOKEN_EQUALS
-				|| previousTokenType == KT_TOKEN_ADD
-				|| previousTokenType == KT_TOKEN_SUB
-				|| previousTokenType == KT_TOKEN_MUL
-				|| previousTokenType == KT_TOKEN_DIV
-				|| previousTokenType == KT_TOKEN_POW
-				|| previousTokenType == KT_TOKEN_NEG
-				|| previousTokenType == KT_TOKEN_OPEN_PAREN;
-
-			// If we are adding a KT_TOKEN_NEG and the last token in the list is KT_TOKEN_NEG,
-			// just remove the last token (KT_TOKEN_NEG) from the list and don't add anything,
-			// since a sequence of KT_TOKEN_NEG KT_TOKEN_NEG will cancel each other out.
-			if (isNegate && previousTokenType == KT_TOKEN_NEG)
+			if (i + 1 == length)
 			{
-				ktTokenListRemoveTail(out_list);
+				tokenizer->skipLineFeed = true;
 			}
-			else
+			else if (bytes[i + 1] == '\n')
 			{
-				ktTokenListAppend(out_list, ktTokenCreateSymbol(isNegate ? KT_TOKEN_NEG : KT_TOKEN_SUB));
+				++i;
 			}
 		}
-		else if (curr == KT_TOKEN_MUL_SYMBOL)
+
+		start = i + 1;
+	}
+
+	if (!carryAppend(tokenizer, &bytes[start], length - start))
+	{
+		tokenizer->carryLength = 0;
+		return false;
+	}
+
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Emits the last statement if the input didn't end with a line break, and
+// gets the tokenizer ready for a new stream.
+//------------------------------------------------------------------------------
+void ktTokenizerFinish(ktTokenizer* tokenizer)
+{
+	if (!tokenizer)
+		return;
+
+	if (tokenizer->carryLength > 0 && tokenizer->stmtBuffer)
+	{
+		emitStmt(tokenizer, tokenizer->carry, tokenizer->carryLength);
+	}
+
+	tokenizer->carryLength = 0;
+	tokenizer->skipLineFeed = false;
+}
+
+//------------------------------------------------------------------------------
+// Tokenizes data[0, length). The data doesn't need to be NUL-terminated.
+//------------------------------------------------------------------------------
+void tokenize(ktTokenizer* tokenizer, const char* data, size_t length, ktTokenBuffer* out_buffer)
+{
+	ktTokenBufferClear(out_buffer);
+	begin(tokenizer, data, length);
+
+	while (lexStep(tokenizer, out_buffer));
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void begin(ktTokenizer* tokenizer, const char* data, size_t length)
+{
+	tokenizer->data = data;
+	tokenizer->length = length;
+
+	reset(tokenizer);
+}
+
+//------------------------------------------------------------------------------
+// Scans the next token (or run of blanks) and appends it to the buffer. The
+// last token in the buffer is the previous token, which tells a negation from
+// a subtraction. Returns false once the end of the data has been reached and
+// the final KT_TOKEN_NEWLINE and KT_TOKEN_EOF have been appended.
+//------------------------------------------------------------------------------
+bool lexStep(ktTokenizer* tokenizer, ktTokenBuffer* out_buffer)
+{
+	if (tokenizer->index != KT_TOKENIZER_BEFORE_START && tokenizer->index >= tokenizer->length)
+	{
+		// HACK: Adding a KT_TOKEN_NEWLINE before KT_TOKEN_EOF because our grammar
+		// requires a line break after every valid statement. If we are calling
+		// the parser from our own REPL (contents come from fgets(stdin)), then
+		// we are probably changing the '\n' (added via fgets) to '\0'. If that
+		// is the case, then there is no line break after a statement.
+		ktTokenBufferAppend(out_buffer, ktTokenMakeSymbol(KT_TOKEN_NEWLINE), tokenizer->length);
+
+		ktTokenBufferAppend(out_buffer, ktTokenMakeSymbol(KT_TOKEN_EOF), tokenizer->length);
+		return false;
+	}
+
+	advance(tokenizer);
+	size_t offset = tokenizer->index;
+
+	switch (CHAR_CLASS[tokenizer->curr])
+	{
+	case KT_CHAR_BLANK:
+		// Skip all whitespaces. Stop at the last blank character so the
+		// first advance() call in the next lexStep() gets the correct
+		// character.
+		seek(tokenizer, runEnd(tokenizer, tokenizer->scan->blanks) - 1);
+		break;
+
+	case KT_CHAR_NEWLINE:
+	case KT_CHAR_CARRIAGE_RETURN:
+		// Handle the case where "\r\n" is used for a newline.
+		if (tokenizer->curr == '\r' && peek(tokenizer, 1) == '\n')
 		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_MUL));
+			advance(tokenizer);
 		}
-		else if (curr == KT_TOKEN_DIV_SYMBOL)
+		ktTokenBufferAppend(out_buffer, ktTokenMakeSymbol(KT_TOKEN_NEWLINE), offset);
+		break;
+
+	case KT_CHAR_SYMBOL:
+		ktTokenBufferAppend(out_buffer, ktTokenMakeSymbol((ktTokenType)SYMBOL_TOKEN[tokenizer->curr]), offset);
+		break;
+
+	case KT_CHAR_SUB:
+	{
+		ktTokenType previousTokenType = ktTokenBufferIsEmpty(out_buffer) ? KT_TOKEN_EOF : (ktTokenType)out_buffer->types[out_buffer->count - 1];
+		
+		bool isNegate = previousTokenType == KT_TOKEN_EOF
+			|| previousTokenType == KT_TOKEN_NEWLINE
+			|| previousTokenType == KT_TOKEN_EQUALS
+			|| previousTokenType == KT_TOKEN_ADD
+			|| previousTokenType == KT_TOKEN_SUB
+			|| previousTokenType == KT_TOKEN_MUL
+			|| previousTokenType == KT_TOKEN_DIV
+			|| previousTokenType == KT_TOKEN_POW
+			|| previousTokenType == KT_TOKEN_NEG
+			|| previousTokenType == KT_TOKEN_OPEN_PAREN;
+
+		// If we are adding a KT_TOKEN_NEG and the last token in the list is KT_TOKEN_NEG,
+		// just remove the last token (KT_TOKEN_NEG) from the list and don't add anything,
+		// since a sequence of KT_TOKEN_NEG KT_TOKEN_NEG will cancel each other out.
+		if (isNegate && previousTokenType == KT_TOKEN_NEG)
 		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_DIV));
+			ktTokenBufferRemoveLast(out_buffer);
 		}
-		else if (curr == KT_TOKEN_POW_SYMBOL)
+		else
 		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_POW));
+			ktTokenBufferAppend(out_buffer, ktTokenMakeSymbol(isNegate ? KT_TOKEN_NEG : KT_TOKEN_SUB), offset);
 		}
-		else if (curr == KT_TOKEN_OPEN_PAREN_SYMBOL)
+		break;
+	}
+
+	case KT_CHAR_DIGIT:
+	case KT_CHAR_DECIMAL_POINT:
+	{
+		size_t concatStartIndex = tokenizer->index;
+		size_t concatEndIndex = runEnd(tokenizer, tokenizer->scan->number) - 1;
+
+		seek(tokenizer, concatEndIndex);
+
+		ktTokenSpan span = { concatStartIndex, concatEndIndex - concatStartIndex + 1 };
+
+		double number = 0.0;
+		ktErrorType numberError = ktNumberParse(&tokenizer->data[span.offset], span.length, &number);
+		if (numberError == KT_ERROR_NONE)
 		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_OPEN_PAREN));
+			ktTokenBufferAppend(out_buffer, ktTokenMakeNumber(number), offset);
 		}
-		else if (curr == KT_TOKEN_CLOSE_PAREN_SYMBOL)
+		else
 		{
-			ktTokenListAppend(out_list, ktTokenCreateSymbol(KT_TOKEN_CLOSE_PAREN));
+			ktTokenBufferAppend(out_buffer, ktTokenMakeError(numberError, span), offset);
 		}
-		else if (isdigit(curr) || curr == '.')
-		{
-			bool isDouble = (curr == '.');
-			bool hasExtraDecimalPointError = false;
-
-			size_t concatStartIndex = index;
-			while (isdigit(curr) || curr == '.')
-			{
-				advance();
-				if (curr == '.')
-				{
-					if (!isDouble)
-					{
-						isDouble = true;
-					}
-					else
-					{
-						hasExtraDecimalPointError = true;
-						while (isdigit(curr) || curr == '.')
-						{
-							advance();
-						}
-						break;
-					}
-				}
-			}
-
-			size_t concatEndIndex = (size_t)index - 1;
-
-			retreat();
+		break;
+	}
 
-			if (hasExtraDecimalPointError)
-			{
-				ktTokenListAppend(out_list, ktTokenCreateError(ktErrorDescription(KT_ERROR_TOKENIZER_EXTRA_DECIMAL_POINT)));
-				continue;
-			}
+	case KT_CHAR_ALPHA:
+		// Only one letter followed by a whitespace or any valid symbol - we have found a variable!
+		if (isClass(peek(tokenizer, 1), VAR_END_CLASSES))
+		{
+			ktTokenBufferAppend(out_buffer, ktTokenMakeVar(tokenizer->curr), offset);
+			break;
+		}
+		// fall through
 
-			char* numberStr = NULL;
-			ktStringCopyInterval(&numberStr, data, concatStartIndex, concatEndIndex);
+	case KT_CHAR_PUNCT:
+	{
+		// We are inside a string - check for single word and/or valid statements.
+		size_t concatStartIndex = tokenizer->index;
+		size_t concatEndIndex = runEnd(tokenizer, tokenizer->scan->word) - 1;
 
-			char* endPtr = NULL;
-			double number = strtod(numberStr, &endPtr);
+		seek(tokenizer, concatEndIndex);
 
-			// Successful string to double conversion.
-			if (*endPtr == KT_TOKEN_EOF_SYMBOL)
-			{
-				ktTokenListAppend(out_list, ktTokenCreateNumber(number));
-			}
-			else
-			{
-				char errorMsg[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
-				snprintf(errorMsg, KT_ERROR_MESSAGE_MAX_LENGTH, ktErrorDescription(KT_ERROR_TOKENIZER_STR_TO_NUMBER), numberStr);
-				ktTokenListAppend(out_list, ktTokenCreateError(errorMsg));
-			}
+		ktTokenSpan span = { concatStartIndex, concatEndIndex - concatStartIndex + 1 };
 
-			ktStringDestroy(numberStr);
-		}
-		else if (isalpha(curr) || ispunct(curr))
+		ktTokenType keyword = keywordType(tokenizer->data, span);
+		if (keyword != KT_TOKEN_WORD)
 		{
-			// Only one letter followed by a whitespace or any valid symbol - we have found a variable!
-			unsigned char ahead = peek(1);
-			if (!ispunct(curr) && (isblank(ahead)
-				|| ahead == KT_TOKEN_NEWLINE_SYMBOL
-				|| ahead == KT_TOKEN_EOF_SYMBOL
-				|| ahead == KT_TOKEN_EQUALS_SYMBOL
-				|| ahead == KT_TOKEN_ADD_SYMBOL
-				|| ahead == KT_TOKEN_SUB_SYMBOL
-				|| ahead == KT_TOKEN_MUL_SYMBOL
-				|| ahead == KT_TOKEN_DIV_SYMBOL
-				|| ahead == KT_TOKEN_POW_SYMBOL
-				|| ahead == KT_TOKEN_OPEN_PAREN_SYMBOL
-				|| ahead == KT_TOKEN_CLOSE_PAREN_SYMBOL))
-			{
-				ktTokenListAppend(out_list, ktTokenCreateVar(curr));
-			}
-			else // We are inside a string - check for single word and/or valid statements.
-			{
-				size_t concatStartIndex = index;
-				while (!isblank(curr) && curr != KT_TOKEN_NEWLINE_SYMBOL && curr != KT_TOKEN_EOF_SYMBOL)
-				{
-					advance();
-				}
-				size_t concatEndIndex = ktMax((size_t)index - 1, 0);
-
-				retreat();
-
-				char* str = NULL;
-				ktStringCopyInterval(&str, data, concatStartIndex, concatEndIndex);
-				size_t strLength = strlen(str);
-
-				size_t letLength = ktMax(strLength, strlen(KT_TOKEN_STMT_LET_VALUE));
-				size_t resetLength = ktMax(strLength, strlen(KT_TOKEN_STMT_RESET_VALUE));
-				size_t varsLength = ktMax(strLength, strlen(KT_TOKEN_STMT_VARS_VALUE));
-				size_t clearLength = ktMax(strLength, strlen(KT_TOKEN_STMT_CLEAR_VALUE));
-				size_t exitLength = ktMax(strLength, strlen(KT_TOKEN_STMT_EXIT_VALUE));
-
-#if _DEBUG_RPN
-				size_t rpnLength = ktMax(strLength, strlen(KT_TOKEN_STMT_RPN_VALUE));
-#endif // #if _DEBUG_RPN
-
-				if (strncmp(str, KT_TOKEN_STMT_LET_VALUE, letLength) == 0)
-				{
-					ktTokenListAppend(out_list, ktTokenCreateStmtLet());
-				}
-				else if (strncmp(str, KT_TOKEN_STMT_RESET_VALUE, resetLength) == 0)
-				{
-					ktTokenListAppend(out_list, ktTokenCreateStmtReset());
-				}
-				else if (strncmp(str, KT_TOKEN_STMT_VARS_VALUE, varsLength) == 0)
-				{
-					ktTokenListAppend(out_list, ktTokenCreateStmtVars());
-				}
-				else if (strncmp(str, KT_TOKEN_STMT_CLEAR_VALUE, clearLength) == 0)
-				{
-					ktTokenListAppend(out_list, ktTokenCreateStmtClear());
-				}
-				else if (strncmp(str, KT_TOKEN_STMT_EXIT_VALUE, exitLength) == 0)
-				{
-					ktTokenListAppend(out_list, ktTokenCreateStmtExit());
-				}
-
-#if _DEBUG_RPN
-				else if (strncmp(str, KT_TOKEN_STMT_RPN_VALUE, rpnLength) == 0)
-				{
-					ktTokenListAppend(out_list, ktTokenCreateStmtRpn());
-				}
-#endif // #if _DEBUG_RPN
-
-				else
-				{
-					// For now, we only recognize single words separated by
-					// spaces. Later, we should add support for strings
-					// (i.e., one or more words grouped together).
-					ktTokenListAppend(out_list, ktTokenCreateWord(str));
-				}
-
-				ktStringDestroy(str);
-			}
+			ktTokenBufferAppend(out_buffer, ktTokenMakeStmt(keyword, span), offset);
 		}
 		else
 		{
-			if (curr != KT_TOKEN_EOF_SYMBOL)
-			{
-				char errorMsg[KT_ERROR_MESSAGE_MAX_LENGTH] = { 0 };
-				snprintf(errorMsg, KT_ERROR_MESSAGE_MAX_LENGTH, ktErrorDescription(KT_ERROR_TOKENIZER_INVALID_TOKEN), curr);
-				ktTokenListAppend(out_list, ktTokenCreateError(errorMsg));
-			}
+			// For now, we only recognize single words separated by
+			// spaces. Later, we should add support for strings
+			// (i.e., one or more words grouped together).
+			ktTokenBufferAppend(out_buffer, ktTokenMakeWord(span), offset);
 		}
+		break;
+	}
+
+	case KT_CHAR_EOF:
+		break;
+
+	case KT_CHAR_INVALID:
+	default:
+	{
+		ktTokenSpan span = { tokenizer->index, 1 };
+		ktTokenBufferAppend(out_buffer, ktTokenMakeError(KT_ERROR_TOKENIZER_INVALID_TOKEN, span), offset);
+		break;
+	}
 	}
+
+	return true;
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void reset(void)
+void reset(ktTokenizer* tokenizer)
 {
-	index = -1;
-	curr = '\0';
+	tokenizer->index = KT_TOKENIZER_BEFORE_START;
+	tokenizer->curr = '\0';
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-void advance(void)
+void advance(ktTokenizer* tokenizer)
 {
-	++index;
-	curr = (index < length) ? data[index] : '\0';
+	++tokenizer->index;
+	tokenizer->curr = (tokenizer->index < tokenizer->length) ? tokenizer->data[tokenizer->index] : '\0';
 }
 
 //------------------------------------------------------------------------------
@@ -330,16 +645,113 @@ void advance(void)
 // In these cases, we want to go back to the previous character so the next
 // advance() call gets the correct character in the sequence.
 //------------------------------------------------------------------------------
-void retreat(void)
+void retreat(ktTokenizer* tokenizer)
 {
-	--index;
-	curr = (index > -1) ? data[index] : '\0';
+	if (tokenizer->index == 0 || tokenizer->index == KT_TOKENIZER_BEFORE_START)
+	{
+		reset(tokenizer);
+		return;
+	}
+
+	--tokenizer->index;
+	tokenizer->curr = (tokenizer->index < tokenizer->length) ? tokenizer->data[tokenizer->index] : '\0';
 }
 
 //------------------------------------------------------------------------------
 //
 //------------------------------------------------------------------------------
-unsigned char peek(size_t offset)
+unsigned char peek(const ktTokenizer* tokenizer, size_t offset)
+{
+	return (tokenizer->index + offset < tokenizer->length) ? tokenizer->data[tokenizer->index + offset] : '\0';
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void seek(ktTokenizer* tokenizer, size_t index)
+{
+	tokenizer->index = index;
+	tokenizer->curr = (index < tokenizer->length) ? tokenizer->data[index] : '\0';
+}
+
+//------------------------------------------------------------------------------
+// Returns the index right after the run of characters that starts at the
+// current character.
+//------------------------------------------------------------------------------
+size_t runEnd(const ktTokenizer* tokenizer, size_t (*scanRun)(const char*, size_t, size_t))
+{
+	return scanRun(tokenizer->data, tokenizer->index, tokenizer->length);
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+bool isClass(unsigned char c, unsigned int classes)
+{
+	return (CLASS_BIT(CHAR_CLASS[c]) & classes) != 0;
+}
+
+//------------------------------------------------------------------------------
+// A single table lookup finds the only keyword the word could be, then one
+// comparison confirms it.
+//------------------------------------------------------------------------------
+ktTokenType keywordType(const char* data, ktTokenSpan span)
 {
-	return (index + (int)offset < length) ? data[index + offset] : '\0';
+	unsigned int letter = (unsigned char)data[span.offset] - (unsigned int)'A';
+	if (span.length >= KT_KEYWORD_LENGTHS || letter >= KT_KEYWORD_FIRST_LETTERS)
+	{
+		return KT_TOKEN_WORD;
+	}
+
+	ktTokenType type = KEYWORD_TOKEN[span.length][letter];
+	if (type != KT_TOKEN_WORD && memcmp(&data[span.offset], KEYWORD_VALUE[type], span.length) == 0)
+	{
+		return type;
+	}
+
+	return KT_TOKEN_WORD;
+}
+
+//------------------------------------------------------------------------------
+//
+//------------------------------------------------------------------------------
+void emitStmt(ktTokenizer* tokenizer, const char* data, size_t length)
+{
+	tokenize(tokenizer, data, length, tokenizer->stmtBuffer);
+
+	if (tokenizer->stmtCallback)
+	{
+		tokenizer->stmtCallback(data, tokenizer->stmtBuffer, tokenizer->userData);
+	}
+}
+
+//------------------------------------------------------------------------------
+// The carry buffer only grows, so its size is bounded by the longest
+// statement that straddled two chunks.
+//------------------------------------------------------------------------------
+bool carryAppend(ktTokenizer* tokenizer, const char* bytes, size_t length)
+{
+	if (length == 0)
+		return true;
+
+	size_t required = tokenizer->carryLength + length;
+	if (required > tokenizer->carryCapacity)
+	{
+		size_t capacity = tokenizer->carryCapacity > 0 ? tokenizer->carryCapacity : KT_TOKENIZER_CARRY_INITIAL_CAPACITY;
+		while (capacity < required)
+		{
+			capacity *= 2;
+		}
+
+		char* carry = ktRealloc(tokenizer->carry, capacity);
+		if (!carry)
+			return false;
+
+		tokenizer->carry = carry;
+		tokenizer->carryCapacity = capacity;
+	}
+
+	memcpy(&tokenizer->carry[tokenizer->carryLength], bytes, length);
+	tokenizer->carryLength = required;
+	return true;
 }
@@ -20,11 +20,34 @@
 //------------------------------------------------------------------------------
 // Includes
 //------------------------------------------------------------------------------
-#include "token_list.h"
+#include "char_scan.h"
+#include "token_buffer.h"
+
+//------------------------------------------------------------------------------
+// Custom types, structs, etc.
+//------------------------------------------------------------------------------
+typedef struct ktTokenizer ktTokenizer;
+
+// Called by ktTokenizerFeed()/ktTokenizerFinish() once per complete statement
+// (i.e. line). The contents are the statement without its line break and are
+// NOT NUL-terminated; token spans point into them. Both contents and tokens
+// are only valid during the call.
+typedef void (*ktTokenizerStmtCallback)(const char* contents, const ktTokenBuffer* tokens, void* userData);
 
 //------------------------------------------------------------------------------
 // Function definitions
 //------------------------------------------------------------------------------
-void ktTokenizerRun(const char* contents, ktTokenList* out_list);
+ktTokenizer* ktTokenizerCreate(void);
+void ktTokenizerDestroy(ktTokenizer* tokenizer);
+void ktTokenizerSetCharScanPath(ktTokenizer* tokenizer, ktCharScanPath path);
+void ktTokenizerRun(ktTokenizer* tokenizer, const char* contents, ktTokenBuffer* out_buffer);
+
+bool ktTokenizerBegin(ktTokenizer* tokenizer, const char* contents);
+bool ktTokenizerNext(ktTokenizer* tokenizer, ktToken* out_token);
+size_t ktTokenizerLastOffset(const ktTokenizer* tokenizer);
+
+void ktTokenizerSetStmtCallback(ktTokenizer* tokenizer, ktTokenizerStmtCallback callback, void* userData);
+bool ktTokenizerFeed(ktTokenizer* tokenizer, const char* bytes, size_t length);
+void ktTokenizerFinish(ktTokenizer* tokenizer);
 
 #endif // __KISHITECH_TOKENIZER_H__
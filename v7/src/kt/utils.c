@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "utils.h"
+#include "alloc.h"
 
 //------------------------------------------------------------------------------
 // 
@@ -35,10 +36,10 @@
 bool ktStringCopy(char** destination, const char* source)
 {
 	size_t length = strlen(source);
-	*destination = malloc((length + 1) * sizeof(char));
+	*destination = ktAlloc((length + 1) * sizeof(char));
 	if (*destination)
 	{
-		strncpy(*destination, source, length);
+		memcpy(*destination, source, length);
 		(*destination)[length] = '\0';
 
 		return true;
@@ -53,7 +54,7 @@ bool ktStringCopy(char** destination, const char* source)
 bool ktStringCopyInterval(char** destination, const char* source, size_t startIndex, size_t endIndex)
 {
 	size_t length = endIndex - startIndex + 1;
-	*destination = malloc((length + 1) * sizeof(char));
+	*destination = ktAlloc((length + 1) * sizeof(char));
 	if (*destination)
 	{
 		strncpy(*destination, &source[startIndex], length);
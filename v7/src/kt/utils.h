@@ -22,11 +22,12 @@
 //------------------------------------------------------------------------------
 #include <stdbool.h>
 #include <stdlib.h>
+#include "alloc.h"
 
 //------------------------------------------------------------------------------
 // Macros
 //------------------------------------------------------------------------------
-#define SAFE_DELETE(ptr)	do { if (ptr) { free(ptr); ptr = NULL; } } while(0)
+#define SAFE_DELETE(ptr)	do { if (ptr) { ktFree(ptr); ptr = NULL; } } while(0)
 
 //------------------------------------------------------------------------------
 // Function definitions
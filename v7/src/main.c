@@ -32,13 +32,17 @@
 //------------------------------------------------------------------------------
 // 
 //------------------------------------------------------------------------------
-int main()
+int main(int argc, char* argv[])
 {
 	// Memory leak detection using MS Visual Studio.
 #if defined(_MSC_VER)
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 #endif
 
+	// pqc <script>: run the script (compiled on one thread per processor).
+	if (argc > 1)
+		return ktInterpreterRunFile(argv[1], 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
 	ktInterpreterRun();
 
 	return EXIT_SUCCESS;